@@ -0,0 +1,322 @@
+// --- [ Z80 Core Benchmark ] ---
+// Runs the interpreter headless on fixed workloads and reports emulated MHz,
+// ns per instruction and instructions per second, with the spread over
+// several runs. Results are also written as JSON so they can be tracked
+// commit by commit.
+//
+// Workloads (each runs a fixed number of 70,000 T-state frames):
+//   boot   ROM reset to the BASIC prompt (the copyright message appears
+//          around frame 87; 100 frames are run)
+//   calc   ROM floating-point calculator: SIN and COS of 0..255 in a loop
+//   ldir   LDIR-heavy fill of the whole screen, interrupts off
+//   index  IX/IY indexed loads, ALU, INC and DDCB rotates, interrupts off
+//   sweep  zexdoc-style sweep over the ALU, CB, ED and flag instructions
+//
+// With --blocks the same workloads run through z80_run and the block cache
+// (z80.h), and with --icache z80_step runs from the per-address decode
+// cache; decoding included either way: each run starts with empty caches.
+// --core fast measures the core variant without MEMPTR, undocumented flags
+// and R register updates (z80_set_core).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>     // sqrt
+#include <time.h>     // timespec_get
+
+#include "spectrum.h"
+
+#define BOOT_FRAMES  100   // Frames from reset to a settled BASIC prompt
+#define PROG_ADDR    0x8000
+
+static double now_seconds(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// --- [ Workload Programs ] ---
+// Hand-assembled; each one loops forever, the benchmark stops it after a
+// fixed number of frames.
+
+// ROM calculator: for b = 255..1: STACK-A b; RST 28h: sin, cos, delete, end-calc
+static const uint8_t prog_calc[] = {
+    0x06, 0x00,             // 8000 ld b,0
+    0xC5,                   // 8002 loop: push bc
+    0x78,                   // 8003 ld a,b
+    0xCD, 0x28, 0x2D,       // 8004 call STACK-A
+    0xEF,                   // 8007 rst 28h (FP-CALC)
+    0x1F, 0x20, 0x02, 0x38, //      sin, cos, delete, end-calc
+    0xC1,                   // 800C pop bc
+    0x10, 0xF3,             // 800D djnz loop
+    0x18, 0xEF,             // 800F jr 8000
+};
+
+// Fills the whole screen (bitmap + attributes) with LDIR, one value per pass
+static const uint8_t prog_ldir[] = {
+    0xF3,                   // 8000 di
+    0xAF,                   // 8001 xor a
+    0x21, 0x00, 0x40,       // 8002 loop: ld hl,4000h
+    0x11, 0x01, 0x40,       // 8005 ld de,4001h
+    0x01, 0xFF, 0x1A,       // 8008 ld bc,1AFFh
+    0x77,                   // 800B ld (hl),a
+    0xED, 0xB0,             // 800C ldir
+    0x3C,                   // 800E inc a
+    0x18, 0xF1,             // 800F jr loop
+};
+
+// Indexed loop over two 256-byte tables
+static const uint8_t prog_index[] = {
+    0xF3,                   // 8000 di
+    0xDD, 0x21, 0x00, 0x90, // 8001 ld ix,9000h
+    0xFD, 0x21, 0x00, 0xA0, // 8005 ld iy,A000h
+    0x06, 0x00,             // 8009 ld b,0
+    0xDD, 0x7E, 0x01,       // 800B loop: ld a,(ix+1)
+    0xFD, 0x86, 0x02,       // 800E add a,(iy+2)
+    0xDD, 0x77, 0x03,       // 8011 ld (ix+3),a
+    0xFD, 0x34, 0x04,       // 8014 inc (iy+4)
+    0xDD, 0xCB, 0x05, 0x06, // 8017 rlc (ix+5)
+    0xDD, 0x23,             // 801B inc ix
+    0xFD, 0x23,             // 801D inc iy
+    0x10, 0xEA,             // 801F djnz loop
+    0x18, 0xDE,             // 8021 jr 8001
+};
+
+// Builds the sweep program: every ALU op on every register and (hl), the CB
+// rotate/shift/BIT groups, DAA/CPL/SCF/CCF, the accumulator rotates, NEG,
+// RLD/RRD and INC/DEC. H and L are never modified, so (hl) stays at 9000h.
+static size_t build_sweep(uint8_t* p) {
+    size_t n = 0;
+    p[n++] = 0xF3;                                   // di
+    p[n++] = 0x21; p[n++] = 0x00; p[n++] = 0x90;     // ld hl,9000h
+
+    for (int op = 0x80; op <= 0xBF; op++)            // add/adc/sub/sbc/and/xor/or/cp
+        p[n++] = (uint8_t)op;
+    for (int op = 0x00; op <= 0x7F; op++) {          // rlc..srl, bit n,r
+        int r = op & 7;
+        if (r == 4 || r == 5) continue;              // keep H and L intact
+        p[n++] = 0xCB;
+        p[n++] = (uint8_t)op;
+    }
+    static const uint8_t misc[] = {
+        0x27, 0x2F, 0x37, 0x3F,                      // daa, cpl, scf, ccf
+        0x07, 0x0F, 0x17, 0x1F,                      // rlca, rrca, rla, rra
+        0x04, 0x05, 0x0C, 0x0D, 0x14, 0x15, 0x1C,    // inc/dec b, c, d, e
+        0x1D, 0x3C, 0x3D, 0x34, 0x35,                // inc/dec a, (hl)
+        0xED, 0x44, 0xED, 0x6F, 0xED, 0x67,          // neg, rld, rrd
+        0xED, 0x42, 0xED, 0x4A,                      // sbc hl,bc / adc hl,bc
+    };
+    memcpy(p + n, misc, sizeof(misc));
+    n += sizeof(misc);
+
+    // sbc/adc hl,bc changed HL: the loop restarts at "ld hl,9000h"
+    p[n++] = 0xC3; p[n++] = (PROG_ADDR + 1) & 0xFF; p[n++] = (PROG_ADDR + 1) >> 8;
+    return n;
+}
+
+// --- [ Workload Table ] ---
+typedef struct workload {
+    const char* name;
+    const uint8_t* prog;     // NULL = ROM boot from reset
+    size_t size;
+    int frames;              // Measured frames per run
+} workload;
+
+static uint8_t prog_sweep[512];
+
+static workload workloads[] = {
+    {"boot",  NULL,       0,                  BOOT_FRAMES},
+    {"calc",  prog_calc,  sizeof(prog_calc),  250},
+    {"ldir",  prog_ldir,  sizeof(prog_ldir),  250},
+    {"index", prog_index, sizeof(prog_index), 250},
+    {"sweep", prog_sweep, 0,                  250},
+};
+#define NUM_WORKLOADS (int)(sizeof(workloads) / sizeof(workloads[0]))
+
+typedef struct result {
+    double seconds[64];
+    unsigned long long tstates;
+    unsigned long long instructions;
+} result;
+
+// Runs whole frames, counting instructions. Same loop as zx_run_frame.
+static unsigned long long run_frames(zx_spectrum* zx, int frames) {
+    unsigned long long n = 0;
+    for (int f = 0; f < frames; f++) {
+        while (zx_frame_tstate(zx) < zx->frame_tstates) {
+            z80_step(&zx->cpu);
+            n++;
+        }
+        zx_end_frame(zx);
+    }
+    return n;
+}
+
+// Same frames through the block tier: the cache counts the instructions
+static unsigned long long run_frames_blocks(zx_spectrum* zx, int frames) {
+    const z80_block_stats* bs = z80_blocks_stats(zx->cpu.blocks);
+    unsigned long long n0 = bs->insns + bs->steps;
+    for (int f = 0; f < frames; f++)
+        zx_run_frame(zx);
+    return bs->insns + bs->steps - n0;
+}
+
+// --- [ Statistics ] ---
+static double mean(const double* v, int n) {
+    double s = 0;
+    for (int i = 0; i < n; i++) s += v[i];
+    return s / n;
+}
+
+static double stddev(const double* v, int n) {
+    if (n < 2) return 0;
+    double m = mean(v, n), s = 0;
+    for (int i = 0; i < n; i++) s += (v[i] - m) * (v[i] - m);
+    return sqrt(s / (n - 1));
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "usage: %s [--rom FILE] [--runs N] [--json FILE] [--only NAME] [--blocks] [--icache]\n"
+            "          [--core exact|fast]\n"
+            "  --runs N     repetitions per workload (default 5)\n"
+            "  --json FILE  machine-readable results (default bench_results.json)\n"
+            "  --only NAME  run a single workload (boot, calc, ldir, index, sweep)\n"
+            "  --blocks     run through the block cache instead of z80_step\n"
+            "  --icache     step from the decode cache\n"
+            "  --core fast  the core variant without MEMPTR, XF/YF and R updates\n",
+            prog);
+}
+
+int main(int argc, char* argv[]) {
+    const char* rom = "48.rom";
+    const char* json_path = "bench_results.json";
+    const char* only = NULL;
+    int runs = 5;
+    bool use_blocks = false, use_icache = false;
+    bool fast_core = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--rom") == 0 && i + 1 < argc)
+            rom = argv[++i];
+        else if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc)
+            runs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+            json_path = argv[++i];
+        else if (strcmp(argv[i], "--only") == 0 && i + 1 < argc)
+            only = argv[++i];
+        else if (strcmp(argv[i], "--blocks") == 0)
+            use_blocks = true;
+        else if (strcmp(argv[i], "--icache") == 0)
+            use_icache = true;
+        else if (strcmp(argv[i], "--core") == 0 && i + 1 < argc &&
+                 (strcmp(argv[i + 1], "exact") == 0 || strcmp(argv[i + 1], "fast") == 0))
+            fast_core = strcmp(argv[++i], "fast") == 0;
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (runs < 1 || runs > 64) {
+        fprintf(stderr, "--runs must be between 1 and 64\n");
+        return 1;
+    }
+    workloads[NUM_WORKLOADS - 1].size = build_sweep(prog_sweep);
+
+    // --- [ Booted machine shared by the program workloads ] ---
+    static zx_spectrum booted, zx;
+    if (!zx_init(&booted, rom))
+        return 1;
+    run_frames(&booted, BOOT_FRAMES);
+
+    z80_blocks* blocks = use_blocks ? z80_blocks_new() : NULL;
+    z80_icache* icache = use_icache ? z80_icache_new() : NULL;
+    if ((use_blocks && !blocks) || (use_icache && !icache)) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    if (icache)
+        z80_icache_set_rom(icache, 0, ZX_ROM_SIZE);
+
+    static result results[NUM_WORKLOADS];
+    printf("%-6s %10s %10s %12s %14s\n", "name", "MHz", "+/-", "ns/instr", "instr/s");
+
+    for (int w = 0; w < NUM_WORKLOADS; w++) {
+        const workload* wl = &workloads[w];
+        result* r = &results[w];
+        if (only && strcmp(only, wl->name) != 0)
+            continue;
+
+        for (int run = 0; run < runs; run++) {
+            // Every run starts from the very same state
+            if (wl->prog) {
+                zx = booted;
+                zx.cpu.userdata = &zx;
+                for (size_t i = 0; i < wl->size; i++)
+                    zx_poke(&zx, (uint16_t)(PROG_ADDR + i), wl->prog[i]);
+                zx.cpu.pc = PROG_ADDR;
+            } else {
+                zx_init(&zx, rom);
+            }
+
+            z80_set_core(&zx.cpu, fast_core ? Z80_CORE_FAST : Z80_CORE_EXACT);
+            zx.cpu.blocks = blocks;
+            z80_blocks_flush(blocks);
+            zx.cpu.icache = icache;
+            z80_icache_flush(icache);
+
+            unsigned long start_cyc = zx.cpu.cyc;
+            double t0 = now_seconds();
+            r->instructions = blocks ? run_frames_blocks(&zx, wl->frames)
+                                     : run_frames(&zx, wl->frames);
+            r->seconds[run] = now_seconds() - t0;
+            r->tstates = zx.cpu.cyc - start_cyc;
+        }
+
+        double mhz[64], ns[64], ips[64];
+        for (int i = 0; i < runs; i++) {
+            mhz[i] = r->tstates / r->seconds[i] / 1e6;
+            ns[i] = r->seconds[i] * 1e9 / r->instructions;
+            ips[i] = r->instructions / r->seconds[i];
+        }
+        printf("%-6s %10.1f %10.1f %12.2f %14.0f\n", wl->name, mean(mhz, runs),
+               stddev(mhz, runs), mean(ns, runs), mean(ips, runs));
+    }
+
+    // --- [ Machine-readable results ] ---
+    FILE* f = fopen(json_path, "w");
+    if (!f) {
+        perror(json_path);
+        return 1;
+    }
+    fprintf(f, "{\n  \"runs\": %d,\n  \"blocks\": %s,\n  \"icache\": %s,\n  \"core\": \"%s\",\n"
+               "  \"workloads\": [", runs,
+            use_blocks ? "true" : "false", use_icache ? "true" : "false",
+            fast_core ? "fast" : "exact");
+    bool first = true;
+    for (int w = 0; w < NUM_WORKLOADS; w++) {
+        const result* r = &results[w];
+        if (only && strcmp(only, workloads[w].name) != 0)
+            continue;
+
+        double mhz[64], ns[64], ips[64];
+        for (int i = 0; i < runs; i++) {
+            mhz[i] = r->tstates / r->seconds[i] / 1e6;
+            ns[i] = r->seconds[i] * 1e9 / r->instructions;
+            ips[i] = r->instructions / r->seconds[i];
+        }
+        fprintf(f, "%s\n    {\"name\": \"%s\", \"frames\": %d, \"tstates\": %llu, "
+                   "\"instructions\": %llu,\n     \"mhz\": %.3f, \"mhz_stddev\": %.3f, "
+                   "\"ns_per_instr\": %.3f, \"ns_per_instr_stddev\": %.3f, "
+                   "\"instr_per_sec\": %.0f, \"instr_per_sec_stddev\": %.0f}",
+                first ? "" : ",", workloads[w].name, workloads[w].frames,
+                r->tstates, r->instructions, mean(mhz, runs), stddev(mhz, runs),
+                mean(ns, runs), stddev(ns, runs), mean(ips, runs), stddev(ips, runs));
+        first = false;
+    }
+    fprintf(f, "\n  ]\n}\n");
+    fclose(f);
+    z80_blocks_free(blocks);
+    z80_icache_free(icache);
+    return 0;
+}
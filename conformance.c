@@ -0,0 +1,679 @@
+// --- [ Z80 Conformance Harness ] ---
+// Proves that the Z80 core is bit-exact before and after any rewrite of its
+// hot paths. Two kinds of test are supported:
+//
+//   --zex FILE   ZEXDOC / ZEXALL instruction exercisers (CP/M .COM files).
+//                A tiny CP/M stub is enough: the program is loaded at 0100h,
+//                BDOS calls to 0005h (function 2 = print char, 9 = print
+//                '$'-terminated string) are captured, and a jump to 0000h
+//                ends the run. The exerciser checks its own CRCs and prints
+//                "ERROR" on a mismatch.
+//
+//   --fuse DIR   FUSE core tests (DIR/tests.in and DIR/tests.expected):
+//                one test per opcode, each giving the registers and memory
+//                before, and the registers, memory and T-state count after.
+//                Everything is compared: AF BC DE HL, the shadow set, IX IY
+//                SP PC, MEMPTR, I R IFF1 IFF2 IM, HALT, T-states and all 64 KB.
+//
+// The test programs themselves are not shipped with the emulator.
+//
+// Both are split into independent jobs that run on a pool of threads: every
+// ZEX test group gets its own job (its own 64 KB machine whose test table is
+// patched to hold just that group), and FUSE tests are run in chunks. The
+// results are printed in the original order once all jobs have finished.
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L  // sysconf
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>     // timespec_get
+
+#ifdef _WIN32
+#include <windows.h>  // GetSystemInfo
+#else
+#include <unistd.h>   // sysconf
+#endif
+
+#include "z80.h"
+
+#define FUSE_TESTS_PER_JOB  32
+#define MAX_POKES           64     // Memory bytes set up (or changed) by one FUSE test
+
+static double now_seconds(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int cpu_count(void) {
+#ifdef _WIN32
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    return (int)si.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#endif
+}
+
+// --- [ Growable Text Buffer (per-job output) ] ---
+typedef struct text {
+    char*  data;
+    size_t len, cap;
+} text;
+
+// Out of memory: the character is dropped, the report is still printed
+static void text_putc(text* t, char c) {
+    if (t->len + 2 > t->cap) {
+        size_t cap = t->cap ? t->cap * 2 : 256;
+        char* data = realloc(t->data, cap);
+        if (!data)
+            return;
+        t->data = data;
+        t->cap = cap;
+    }
+    t->data[t->len++] = c;
+    t->data[t->len] = '\0';
+}
+
+static void text_printf(text* t, const char* fmt, ...) {
+    char line[256];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+    for (const char* p = line; *p; p++)
+        text_putc(t, *p);
+}
+
+// --- [ Test Machine: flat 64 KB RAM, no ULA ] ---
+typedef struct machine {
+    z80 cpu;
+    uint8_t mem[65536];
+    text* out;               // CP/M console output
+} machine;
+
+static uint8_t read_byte(void* userdata, uint16_t addr) {
+    machine* m = userdata;
+    return m->mem[addr];
+}
+
+static void write_byte(void* userdata, uint16_t addr, uint8_t val) {
+    machine* m = userdata;
+    m->mem[addr] = val;
+}
+
+// FUSE convention: reading a port returns the high byte of its address.
+static uint8_t port_in(z80* cpu, uint16_t port, unsigned long cyc) {
+    (void)cpu;
+    (void)cyc;
+    return port >> 8;
+}
+
+static void port_out(z80* cpu, uint16_t port, uint8_t val, unsigned long cyc) {
+    (void)cpu;
+    (void)port;
+    (void)val;
+    (void)cyc;
+}
+
+static void machine_init(machine* m) {
+    z80_init(&m->cpu);
+    m->cpu.read_byte = read_byte;
+    m->cpu.write_byte = write_byte;
+    m->cpu.port_in = port_in;
+    m->cpu.port_out = port_out;
+    m->cpu.userdata = m;
+}
+
+// --- [ Jobs ] ---
+typedef struct zex_file {
+    const char* path;
+    uint8_t* image;          // The .COM file
+    size_t size;
+    uint16_t table;          // Address of the test table (0 = not found)
+    int groups;
+} zex_file;
+
+typedef struct fuse_state {
+    uint16_t af, bc, de, hl, af_, bc_, de_, hl_, ix, iy, sp, pc, memptr;
+    uint8_t i, r, iff1, iff2, im, halted;
+    unsigned long tstates;
+    int npokes;
+    uint16_t poke_addr[MAX_POKES];
+    uint8_t poke_val[MAX_POKES];
+} fuse_state;
+
+typedef struct fuse_test {
+    char name[32];
+    fuse_state in, out;
+} fuse_test;
+
+typedef struct job {
+    const zex_file* zex;     // ZEX job: one test group...
+    int group;
+    const fuse_test* fuse;   // ...or FUSE job: a run of tests
+    int count;
+
+    text out;
+    int failures;
+    double seconds;
+} job;
+
+// --- [ ZEXDOC / ZEXALL ] ---
+// Both exercisers start with:
+//   ld hl,(6) / ld sp,hl / ld de,msg / ld c,9 / call bdos / ld hl,tests
+// "tests" is a table of pointers to the test groups, ended by 0000h.
+static uint16_t zex_find_table(const uint8_t* image, size_t size) {
+    for (size_t i = 0; i + 15 <= size; i++) {
+        const uint8_t* p = image + i;
+        if (p[0] == 0x2A && p[1] == 0x06 && p[2] == 0x00 && p[3] == 0xF9 &&
+            p[4] == 0x11 && p[7] == 0x0E && p[8] == 0x09 && p[9] == 0xCD &&
+            p[12] == 0x21)
+            return (uint16_t)(p[13] | p[14] << 8);
+    }
+    return 0;
+}
+
+static void zex_load(machine* m, const zex_file* zf) {
+    memset(m->mem, 0, sizeof(m->mem));
+    memcpy(m->mem + 0x100, zf->image, zf->size);
+    m->mem[0x0005] = 0xC9;   // BDOS entry: RET (the call is handled by the harness)
+    m->mem[0x0006] = 0x00;   // ...and (0006h) = top of the TPA, used as the stack
+    m->mem[0x0007] = 0xFE;
+    m->cpu.pc = 0x100;
+}
+
+static void bdos_call(machine* m) {
+    z80* c = &m->cpu;
+    if (c->c == 2) {
+        text_putc(m->out, (char)c->e);
+    } else if (c->c == 9) {
+        for (uint16_t a = c->d << 8 | c->e; m->mem[a] != '$'; a++)
+            text_putc(m->out, (char)m->mem[a]);
+    }
+}
+
+static void run_zex(job* j) {
+    machine* m = malloc(sizeof(machine));
+    if (!m) {
+        text_printf(&j->out, "out of memory\n");
+        j->failures = 1;
+        return;
+    }
+    text console = {0};
+    machine_init(m);
+    m->out = &console;
+    zex_load(m, j->zex);
+
+    // Leave only this job's group in the test table
+    uint16_t t = j->zex->table;
+    if (t) {
+        uint16_t entry = t + 2 * j->group;
+        m->mem[t] = m->mem[entry];
+        m->mem[t + 1] = m->mem[entry + 1];
+        m->mem[t + 2] = m->mem[t + 3] = 0;
+    }
+
+    while (m->cpu.pc != 0x0000) {
+        if (m->cpu.pc == 0x0005) {
+            if (m->cpu.c == 0)   // P_TERMCPM
+                break;
+            bdos_call(m);
+        }
+        z80_step(&m->cpu);
+    }
+
+    // Keep the group's own lines: drop the banner and "Tests complete"
+    const char* p = console.data ? console.data : "";
+    if (t) {
+        const char* nl = strchr(p, '\n');
+        p = nl ? nl + 1 : p;
+    }
+    for (; *p; p++) {
+        if (*p == '\r')
+            continue;
+        if (t && strncmp(p, "Tests complete", 14) == 0)
+            break;
+        text_putc(&j->out, *p);
+    }
+    if (j->out.data && strstr(j->out.data, "ERROR"))
+        j->failures = 1;
+    free(console.data);
+    free(m);
+}
+
+// --- [ FUSE Core Tests ] ---
+static const uint8_t deadbeef[4] = {0xDE, 0xAD, 0xBE, 0xEF};
+
+static void fuse_setup_memory(uint8_t* mem, const fuse_state* s) {
+    for (int i = 0; i < 65536; i++)
+        mem[i] = deadbeef[i & 3];  // FUSE fills memory with DE AD BE EF
+    for (int k = 0; k < s->npokes; k++)
+        mem[s->poke_addr[k]] = s->poke_val[k];
+}
+
+static void fuse_set_regs(z80* c, const fuse_state* s) {
+    c->a = s->af >> 8;   z80_set_f(c, s->af & 0xFF);
+    c->b = s->bc >> 8;   c->c = s->bc & 0xFF;
+    c->d = s->de >> 8;   c->e = s->de & 0xFF;
+    c->h = s->hl >> 8;   c->l = s->hl & 0xFF;
+    c->a_ = s->af_ >> 8; c->f_ = s->af_ & 0xFF;
+    c->b_ = s->bc_ >> 8; c->c_ = s->bc_ & 0xFF;
+    c->d_ = s->de_ >> 8; c->e_ = s->de_ & 0xFF;
+    c->h_ = s->hl_ >> 8; c->l_ = s->hl_ & 0xFF;
+    c->ix = s->ix; c->iy = s->iy; c->sp = s->sp; c->pc = s->pc;
+    c->mem_ptr = s->memptr;
+    c->i = s->i; c->r = s->r;
+    c->iff1 = s->iff1; c->iff2 = s->iff2;
+    c->interrupt_mode = s->im;
+    c->halted = s->halted;
+    c->cyc = 0;
+}
+
+#define CHECK(what, got, want)                                                 \
+    do {                                                                    \
+        if ((unsigned long)(got) != (unsigned long)(want)) {                \
+            text_printf(out, "%s: %s %lX, expected %lX\n", t->name, what,  \
+                        (unsigned long)(got), (unsigned long)(want));       \
+            ok = false;                                                     \
+        }                                                                   \
+    } while (0)
+
+static bool run_fuse_test(machine* m, const fuse_test* t, text* out) {
+    z80* c = &m->cpu;
+    fuse_setup_memory(m->mem, &t->in);
+    fuse_set_regs(c, &t->in);
+
+    do {
+        z80_step(c);
+    } while (c->cyc < t->in.tstates);
+
+    const fuse_state* e = &t->out;
+    bool ok = true;
+    CHECK("AF", c->a << 8 | z80_get_f(c), e->af);
+    CHECK("BC", c->b << 8 | c->c, e->bc);
+    CHECK("DE", c->d << 8 | c->e, e->de);
+    CHECK("HL", c->h << 8 | c->l, e->hl);
+    CHECK("AF'", c->a_ << 8 | c->f_, e->af_);
+    CHECK("BC'", c->b_ << 8 | c->c_, e->bc_);
+    CHECK("DE'", c->d_ << 8 | c->e_, e->de_);
+    CHECK("HL'", c->h_ << 8 | c->l_, e->hl_);
+    CHECK("IX", c->ix, e->ix);
+    CHECK("IY", c->iy, e->iy);
+    CHECK("SP", c->sp, e->sp);
+    CHECK("PC", c->pc, e->pc);
+    CHECK("MEMPTR", c->mem_ptr, e->memptr);
+    CHECK("I", c->i, e->i);
+    CHECK("R", c->r, e->r);
+    // EI takes effect one instruction late in this core (iff_delay), so a
+    // pending EI counts as enabled, as it does in FUSE's state dump
+    CHECK("IFF1", c->iff1 || c->iff_delay, e->iff1);
+    CHECK("IFF2", c->iff2 || c->iff_delay, e->iff2);
+    CHECK("IM", c->interrupt_mode, e->im);
+    CHECK("HALT", c->halted, e->halted);
+    CHECK("T-states", c->cyc, e->tstates);
+
+    // Memory: the whole 64 KB must equal the initial image plus the changes
+    static _Thread_local uint8_t want[65536];
+    fuse_setup_memory(want, &t->in);
+    for (int k = 0; k < e->npokes; k++)
+        want[e->poke_addr[k]] = e->poke_val[k];
+    for (int a = 0; a < 65536; a++) {
+        if (m->mem[a] != want[a]) {
+            text_printf(out, "%s: memory %04X = %02X, expected %02X\n",
+                        t->name, a, m->mem[a], want[a]);
+            ok = false;
+            break;
+        }
+    }
+    return ok;
+}
+
+static void run_fuse(job* j) {
+    machine* m = malloc(sizeof(machine));
+    if (!m) {
+        text_printf(&j->out, "%s: out of memory, %d tests not run\n",
+                    j->fuse[0].name, j->count);
+        j->failures = j->count;
+        return;
+    }
+    machine_init(m);
+    for (int k = 0; k < j->count; k++)
+        if (!run_fuse_test(m, &j->fuse[k], &j->out))
+            j->failures++;
+    free(m);
+}
+
+// --- [ FUSE File Parsing ] ---
+static char* read_file(const char* path, size_t* size) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long n = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char* buf = n >= 0 ? malloc((size_t)n + 1) : NULL;
+    if (!buf) {
+        fprintf(stderr, "%s: cannot read (out of memory?)\n", path);
+        fclose(f);
+        return NULL;
+    }
+    if (fread(buf, 1, n, f) != (size_t)n) {
+        fprintf(stderr, "%s: read error\n", path);
+        free(buf);
+        fclose(f);
+        return NULL;
+    }
+    buf[n] = '\0';
+    fclose(f);
+    if (size)
+        *size = n;
+    return buf;
+}
+
+// Returns the next line (NUL-terminated in place), or NULL at the end
+static char* next_line(char** cursor) {
+    char* p = *cursor;
+    if (!*p)
+        return NULL;
+    char* nl = strchr(p, '\n');
+    if (nl) {
+        *nl = '\0';
+        *cursor = nl + 1;
+    } else {
+        *cursor = p + strlen(p);
+    }
+    size_t n = strlen(p);
+    if (n && p[n - 1] == '\r')
+        p[n - 1] = '\0';
+    return p;
+}
+
+static bool blank(const char* line) {
+    return line[strspn(line, " \t")] == '\0';
+}
+
+// Two lines: the 13 register pairs, then I R IFF1 IFF2 IM HALT T-states
+static bool parse_registers(const char* l1, char** cur, fuse_state* s) {
+    char* l2 = next_line(cur);
+    unsigned v[13], i, r, iff1, iff2, im, halted;
+    unsigned long ts;
+    if (!l1 || !l2 ||
+        sscanf(l1, "%x %x %x %x %x %x %x %x %x %x %x %x %x", &v[0], &v[1], &v[2],
+               &v[3], &v[4], &v[5], &v[6], &v[7], &v[8], &v[9], &v[10], &v[11],
+               &v[12]) != 13 ||
+        sscanf(l2, "%x %x %u %u %u %u %lu", &i, &r, &iff1, &iff2, &im, &halted,
+               &ts) != 7)
+        return false;
+    s->af = v[0];  s->bc = v[1];  s->de = v[2];  s->hl = v[3];
+    s->af_ = v[4]; s->bc_ = v[5]; s->de_ = v[6]; s->hl_ = v[7];
+    s->ix = v[8];  s->iy = v[9];  s->sp = v[10]; s->pc = v[11];
+    s->memptr = v[12];
+    s->i = i; s->r = r; s->iff1 = iff1; s->iff2 = iff2; s->im = im;
+    s->halted = halted; s->tstates = ts;
+    return true;
+}
+
+// One memory line: "addr byte byte ... -1"
+static bool parse_memory_line(const char* line, fuse_state* s) {
+    char* p;
+    long addr = strtol(line, &p, 16);
+    for (;;) {
+        long v = strtol(p, &p, 16);
+        if (v < 0)
+            return true;
+        if (s->npokes == MAX_POKES)
+            return false;
+        s->poke_addr[s->npokes] = (uint16_t)addr++;
+        s->poke_val[s->npokes++] = (uint8_t)v;
+    }
+}
+
+static fuse_test* fuse_load(const char* dir, int* count) {
+    char path_in[1024], path_exp[1024];
+    snprintf(path_in, sizeof(path_in), "%s/tests.in", dir);
+    snprintf(path_exp, sizeof(path_exp), "%s/tests.expected", dir);
+    char* in = read_file(path_in, NULL);
+    char* exp = read_file(path_exp, NULL);
+    if (!in || !exp) {
+        free(in);
+        free(exp);
+        return NULL;
+    }
+
+    int cap = 2048, n = 0;
+    fuse_test* tests = malloc(cap * sizeof(fuse_test));
+    char* ci = in;
+    char* ce = exp;
+    char* line;
+    bool ok = tests != NULL;
+    const char* failed = NULL;       // Name of the malformed test
+
+    while (ok && (line = next_line(&ci))) {
+        if (blank(line))
+            continue;
+        if (n == cap) {
+            fuse_test* grown = realloc(tests, (size_t)cap * 2 * sizeof(fuse_test));
+            if (!grown) {
+                ok = false;
+                break;
+            }
+            tests = grown;
+            cap *= 2;
+        }
+        fuse_test* t = &tests[n];
+        memset(t, 0, sizeof(*t));
+        snprintf(t->name, sizeof(t->name), "%s", line);
+
+        // tests.in: name, registers, memory lines, "-1"
+        failed = t->name;
+        if (!parse_registers(next_line(&ci), &ci, &t->in)) { ok = false; break; }
+        while (ok && (line = next_line(&ci)) && strtol(line, NULL, 10) != -1)
+            ok = parse_memory_line(line, &t->in);
+        if (!ok)
+            break;
+
+        // tests.expected: name, events (indented), registers, memory, blank
+        while ((line = next_line(&ce)) && blank(line))
+            ;
+        if (!line || strcmp(line, t->name) != 0) {
+            fprintf(stderr, "%s: expected results for \"%s\" not found\n",
+                    path_exp, t->name);
+            free(in);
+            free(exp);
+            free(tests);
+            return NULL;
+        }
+        while ((line = next_line(&ce)) && (line[0] == ' ' || line[0] == '\t'))
+            ;  // Bus events: not checked
+        if (!parse_registers(line, &ce, &t->out)) { ok = false; break; }
+        while (ok && (line = next_line(&ce)) && !blank(line))
+            ok = parse_memory_line(line, &t->out);
+        if (!ok)
+            break;
+        n++;
+        failed = NULL;
+    }
+    free(in);
+    free(exp);
+
+    if (!ok) {
+        if (failed)
+            fprintf(stderr, "%s: malformed test \"%s\"\n", dir, failed);
+        else
+            fprintf(stderr, "%s: out of memory\n", dir);
+        free(tests);
+        return NULL;
+    }
+    *count = n;
+    return tests;
+}
+
+// --- [ Thread Pool ] ---
+typedef struct pool {
+    job* jobs;
+    int njobs;
+    atomic_int next;
+} pool;
+
+static void* worker(void* arg) {
+    pool* p = arg;
+    for (;;) {
+        int k = atomic_fetch_add(&p->next, 1);
+        if (k >= p->njobs)
+            return NULL;
+        job* j = &p->jobs[k];
+        double t0 = now_seconds();
+        if (j->zex)
+            run_zex(j);
+        else
+            run_fuse(j);
+        j->seconds = now_seconds() - t0;
+    }
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "usage: %s [--zex FILE.COM]... [--fuse DIR] [--jobs N]\n"
+            "  --zex FILE   run a ZEXDOC/ZEXALL exerciser, one thread per test group\n"
+            "  --fuse DIR   run DIR/tests.in against DIR/tests.expected\n"
+            "  --jobs N     worker threads (default: number of CPUs)\n",
+            prog);
+}
+
+int main(int argc, char* argv[]) {
+    zex_file zex[16];
+    int nzex = 0;
+    const char* fuse_dir = NULL;
+    int threads = cpu_count();
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--zex") == 0 && i + 1 < argc && nzex < 16)
+            zex[nzex++].path = argv[++i];
+        else if (strcmp(argv[i], "--fuse") == 0 && i + 1 < argc)
+            fuse_dir = argv[++i];
+        else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (!nzex && !fuse_dir) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (threads < 1)
+        threads = 1;
+
+    // --- [ Build the job list ] ---
+    int njobs = 0;
+    for (int z = 0; z < nzex; z++) {
+        zex_file* zf = &zex[z];
+        zf->image = (uint8_t*)read_file(zf->path, &zf->size);
+        if (!zf->image)
+            return 1;
+        if (zf->size > 0xFE00 - 0x100) {
+            fprintf(stderr, "%s: too big for the CP/M TPA\n", zf->path);
+            return 1;
+        }
+        zf->table = zex_find_table(zf->image, zf->size);
+        zf->groups = 1;
+        if (zf->table) {
+            const uint8_t* tbl = zf->image + (zf->table - 0x100);
+            zf->groups = 0;
+            while (tbl[2 * zf->groups] | tbl[2 * zf->groups + 1])
+                zf->groups++;
+        } else {
+            fprintf(stderr, "%s: test table not found, running it as one job\n",
+                    zf->path);
+        }
+        njobs += zf->groups;
+    }
+
+    fuse_test* fuse = NULL;
+    int nfuse = 0;
+    if (fuse_dir) {
+        fuse = fuse_load(fuse_dir, &nfuse);
+        if (!fuse)
+            return 1;
+        njobs += (nfuse + FUSE_TESTS_PER_JOB - 1) / FUSE_TESTS_PER_JOB;
+    }
+
+    job* jobs = calloc(njobs, sizeof(job));
+    if (!jobs) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    int k = 0;
+    for (int z = 0; z < nzex; z++)
+        for (int g = 0; g < zex[z].groups; g++) {
+            jobs[k].zex = &zex[z];
+            jobs[k++].group = g;
+        }
+    for (int t = 0; t < nfuse; t += FUSE_TESTS_PER_JOB) {
+        jobs[k].fuse = fuse + t;
+        jobs[k++].count = nfuse - t < FUSE_TESTS_PER_JOB ? nfuse - t : FUSE_TESTS_PER_JOB;
+    }
+
+    // --- [ Run ] ---
+    pool p = {jobs, njobs, 0};
+    if (threads > njobs)
+        threads = njobs;
+    pthread_t* tid = malloc(threads * sizeof(pthread_t));
+    if (!tid) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    double t0 = now_seconds();
+    int started = 0;
+    while (started < threads && pthread_create(&tid[started], NULL, worker, &p) == 0)
+        started++;
+    if (started < threads) {
+        // Whatever did start keeps going; this thread drains the rest with it
+        fprintf(stderr, "could not start thread %d of %d\n", started + 1, threads);
+        threads = started + 1;
+        worker(&p);
+    }
+    for (int i = 0; i < started; i++)
+        pthread_join(tid[i], NULL);
+    double elapsed = now_seconds() - t0;
+
+    // --- [ Report, in the original order ] ---
+    int zex_failed = 0, zex_groups = 0, fuse_failed = 0;
+    for (int i = 0; i < njobs; i++) {
+        job* j = &jobs[i];
+        if (j->zex) {
+            printf("%-12s %s", j->zex->path, j->out.data ? j->out.data : "(no output)\n");
+            zex_groups++;
+            zex_failed += j->failures;
+        } else {
+            if (j->out.data)
+                fputs(j->out.data, stdout);
+            fuse_failed += j->failures;
+        }
+        free(j->out.data);
+    }
+
+    if (nzex)
+        printf("zex:  %d groups, %d failed\n", zex_groups, zex_failed);
+    if (fuse_dir)
+        printf("fuse: %d tests, %d failed\n", nfuse, fuse_failed);
+    printf("time: %.2f s on %d threads\n", elapsed, threads);
+
+    for (int z = 0; z < nzex; z++)
+        free(zex[z].image);
+    free(fuse);
+    free(jobs);
+    free(tid);
+    return zex_failed || fuse_failed ? 1 : 0;
+}
@@ -0,0 +1,158 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "debug.h"
+
+// --- [ Setup ] ---
+void dbg_attach(zx_debugger* d, zx_spectrum* zx) {
+    memset(d, 0, sizeof(*d));
+    atomic_init(&d->stop_request, false);
+    d->zx = zx;
+    zx->debug = d;
+    zx_update_hooks(zx);
+}
+
+void dbg_detach(zx_debugger* d) {
+    if (!d->zx)
+        return;
+    d->zx->debug = NULL;
+    zx_update_hooks(d->zx);
+    d->zx = NULL;
+}
+
+// --- [ PC Breakpoints ] ---
+void dbg_break_add(zx_debugger* d, uint16_t pc) {
+    if (!dbg_break_at(d, pc)) {
+        d->pc_bits[pc >> 6] |= 1ull << (pc & 63);
+        d->nbreaks++;
+    }
+}
+
+void dbg_break_remove(zx_debugger* d, uint16_t pc) {
+    if (dbg_break_at(d, pc)) {
+        d->pc_bits[pc >> 6] &= ~(1ull << (pc & 63));
+        d->nbreaks--;
+    }
+}
+
+// --- [ Watchpoints ] ---
+// Rebuilds the page and port flags from the watch table, then lets the
+// machine pick the matching memory callbacks.
+static void rebuild_flags(zx_debugger* d) {
+    memset(d->page_flags, 0, sizeof(d->page_flags));
+    memset(d->port_flags, 0, sizeof(d->port_flags));
+    d->mem_watches = false;
+    d->port_watches = false;
+
+    for (int i = 0; i < DBG_MAX_WATCHES; i++) {
+        const dbg_watch* w = &d->watches[i];
+        if (!w->used)
+            continue;
+        if (w->kind & (DBG_WATCH_READ | DBG_WATCH_WRITE)) {
+            for (int p = w->start >> 8; p <= w->end >> 8; p++)
+                d->page_flags[p] |= w->kind;
+            d->mem_watches = true;
+        } else {
+            for (int p = w->start; p <= w->end && p <= w->start + 0xFF; p++)
+                d->port_flags[p & 0xFF] |= w->kind;
+            d->port_watches = true;
+        }
+    }
+    if (d->zx)
+        zx_update_hooks(d->zx);
+}
+
+int dbg_watch_add(zx_debugger* d, uint8_t kind, uint16_t start, uint16_t end) {
+    for (int i = 0; i < DBG_MAX_WATCHES; i++) {
+        dbg_watch* w = &d->watches[i];
+        if (w->used)
+            continue;
+        w->start = start < end ? start : end;
+        w->end = start < end ? end : start;
+        w->kind = kind;
+        w->used = true;
+        rebuild_flags(d);
+        return i;
+    }
+    return -1;
+}
+
+void dbg_watch_remove(zx_debugger* d, int id) {
+    if (id >= 0 && id < DBG_MAX_WATCHES && d->watches[id].used) {
+        d->watches[id].used = false;
+        rebuild_flags(d);
+    }
+}
+
+int dbg_watch_find(const zx_debugger* d, uint8_t kind, uint16_t start, uint16_t end) {
+    for (int i = 0; i < DBG_MAX_WATCHES; i++) {
+        const dbg_watch* w = &d->watches[i];
+        if (w->used && w->kind == kind && w->start == start && w->end == end)
+            return i;
+    }
+    return -1;
+}
+
+void dbg_clear(zx_debugger* d) {
+    memset(d->pc_bits, 0, sizeof(d->pc_bits));
+    d->nbreaks = 0;
+    memset(d->watches, 0, sizeof(d->watches));
+    rebuild_flags(d);
+}
+
+// --- [ Stopping and Resuming ] ---
+void dbg_access(zx_debugger* d, uint8_t kind, uint16_t addr, uint8_t value) {
+    if (d->stop != DBG_STOP_NONE)
+        return;                              // First hit of the instruction wins
+    for (int i = 0; i < DBG_MAX_WATCHES; i++) {
+        const dbg_watch* w = &d->watches[i];
+        // A port range within 00-FF means the low byte, whatever the high one
+        uint16_t a = kind & (DBG_WATCH_IN | DBG_WATCH_OUT) && w->end <= 0xFF ? addr & 0xFF : addr;
+        if (!w->used || w->kind != kind || a < w->start || a > w->end)
+            continue;
+        d->stop = kind == DBG_WATCH_READ  ? DBG_STOP_READ
+                : kind == DBG_WATCH_WRITE ? DBG_STOP_WRITE
+                : kind == DBG_WATCH_IN    ? DBG_STOP_IN : DBG_STOP_OUT;
+        d->stop_pc = d->insn_pc;
+        d->stop_addr = addr;
+        d->stop_value = value;
+        d->stop_watch = i;
+        return;
+    }
+}
+
+void dbg_resume(zx_debugger* d) {
+    // Stopped on a breakpoint: PC is still on it, so step over it once
+    d->skip_break = d->stop == DBG_STOP_BREAK;
+    d->stop = DBG_STOP_NONE;
+}
+
+const char* dbg_stop_text(const zx_debugger* d, char* buf, int size) {
+    switch (d->stop) {
+    case DBG_STOP_BREAK:
+        snprintf(buf, size, "breakpoint %04X", d->stop_pc);
+        break;
+    case DBG_STOP_READ:
+    case DBG_STOP_WRITE:
+        snprintf(buf, size, "%s watchpoint %04X %s %02X (instruction at %04X)",
+                 d->stop == DBG_STOP_READ ? "read" : "write", d->stop_addr,
+                 d->stop == DBG_STOP_READ ? "->" : "=", d->stop_value, d->stop_pc);
+        break;
+    case DBG_STOP_IN:
+    case DBG_STOP_OUT:
+        snprintf(buf, size, "port %s watchpoint %04X %s %02X (instruction at %04X)",
+                 d->stop == DBG_STOP_IN ? "in" : "out", d->stop_addr,
+                 d->stop == DBG_STOP_IN ? "->" : "=", d->stop_value, d->stop_pc);
+        break;
+    case DBG_STOP_STEP:
+        snprintf(buf, size, "step, next instruction at %04X", d->zx ? d->zx->cpu.pc : 0);
+        break;
+    case DBG_STOP_REQUEST:
+        snprintf(buf, size, "stop requested at %04X", d->stop_pc);
+        break;
+    default:
+        snprintf(buf, size, "running");
+        break;
+    }
+    return buf;
+}
@@ -0,0 +1,143 @@
+#ifndef ZX_DEBUG_H_
+#define ZX_DEBUG_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#include "spectrum.h"
+
+// --- [ Breakpoints and Watchpoints ] ---
+// Stops the machine at an instruction boundary when:
+//
+//   - PC reaches a breakpoint (checked before the instruction runs), or
+//   - an instruction reads or writes a watched memory range, or reads or
+//     writes a watched port (checked as it happens; the machine stops right
+//     after that instruction).
+//
+// It can also be stopped from another thread (dbg_request_stop), or made to
+// stop again after a single instruction (d->step).
+//
+// Cost model:
+//   - no debugger attached, or one with nothing set: the plain run loop is
+//     used; a stop request is then noticed when zx_run_until returns.
+//   - PC breakpoints: one bit test per instruction in a 64K-bit bitmap.
+//   - memory watchpoints: the CPU's memory callbacks are switched to checked
+//     versions only while at least one memory watchpoint exists; those test
+//     one flag per 256-byte page and only look at the ranges on a hit.
+//   - port watchpoints: one flag per low port byte, then the ranges. Ports
+//     are full 16-bit addresses; a range within 00-FF matches the low byte
+//     whatever the high one (the way Spectrum devices decode ports).
+//
+// When the machine stops, zx_run_until / zx_run_frame return false with the
+// reason in d->stop. Calling dbg_resume() and then zx_run_frame() again
+// carries on from the same T-state, as if it had never stopped.
+
+#define DBG_MAX_WATCHES 64
+
+typedef enum dbg_stop {
+    DBG_STOP_NONE,
+    DBG_STOP_BREAK,          // PC breakpoint
+    DBG_STOP_READ,           // Memory read watchpoint
+    DBG_STOP_WRITE,          // Memory write watchpoint
+    DBG_STOP_IN,             // Port read watchpoint
+    DBG_STOP_OUT,            // Port write watchpoint
+    DBG_STOP_STEP,           // Single step finished
+    DBG_STOP_REQUEST,        // dbg_request_stop() from another thread
+} dbg_stop;
+
+// Watchpoint kinds (also the per-page flag bits)
+#define DBG_WATCH_READ   0x01
+#define DBG_WATCH_WRITE  0x02
+#define DBG_WATCH_IN     0x04
+#define DBG_WATCH_OUT    0x08
+
+typedef struct dbg_watch {
+    uint16_t start, end;     // Inclusive range (memory addresses or ports)
+    uint8_t  kind;           // One DBG_WATCH_* bit
+    bool     used;
+} dbg_watch;
+
+typedef struct zx_debugger {
+    zx_spectrum* zx;                 // Attached machine
+
+    uint64_t pc_bits[65536 / 64];    // PC breakpoints
+    int      nbreaks;
+
+    dbg_watch watches[DBG_MAX_WATCHES];
+    uint8_t  page_flags[256];        // DBG_WATCH_READ/WRITE per 256-byte page
+    uint8_t  port_flags[256];        // DBG_WATCH_IN/OUT per port low byte (pre-filter)
+    bool     mem_watches;            // At least one memory watchpoint
+    bool     port_watches;           // At least one port watchpoint
+    bool     step;                   // Stop after the next instruction
+    atomic_bool stop_request;        // Set by other threads, taken by the run loop
+
+    // --- Stop state ---
+    dbg_stop stop;
+    uint16_t stop_pc;                // Instruction that caused the stop
+    uint16_t stop_addr;              // Address or port that was accessed
+    uint8_t  stop_value;             // Value read or written
+    int      stop_watch;             // Index of the watchpoint that fired
+
+    uint16_t insn_pc;                // Instruction being executed
+    bool     skip_break;             // Resuming: ignore a breakpoint at PC once
+} zx_debugger;
+
+// Attaches an empty debugger to a machine (zx->debug).
+void dbg_attach(zx_debugger* d, zx_spectrum* zx);
+
+// Detaches it; the machine runs at full speed again.
+void dbg_detach(zx_debugger* d);
+
+void dbg_break_add(zx_debugger* d, uint16_t pc);
+void dbg_break_remove(zx_debugger* d, uint16_t pc);
+
+static inline bool dbg_break_at(const zx_debugger* d, uint16_t pc) {
+    return (d->pc_bits[pc >> 6] >> (pc & 63)) & 1;
+}
+
+// True when the run loop has to look at every instruction
+static inline bool dbg_per_instruction(const zx_debugger* d) {
+    return d->nbreaks || d->mem_watches || d->port_watches || d->step;
+}
+
+// Thread-safe: asks the emulation thread to stop at the next instruction
+// boundary it checks (DBG_STOP_REQUEST).
+static inline void dbg_request_stop(zx_debugger* d) {
+    atomic_store(&d->stop_request, true);
+}
+
+// Run loop side: turns a pending request into a stop at PC
+static inline bool dbg_take_request(zx_debugger* d, uint16_t pc) {
+    if (!atomic_load_explicit(&d->stop_request, memory_order_relaxed) ||
+        !atomic_exchange(&d->stop_request, false))
+        return false;
+    if (d->stop == DBG_STOP_NONE) {
+        d->stop = DBG_STOP_REQUEST;
+        d->stop_pc = pc;
+    }
+    return true;
+}
+
+// Adds a watchpoint on [start, end] and returns its id (-1 if the table is
+// full). "kind" is one of DBG_WATCH_*.
+int dbg_watch_add(zx_debugger* d, uint8_t kind, uint16_t start, uint16_t end);
+void dbg_watch_remove(zx_debugger* d, int id);
+
+// Id of the watchpoint with exactly this kind and range, or -1
+int dbg_watch_find(const zx_debugger* d, uint8_t kind, uint16_t start, uint16_t end);
+
+// Removes every breakpoint and watchpoint.
+void dbg_clear(zx_debugger* d);
+
+// Clears the stop so that the machine can run again.
+void dbg_resume(zx_debugger* d);
+
+// Called by the memory and port callbacks on a flagged page/port:
+// stops the machine if a watchpoint of "kind" covers "addr".
+void dbg_access(zx_debugger* d, uint8_t kind, uint16_t addr, uint8_t value);
+
+// One-line description of the current stop, e.g. "write watchpoint 5C08 = 41"
+const char* dbg_stop_text(const zx_debugger* d, char* buf, int size);
+
+#endif // ZX_DEBUG_H_
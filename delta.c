@@ -0,0 +1,134 @@
+#include <string.h>   // memcpy
+
+#include "delta.h"
+
+// --- [ Optional SSE2 Path ] ---
+// Finding unchanged spans is the hot part of the encoder (it runs every frame
+// over the whole RAM), so it compares 16 bytes per step when SSE2 is available
+// and falls back to 8-byte words otherwise.
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// --- [ Compare Helpers ] ---
+// Returns the number of leading bytes that are equal in both buffers.
+static size_t equal_prefix(const uint8_t* a, const uint8_t* b, size_t n) {
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    for (; i + 16 <= n; i += 16) {
+        __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+        unsigned eq = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb));
+        if (eq != 0xFFFF)
+            return i + (size_t)__builtin_ctz(~eq); // First differing byte
+    }
+#endif
+
+    for (; i + 8 <= n; i += 8) {
+        uint64_t wa, wb;
+        memcpy(&wa, a + i, 8);   // memcpy keeps unaligned loads legal
+        memcpy(&wb, b + i, 8);
+        if (wa != wb)
+            break;               // Finish byte by byte below
+    }
+
+    while (i < n && a[i] == b[i])
+        i++;
+    return i;
+}
+
+// Returns the number of leading bytes that differ in both buffers.
+// Short equal gaps (shorter than a run header) are swallowed into the
+// literal run, since splitting there would make the output larger.
+static size_t changed_prefix(const uint8_t* a, const uint8_t* b, size_t n) {
+    size_t i = 0;
+    while (i < n) {
+        if (a[i] != b[i]) {
+            i++;
+            continue;
+        }
+        size_t gap = equal_prefix(a + i, b + i, n - i);
+        if (gap >= 4 || i + gap == n)
+            break;
+        i += gap;
+    }
+    return i;
+}
+
+// --- [ Varint Helpers (7 bits per byte, LSB first) ] ---
+static size_t put_varint(uint8_t* out, size_t v) {
+    size_t len = 0;
+    while (v >= 0x80) {
+        out[len++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    out[len++] = (uint8_t)v;
+    return len;
+}
+
+static size_t get_varint(const uint8_t* in, size_t size, size_t* v) {
+    size_t len = 0, shift = 0;
+    *v = 0;
+    while (len < size) {
+        uint8_t b = in[len++];
+        *v |= (size_t)(b & 0x7F) << shift;
+        if (!(b & 0x80))
+            return len;
+        shift += 7;
+    }
+    return 0; // Truncated input
+}
+
+// --- [ Encoder ] ---
+size_t delta_encode(const uint8_t* cur, const uint8_t* ref, size_t n,
+                    uint8_t* out, size_t cap) {
+    size_t pos = 0, size = 0;
+
+    while (pos < n) {
+        size_t skip = equal_prefix(cur + pos, ref + pos, n - pos);
+        if (pos + skip == n)
+            break;  // Trailing unchanged bytes are implicit
+
+        size_t len = changed_prefix(cur + pos + skip, ref + pos + skip,
+                                    n - pos - skip);
+
+        // Two varints take at most 20 bytes on 64-bit hosts
+        if (size + 20 + len > cap)
+            return DELTA_OVERFLOW;
+
+        size += put_varint(out + size, skip);
+        size += put_varint(out + size, len);
+        pos += skip;
+
+        // XOR loop is trivially vectorised by the compiler
+        for (size_t i = 0; i < len; i++)
+            out[size + i] = cur[pos + i] ^ ref[pos + i];
+        size += len;
+        pos += len;
+    }
+    return size;
+}
+
+// --- [ Decoder ] ---
+void delta_apply(uint8_t* buf, size_t n, const uint8_t* delta, size_t size) {
+    size_t pos = 0, i = 0;
+
+    while (i < size) {
+        size_t skip, len, used;
+
+        if (!(used = get_varint(delta + i, size - i, &skip))) return;
+        i += used;
+        if (!(used = get_varint(delta + i, size - i, &len))) return;
+        i += used;
+
+        pos += skip;
+        if (pos + len > n || i + len > size)
+            return;  // Corrupted delta: never write out of bounds
+
+        for (size_t k = 0; k < len; k++)
+            buf[pos + k] ^= delta[i + k];
+        pos += len;
+        i += len;
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef ZX_DELTA_H_
+#define ZX_DELTA_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// --- [ XOR/RLE Delta Codec ] ---
+// Encodes the difference between two equally sized buffers as a list of runs:
+//
+//   <skip varint> <len varint> <len bytes of (cur XOR ref)>   ... repeated
+//
+// "skip" counts unchanged bytes, "len" counts the changed bytes that follow.
+// Between two consecutive Spectrum frames only a small part of RAM changes,
+// so the encoded delta is usually a few hundred bytes instead of 48 KB.
+
+// Worst-case encoded size for an "n"-byte buffer (every byte changed)
+#define DELTA_MAX_SIZE(n) ((n) + 16)
+
+// Returned by delta_encode when the output buffer is too small
+#define DELTA_OVERFLOW ((size_t)-1)
+
+// Encodes (cur XOR ref) into "out", writing at most "cap" bytes.
+// Returns the encoded size (0 when both buffers are identical).
+size_t delta_encode(const uint8_t* cur, const uint8_t* ref, size_t n,
+                    uint8_t* out, size_t cap);
+
+// Applies an encoded delta in place: buf ^= delta.
+// "buf" must hold the same reference the delta was computed against.
+void delta_apply(uint8_t* buf, size_t n, const uint8_t* delta, size_t size);
+
+#endif // ZX_DELTA_H_
@@ -0,0 +1,634 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET sock_t;
+#define sock_close closesocket
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+typedef int sock_t;
+#define sock_close close
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0        // No SIGPIPE to suppress (Windows)
+#endif
+
+#include "gdbstub.h"
+
+#define POLL_MS     10        // Waiting loops look at the socket this often
+#define NUM_REGS    13        // AF BC DE HL SP PC IX IY AF' BC' DE' HL' IR
+
+#define SOCK(s)     ((sock_t)(s))
+
+// --- [ Socket Input ] ---
+// 1 = readable, 0 = timeout, -1 = error
+static int wait_readable(intptr_t s, int ms) {
+    fd_set set;
+    FD_ZERO(&set);
+    FD_SET(SOCK(s), &set);
+    struct timeval tv = {ms / 1000, (ms % 1000) * 1000};
+    int n = select((int)SOCK(s) + 1, &set, NULL, NULL, &tv);
+    if (n < 0 && errno == EINTR)
+        return 0;
+    return n < 0 ? -1 : n > 0;
+}
+
+// Makes sure some input is buffered: 1 = yes, 0 = not yet, -1 = client gone
+static int fill(gdb_stub* g, int ms) {
+    if (g->rpos < g->rlen)
+        return 1;
+    int r = wait_readable(g->client_sock, ms);
+    if (r <= 0)
+        return r;
+    int n = recv(SOCK(g->client_sock), (char*)g->rbuf, sizeof(g->rbuf), 0);
+    if (n <= 0)
+        return -1;
+    g->rpos = 0;
+    g->rlen = n;
+    return 1;
+}
+
+// Next input byte; -1 if the client went away or the stub is quitting
+static int get_byte(gdb_stub* g) {
+    for (;;) {
+        int r = fill(g, POLL_MS * 10);
+        if (r < 0 || atomic_load(&g->quit))
+            return -1;
+        if (r > 0)
+            return g->rbuf[g->rpos++];
+    }
+}
+
+static bool send_all(gdb_stub* g, const char* p, int n) {
+    while (n > 0) {
+        int k = send(SOCK(g->client_sock), p, n, MSG_NOSIGNAL);
+        if (k <= 0)
+            return false;
+        p += k;
+        n -= k;
+    }
+    return true;
+}
+
+// --- [ Packets: $data#checksum ] ---
+static int hex_digit(int c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static unsigned long parse_hex(const char** p) {
+    unsigned long v = 0;
+    int d;
+    while ((d = hex_digit(**p)) >= 0) {
+        v = v << 4 | d;
+        (*p)++;
+    }
+    return v;
+}
+
+// Appends "n" bytes of "v", low byte first (the target's byte order)
+static char* put_hex_le(char* out, unsigned v, int n) {
+    static const char digits[] = "0123456789abcdef";
+    for (int i = 0; i < n; i++, v >>= 8) {
+        *out++ = digits[(v >> 4) & 15];
+        *out++ = digits[v & 15];
+    }
+    *out = 0;
+    return out;
+}
+
+static unsigned get_hex_le(const char* p, int n) {
+    unsigned v = 0;
+    for (int i = 0; i < n; i++)
+        v |= (unsigned)(hex_digit(p[2 * i]) << 4 | hex_digit(p[2 * i + 1])) << 8 * i;
+    return v;
+}
+
+static bool send_packet(gdb_stub* g, const char* data) {
+    char* buf = g->sbuf;
+    int n = (int)strlen(data);
+    uint8_t sum = 0;
+    buf[0] = '$';
+    for (int i = 0; i < n; i++) {
+        buf[1 + i] = data[i];
+        sum += (uint8_t)data[i];
+    }
+    static const char digits[] = "0123456789abcdef";
+    buf[1 + n] = '#';                 // No NUL: "sbuf" has no room for one
+    buf[2 + n] = digits[sum >> 4];
+    buf[3 + n] = digits[sum & 15];
+
+    for (int tries = 0; tries < 5; tries++) {
+        if (!send_all(g, buf, n + 4))
+            return false;
+        int c = get_byte(g);
+        if (c < 0)
+            return false;
+        if (c != '-') {               // '+' (or no acks at all: keep that byte)
+            if (c != '+')
+                g->rpos--;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Reads the next packet into "buf" (NUL-terminated) and acknowledges it.
+// Acks and stray Ctrl-C bytes in between are skipped. -1 = client gone.
+static int read_packet(gdb_stub* g, char* buf, int size) {
+    for (;;) {
+        int c;
+        do {
+            if ((c = get_byte(g)) < 0)
+                return -1;
+        } while (c != '$');
+
+        int n = 0;
+        uint8_t sum = 0;
+        while ((c = get_byte(g)) >= 0 && c != '#') {
+            sum += (uint8_t)c;
+            if (n < size - 1)
+                buf[n++] = (char)c;
+        }
+        int h = c < 0 ? -1 : get_byte(g);
+        int l = h < 0 ? -1 : get_byte(g);
+        if (l < 0)
+            return -1;
+        buf[n] = 0;
+        if (hex_digit(h) << 4 == (sum & 0xF0) && hex_digit(l) == (sum & 15) && n < size - 1) {
+            send_all(g, "+", 1);
+            return n;
+        }
+        send_all(g, "-", 1);          // Bad checksum or too long: ask again
+    }
+}
+
+// --- [ Registers ] ---
+// GDB's Z80 register numbering
+static unsigned get_reg(z80* z, int n) {
+    switch (n) {
+    case 0:  return z->a << 8 | z80_get_f(z);
+    case 1:  return z->b << 8 | z->c;
+    case 2:  return z->d << 8 | z->e;
+    case 3:  return z->h << 8 | z->l;
+    case 4:  return z->sp;
+    case 5:  return z->pc;
+    case 6:  return z->ix;
+    case 7:  return z->iy;
+    case 8:  return z->a_ << 8 | z->f_;
+    case 9:  return z->b_ << 8 | z->c_;
+    case 10: return z->d_ << 8 | z->e_;
+    case 11: return z->h_ << 8 | z->l_;
+    default: return z->i << 8 | z->r;
+    }
+}
+
+static void set_reg(z80* z, int n, unsigned v) {
+    uint8_t hi = (uint8_t)(v >> 8), lo = (uint8_t)v;
+    switch (n) {
+    case 0:  z->a = hi; z80_set_f(z, lo); break;
+    case 1:  z->b = hi; z->c = lo; break;
+    case 2:  z->d = hi; z->e = lo; break;
+    case 3:  z->h = hi; z->l = lo; break;
+    case 4:  z->sp = (uint16_t)v; break;
+    case 5:  z->pc = (uint16_t)v; break;
+    case 6:  z->ix = (uint16_t)v; break;
+    case 7:  z->iy = (uint16_t)v; break;
+    case 8:  z->a_ = hi; z->f_ = lo; break;
+    case 9:  z->b_ = hi; z->c_ = lo; break;
+    case 10: z->d_ = hi; z->e_ = lo; break;
+    case 11: z->h_ = hi; z->l_ = lo; break;
+    default: z->i = hi; z->r = lo; break;
+    }
+}
+
+// --- [ Breakpoints and Watchpoints (Z/z packets) ] ---
+// "access": the watchpoint belongs to a Z4 pair (reported as awatch)
+static bool set_watch(gdb_stub* g, bool insert, bool access, uint8_t kind,
+                      uint16_t start, uint16_t end) {
+    zx_debugger* d = g->debug;
+    if (insert) {
+        int id = dbg_watch_add(d, kind, start, end);
+        if (id >= 0)
+            g->access[id] = access;
+        return id >= 0;
+    }
+    for (int id = 0; id < DBG_MAX_WATCHES; id++) {
+        const dbg_watch* w = &d->watches[id];
+        if (w->used && w->kind == kind && w->start == start && w->end == end &&
+            g->access[id] == access) {
+            dbg_watch_remove(d, id);
+            break;
+        }
+    }
+    return true;
+}
+
+// "type,addr,kind". Returns the reply: "OK", "E01" or "" (not supported).
+static const char* set_point(gdb_stub* g, bool insert, const char* p) {
+    zx_debugger* d = g->debug;
+    int type = (int)parse_hex(&p);
+    if (*p++ != ',')
+        return "E01";
+    unsigned long addr = parse_hex(&p);
+    unsigned long len = *p == ',' ? (p++, parse_hex(&p)) : 1;
+    if (addr > 0xFFFF)
+        return "E01";
+    uint16_t start = (uint16_t)addr;
+    uint16_t end = len == 0 ? start : addr + len - 1 > 0xFFFF ? 0xFFFF : (uint16_t)(addr + len - 1);
+
+    switch (type) {
+    case 0:                           // Software and hardware breakpoints
+    case 1:                           // are the same thing here
+        if (insert)
+            dbg_break_add(d, start);
+        else
+            dbg_break_remove(d, start);
+        return "OK";
+    case 2:
+        return set_watch(g, insert, false, DBG_WATCH_WRITE, start, end) ? "OK" : "E01";
+    case 3:
+        return set_watch(g, insert, false, DBG_WATCH_READ, start, end) ? "OK" : "E01";
+    case 4:                           // Access: one read and one write watchpoint
+        if (!set_watch(g, insert, true, DBG_WATCH_READ, start, end))
+            return "E01";
+        if (!set_watch(g, insert, true, DBG_WATCH_WRITE, start, end)) {
+            set_watch(g, false, true, DBG_WATCH_READ, start, end);
+            return "E01";
+        }
+        return "OK";
+    default:
+        return "";
+    }
+}
+
+// --- [ Handing the Machine Over ] ---
+static void deadline_after(struct timespec* ts, int ms) {
+    timespec_get(ts, TIME_UTC);
+    ts->tv_sec += ms / 1000;
+    ts->tv_nsec += (long)(ms % 1000) * 1000000L;
+    if (ts->tv_nsec >= 1000000000L) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
+}
+
+// Waits up to "ms" for the emulation thread to park; true once it has
+static bool parked_within(gdb_stub* g, int ms) {
+    struct timespec deadline;
+    deadline_after(&deadline, ms);
+    pthread_mutex_lock(&g->lock);
+    if (!g->parked && ms > 0)
+        pthread_cond_timedwait(&g->cond, &g->lock, &deadline);
+    bool parked = g->parked;
+    pthread_mutex_unlock(&g->lock);
+    return parked;
+}
+
+// Lets the machine run until it parks in gdb_wait, passing Ctrl-C from the
+// client on as a stop request. False if the client went away meanwhile.
+static bool wait_stopped(gdb_stub* g) {
+    for (;;) {
+        // Input other than Ctrl-C is a packet for after the stop: leave it
+        bool pending = g->rpos < g->rlen && g->rbuf[g->rpos] != 0x03;
+        if (parked_within(g, pending ? POLL_MS : 0))
+            return true;
+        if (atomic_load(&g->quit))
+            return false;
+        if (pending)
+            continue;
+        int r = fill(g, POLL_MS);
+        if (r < 0)
+            return false;
+        if (r > 0 && g->rbuf[g->rpos] == 0x03) {
+            g->rpos++;
+            g->interrupted = true;
+            dbg_request_stop(g->debug);
+        }
+    }
+}
+
+// Gives the parked machine back to the emulation thread
+static void resume(gdb_stub* g, bool step) {
+    zx_debugger* d = g->debug;
+    pthread_mutex_lock(&g->lock);
+    dbg_resume(d);
+    atomic_store(&d->stop_request, false);
+    d->step = step;
+    if (step)
+        d->skip_break = true;         // A step always runs the instruction at PC
+    g->interrupted = false;
+    g->parked = false;
+    pthread_cond_broadcast(&g->cond);
+    pthread_mutex_unlock(&g->lock);
+}
+
+static void stop_reply(const gdb_stub* g, char* out) {
+    const zx_debugger* d = g->debug;
+    bool access = d->stop_watch >= 0 && d->stop_watch < DBG_MAX_WATCHES &&
+                  g->access[d->stop_watch];
+    switch (d->stop) {
+    case DBG_STOP_WRITE:
+    case DBG_STOP_READ:
+        if (access)
+            sprintf(out, "T05awatch:%04x;", d->stop_addr);
+        else if (d->stop == DBG_STOP_WRITE)
+            sprintf(out, "T05watch:%04x;", d->stop_addr);
+        else
+            sprintf(out, "T05rwatch:%04x;", d->stop_addr);
+        break;
+
+    case DBG_STOP_REQUEST:
+        strcpy(out, g->interrupted ? "S02" : "S05");   // SIGINT for Ctrl-C
+        break;
+    default:
+        strcpy(out, "S05");                             // SIGTRAP
+        break;
+    }
+}
+
+// --- [ Client Session ] ---
+static void serve_client(gdb_stub* g) {
+    char* pkt = g->pkt;
+    char* out = g->out;
+    z80* cpu = &g->zx->cpu;
+    bool detached = false;
+
+    // GDB expects a stopped target as soon as it connects
+    g->interrupted = false;
+    dbg_request_stop(g->debug);
+    if (!wait_stopped(g))
+        goto done;
+
+    while (read_packet(g, pkt, sizeof(g->pkt)) >= 0) {
+        const char* p = pkt + 1;
+        char* o = out;
+        out[0] = 0;
+
+        switch (pkt[0]) {
+        case '?':
+            stop_reply(g, out);
+            break;
+        case 'g':
+            for (int i = 0; i < NUM_REGS; i++)
+                o = put_hex_le(o, get_reg(cpu, i), 2);
+            break;
+        case 'G':
+            if (strlen(p) < NUM_REGS * 4) {
+                strcpy(out, "E01");
+                break;
+            }
+            for (int i = 0; i < NUM_REGS; i++)
+                set_reg(cpu, i, get_hex_le(p + 4 * i, 2));
+            strcpy(out, "OK");
+            break;
+        case 'p': {
+            unsigned long n = parse_hex(&p);
+            if (n < NUM_REGS)
+                put_hex_le(out, get_reg(cpu, (int)n), 2);
+            else
+                strcpy(out, "E01");
+            break;
+        }
+        case 'P': {
+            unsigned long n = parse_hex(&p);
+            if (n >= NUM_REGS || *p != '=' || strlen(p + 1) < 4) {
+                strcpy(out, "E01");
+                break;
+            }
+            set_reg(cpu, (int)n, get_hex_le(p + 1, 2));
+            strcpy(out, "OK");
+            break;
+        }
+        case 'm': {
+            unsigned long addr = parse_hex(&p), len = 0;
+            if (*p == ',') {
+                p++;
+                len = parse_hex(&p);
+            }
+            if (len > GDB_PACKET_MAX / 2)
+                len = GDB_PACKET_MAX / 2;
+            for (unsigned long i = 0; i < len; i++)
+                o = put_hex_le(o, zx_peek(g->zx, (uint16_t)(addr + i)), 1);
+            break;
+        }
+        case 'M': {
+            unsigned long addr = parse_hex(&p), len = 0;
+            if (*p == ',') {
+                p++;
+                len = parse_hex(&p);
+            }
+            if (*p++ != ':' || strlen(p) < len * 2) {
+                strcpy(out, "E01");
+                break;
+            }
+            for (unsigned long i = 0; i < len; i++)
+                zx_poke(g->zx, (uint16_t)(addr + i), (uint8_t)get_hex_le(p + 2 * i, 1));
+            z80_blocks_flush(cpu->blocks);   // Code may have changed under it
+            z80_icache_flush(cpu->icache);
+            strcpy(out, "OK");
+            break;
+        }
+        case 'c':
+        case 's':
+            if (*p)
+                cpu->pc = (uint16_t)parse_hex(&p);
+            resume(g, pkt[0] == 's');
+            if (!wait_stopped(g))
+                goto done;
+            stop_reply(g, out);
+            break;
+        case 'Z':
+        case 'z':
+            strcpy(out, set_point(g, pkt[0] == 'Z', p));
+            break;
+        case 'D':
+            send_packet(g, "OK");
+            detached = true;
+            goto done;
+        case 'k':
+            goto done;
+        case 'H':
+        case 'T':
+            strcpy(out, "OK");        // Only one thread
+            break;
+        case 'q':
+            if (strncmp(pkt, "qSupported", 10) == 0)
+                sprintf(out, "PacketSize=%x", GDB_PACKET_MAX);
+            else if (strcmp(pkt, "qAttached") == 0)
+                strcpy(out, "1");
+            else if (strcmp(pkt, "qC") == 0)
+                strcpy(out, "QC1");
+            else if (strcmp(pkt, "qfThreadInfo") == 0)
+                strcpy(out, "m1");
+            else if (strcmp(pkt, "qsThreadInfo") == 0)
+                strcpy(out, "l");
+            break;
+        default:
+            break;                    // Empty reply: not supported (X, vCont...)
+        }
+        if (!send_packet(g, out))
+            break;
+    }
+
+done:
+    // The machine carries on without the client. One that vanished without
+    // detaching cannot remove its breakpoints, so they all go.
+    if (!detached) {
+        dbg_request_stop(g->debug);
+        while (!parked_within(g, POLL_MS) && !atomic_load(&g->quit))
+            ;
+    }
+    if (parked_within(g, 0)) {
+        if (!detached)
+            dbg_clear(g->debug);
+        resume(g, false);
+    }
+}
+
+static void* stub_thread(void* arg) {
+    gdb_stub* g = arg;
+    while (!atomic_load(&g->quit)) {
+        if (wait_readable(g->listen_sock, POLL_MS * 10) <= 0)
+            continue;
+        sock_t c = accept(SOCK(g->listen_sock), NULL, NULL);
+        if (c == (sock_t)-1)
+            continue;
+        int one = 1;                  // Small packets, sent at once (TCP only)
+        setsockopt(c, IPPROTO_TCP, TCP_NODELAY, (const char*)&one, sizeof(one));
+        g->client_sock = (intptr_t)c;
+        g->rpos = g->rlen = 0;
+        serve_client(g);
+        sock_close(c);
+        g->client_sock = -1;
+    }
+    return NULL;
+}
+
+// --- [ Setup ] ---
+bool gdb_start(gdb_stub* g, zx_spectrum* zx, zx_debugger* debug, const char* where) {
+    memset(g, 0, sizeof(*g));
+    g->zx = zx;
+    g->debug = debug;
+    g->listen_sock = g->client_sock = -1;
+    atomic_init(&g->quit, false);
+
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        fprintf(stderr, "gdb: no Winsock\n");
+        return false;
+    }
+#endif
+
+    sock_t s;
+    bool ok;
+    if (strchr(where, '/')) {
+#ifdef _WIN32
+        fprintf(stderr, "gdb: Unix sockets are not supported here, use a port\n");
+        return false;
+#else
+        struct sockaddr_un sa;
+        memset(&sa, 0, sizeof(sa));
+        if (strlen(where) >= sizeof(sa.sun_path) || strlen(where) >= sizeof(g->unix_path)) {
+            fprintf(stderr, "gdb: socket path too long: %s\n", where);
+            return false;
+        }
+        sa.sun_family = AF_UNIX;
+        strcpy(sa.sun_path, where);
+        unlink(where);                // Left over from an earlier run
+        s = socket(AF_UNIX, SOCK_STREAM, 0);
+        ok = s != (sock_t)-1 && bind(s, (struct sockaddr*)&sa, sizeof(sa)) == 0;
+        if (ok)
+            strcpy(g->unix_path, where);
+#endif
+    } else {
+        char* end;
+        long port = strtol(where, &end, 10);
+        if (*end || port <= 0 || port > 65535) {
+            fprintf(stderr, "gdb: bad port: %s\n", where);
+            return false;
+        }
+        struct sockaddr_in sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sin_family = AF_INET;
+        sa.sin_port = htons((uint16_t)port);
+        sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);   // Local clients only
+        s = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        ok = s != (sock_t)-1 &&
+             setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char*)&one, sizeof(one)) == 0 &&
+             bind(s, (struct sockaddr*)&sa, sizeof(sa)) == 0;
+    }
+    if (!ok || listen(s, 1) != 0) {
+        fprintf(stderr, "gdb: cannot listen on %s\n", where);
+        if (s != (sock_t)-1)
+            sock_close(s);
+        return false;
+    }
+    g->listen_sock = (intptr_t)s;
+
+    pthread_mutex_init(&g->lock, NULL);
+    pthread_cond_init(&g->cond, NULL);
+    if (pthread_create(&g->thread, NULL, stub_thread, g) != 0) {
+        fprintf(stderr, "gdb: cannot start the server thread\n");
+        sock_close(s);
+        g->listen_sock = -1;
+        return false;
+    }
+    return true;
+}
+
+bool gdb_wait(gdb_stub* g, int timeout_ms) {
+    struct timespec deadline;
+    if (timeout_ms >= 0)
+        deadline_after(&deadline, timeout_ms);
+
+    pthread_mutex_lock(&g->lock);
+    if (!g->parked) {
+        g->parked = true;             // The stub may touch the machine from now on
+        pthread_cond_broadcast(&g->cond);
+    }
+    while (g->parked && !atomic_load(&g->quit)) {
+        if (timeout_ms < 0)
+            pthread_cond_wait(&g->cond, &g->lock);
+        else if (pthread_cond_timedwait(&g->cond, &g->lock, &deadline) == ETIMEDOUT)
+            break;
+    }
+    bool resumed = !g->parked;
+    pthread_mutex_unlock(&g->lock);
+    return resumed;
+}
+
+void gdb_stop(gdb_stub* g) {
+    if (g->listen_sock == -1)
+        return;
+    atomic_store(&g->quit, true);
+    pthread_join(g->thread, NULL);
+    sock_close(SOCK(g->listen_sock));
+    g->listen_sock = -1;
+#ifndef _WIN32
+    if (g->unix_path[0])
+        unlink(g->unix_path);
+#endif
+    pthread_cond_destroy(&g->cond);
+    pthread_mutex_destroy(&g->lock);
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
@@ -0,0 +1,76 @@
+#ifndef ZX_GDBSTUB_H_
+#define ZX_GDBSTUB_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "spectrum.h"
+#include "debug.h"
+
+// --- [ GDB Remote Stub ] ---
+// Lets GDB (or any client speaking the GDB remote serial protocol) attach
+// to a running emulator over a local socket:
+//
+//   gdb -ex "set architecture z80" -ex "target remote localhost:1234"
+//
+// What the client sees:
+//   - registers, in GDB's Z80 order: AF BC DE HL SP PC IX IY AF' BC' DE'
+//     HL' IR (16 bits each)
+//   - the whole 64 KB address space (ROM included, writes go through)
+//   - breakpoints (Z0/Z1), write/read/access watchpoints (Z2/Z3/Z4),
+//     single step, continue, and Ctrl-C
+//
+// Threads: the stub serves the socket on its own thread and never touches
+// the machine while it runs. All the emulation thread has to do is call
+// gdb_wait() whenever zx_run_frame() comes back stopped; the machine is
+// then parked there, at an instruction boundary, and the stub reads and
+// writes it until the client resumes it.
+//
+// The stub works through the debugger (debug.h), so while the client has
+// no breakpoints or watchpoints set the plain run loop is used and Ctrl-C
+// takes effect at the end of the current frame.
+
+#define GDB_PACKET_MAX 4096              // Largest packet in either direction (advertised)
+
+typedef struct gdb_stub {
+    zx_spectrum* zx;
+    zx_debugger* debug;                  // Attached to zx by the caller
+
+    intptr_t listen_sock;                // -1 when closed
+    intptr_t client_sock;
+    char     unix_path[108];             // Unix socket to remove at the end
+
+    pthread_t       thread;
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    bool            parked;              // Emulation thread waits in gdb_wait
+    bool            interrupted;         // Current stop came from Ctrl-C
+    atomic_bool     quit;
+
+    uint8_t rbuf[512];                   // Socket input not consumed yet
+    int     rpos, rlen;
+
+    // --- Stub thread only ---
+    char    pkt[GDB_PACKET_MAX + 1];     // Packet being served
+    char    out[GDB_PACKET_MAX + 1];     // Its reply
+    char    sbuf[GDB_PACKET_MAX + 4];    // Reply framed as "$...#xx"
+    bool    access[DBG_MAX_WATCHES];     // Watchpoint is half of a Z4 pair
+} gdb_stub;
+
+// Starts listening on "where": a TCP port on 127.0.0.1 ("1234"), or a Unix
+// socket path (anything with a '/', not on Windows). "debug" must already
+// be attached to "zx".
+bool gdb_start(gdb_stub* g, zx_spectrum* zx, zx_debugger* debug, const char* where);
+
+// Emulation thread, after a stop (debug->stop != DBG_STOP_NONE): hands the
+// machine to the stub and waits up to "timeout_ms" (-1 = forever) for the
+// client to resume it. Returns true once it is resumed; false on timeout,
+// in which case the caller keeps calling it (e.g. once per UI frame).
+bool gdb_wait(gdb_stub* g, int timeout_ms);
+
+// Disconnects the client, stops the thread and closes the sockets.
+void gdb_stop(gdb_stub* g);
+
+#endif // ZX_GDBSTUB_H_
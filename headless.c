@@ -0,0 +1,474 @@
+// --- [ Headless Runner ] ---
+// Runs the emulator without any window, sound or SDL at all.
+// With --replay it feeds a recorded input movie back into the machine, which
+// gives bit-identical runs that can be timed and compared across builds.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>     // timespec_get (wall clock timing)
+
+#include "spectrum.h"
+#include "movie.h"
+#include "video.h"
+#include "screenhash.h"
+#include "hotspot.h"
+#include "trace.h"
+#include "debug.h"
+#include "gdbstub.h"
+#include "z80dis.h"
+#include "sound.h"
+#include "script.h"
+
+static double now_seconds(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// "5C00" or "5C00-5CFF" (hex)
+static bool parse_range(const char* s, uint16_t* start, uint16_t* end) {
+    char* p;
+    unsigned long a = strtoul(s, &p, 16), b = a;
+    if (p == s)
+        return false;
+    if (*p == '-')
+        b = strtoul(p + 1, &p, 16);
+    if (*p || a > 0xFFFF || b > 0xFFFF)
+        return false;
+    *start = (uint16_t)a;
+    *end = (uint16_t)b;
+    return true;
+}
+
+// --- [ WAV Output (--wav) ] ---
+// 16-bit mono PCM, little-endian like every host this builds on
+#define WAV_RATE 44100
+
+static void put_le(FILE* f, uint32_t v, int bytes) {
+    for (int i = 0; i < bytes; i++)
+        fputc((int)(v >> (8 * i)) & 0xFF, f);
+}
+
+static void wav_header(FILE* f, uint32_t samples) {
+    uint32_t data = samples * 2;
+    fwrite("RIFF", 1, 4, f);
+    put_le(f, 36 + data, 4);
+    fwrite("WAVEfmt ", 1, 8, f);
+    put_le(f, 16, 4);                  // Format chunk size
+    put_le(f, 1, 2);                   // PCM
+    put_le(f, 1, 2);                   // Mono
+    put_le(f, WAV_RATE, 4);
+    put_le(f, WAV_RATE * 2, 4);        // Bytes per second
+    put_le(f, 2, 2);                   // Bytes per sample
+    put_le(f, 16, 2);                  // Bits per sample
+    fwrite("data", 1, 4, f);
+    put_le(f, data, 4);
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "usage: %s [--128] [--kempston] [--rom FILE] [--replay MOVIE | --script FILE] [--frames N]\n"
+            "          [--video FILE] [--until-hash HEX] [--mask COL,ROW,W,H]... [--profile FILE]\n"
+            "          [--hotspots FILE [--symbols FILE]...] [--trace FILE [--trace-last N]]\n"
+            "          [--break ADDR]... [--watch-read|--watch-write|--watch-in|--watch-out RANGE]...\n"
+            "          [--continue] [--gdb PORT|PATH] [--blocks] [--icache] [--core exact|fast] [--wav FILE]\n"
+            "  --128           ZX Spectrum 128K (paged memory, 0x7FFD)\n"
+            "  --kempston      attach a Kempston joystick interface (port 0x1F)\n"
+            "  --rom FILE      ROM image (default 48.rom, or 128.rom with --128)\n"
+            "  --replay MOVIE  play back an input movie recorded with --record\n"
+            "  --script FILE   type and wait as the input script says (see script.h);\n"
+            "                  exit status 5 if one of its waits times out\n"
+            "  --frames N      stop after N frames (default: end of movie or script, or 500)\n"
+            "  --video FILE    capture the screen (.y4m or native .zxv)\n"
+            "  --until-hash H  stop at the first frame whose screen hash is H\n"
+            "                  (exit status 3 if it never appears)\n"
+            "  --mask C,R,W,H  leave a rectangle of 8x8 cells out of the hash\n"
+            "  --profile FILE  write the opcode profile (build with PROFILE=1)\n"
+            "  --hotspots FILE write guest call stacks (folded, for flamegraph.pl)\n"
+            "                  and print the busiest routines\n"
+            "  --symbols FILE  extra labels for --hotspots (\"ADDR NAME\" lines)\n"
+            "  --trace FILE    binary trace of every instruction (read it with zxtrace)\n"
+            "  --trace-last N  only keep the last N instructions in the trace\n"
+            "  --break ADDR    stop when PC reaches ADDR (hex)\n"
+            "  --watch-read A[-B], --watch-write A[-B]\n"
+            "                  stop when memory A..B is read / written\n"
+            "  --watch-in P[-Q], --watch-out P[-Q]\n"
+            "                  stop when port P..Q is read / written (P, Q up to FF: low byte)\n"
+            "  --continue      log every stop and keep running (default: exit, status 4)\n"
+            "  --gdb PORT|PATH serve the GDB remote protocol on a local TCP port or Unix\n"
+            "                  socket; stops wait for the client (runs until killed)\n"
+            "  --blocks        run hot code from the block cache (same results, faster)\n"
+            "  --icache        keep every instruction decoded (same results, faster)\n"
+            "  --core fast     Z80 core without MEMPTR, XF/YF flags and R updates\n"
+            "                  (faster; checksums and replays differ from exact)\n"
+            "  --wav FILE      write the beeper/AY sound (44.1 kHz mono WAV)\n",
+            prog);
+}
+
+int main(int argc, char* argv[]) {
+    const char* rom = NULL;
+    zx_model model = ZX_MODEL_48K;
+    const char* replay = NULL;
+    const char* video_path = NULL;
+    const char* profile_path = NULL;
+    const char* hotspot_path = NULL;
+    const char* symbol_paths[16];
+    int nsymbols = 0;
+    const char* trace_path = NULL;
+    long trace_last = 0;
+    static zx_debugger debug;
+    bool debugging = false, keep_going = false;
+    const char* gdb_where = NULL;
+    bool use_blocks = false, use_icache = false;
+    bool fast_core = false;
+    const char* wav_path = NULL;
+    bool kempston = false;
+    const char* script_path = NULL;
+    memset(&debug, 0, sizeof(debug));
+    long max_frames = -1;
+    bool wait_hash = false;
+    uint64_t target_hash = 0;
+    zx_hash_mask mask;
+    zx_hash_mask_init(&mask);
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--rom") == 0 && i + 1 < argc)
+            rom = argv[++i];
+        else if (strcmp(argv[i], "--kempston") == 0)
+            kempston = true;
+        else if (strcmp(argv[i], "--128") == 0)
+            model = ZX_MODEL_128K;
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+            replay = argv[++i];
+        else if (strcmp(argv[i], "--script") == 0 && i + 1 < argc)
+            script_path = argv[++i];
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            max_frames = atol(argv[++i]);
+        else if (strcmp(argv[i], "--video") == 0 && i + 1 < argc)
+            video_path = argv[++i];
+        else if (strcmp(argv[i], "--until-hash") == 0 && i + 1 < argc) {
+            wait_hash = true;
+            target_hash = strtoull(argv[++i], NULL, 16);
+        } else if (strcmp(argv[i], "--mask") == 0 && i + 1 < argc) {
+            int c, r, w, h;
+            if (sscanf(argv[++i], "%d,%d,%d,%d", &c, &r, &w, &h) != 4) {
+                usage(argv[0]);
+                return 1;
+            }
+            zx_hash_mask_cells(&mask, c, r, w, h);
+        } else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            profile_path = argv[++i];
+        } else if (strcmp(argv[i], "--hotspots") == 0 && i + 1 < argc) {
+            hotspot_path = argv[++i];
+        } else if (strcmp(argv[i], "--symbols") == 0 && i + 1 < argc && nsymbols < 16) {
+            symbol_paths[nsymbols++] = argv[++i];
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (strcmp(argv[i], "--trace-last") == 0 && i + 1 < argc) {
+            trace_last = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--break") == 0 && i + 1 < argc) {
+            dbg_break_add(&debug, (uint16_t)strtoul(argv[++i], NULL, 16));
+            debugging = true;
+        } else if (strncmp(argv[i], "--watch-", 8) == 0 && i + 1 < argc) {
+            const char* k = argv[i] + 8;
+            uint8_t kind = strcmp(k, "read") == 0  ? DBG_WATCH_READ
+                         : strcmp(k, "write") == 0 ? DBG_WATCH_WRITE
+                         : strcmp(k, "in") == 0    ? DBG_WATCH_IN
+                         : strcmp(k, "out") == 0   ? DBG_WATCH_OUT : 0;
+            uint16_t a, b;
+            if (!kind || !parse_range(argv[++i], &a, &b) || dbg_watch_add(&debug, kind, a, b) < 0) {
+                usage(argv[0]);
+                return 1;
+            }
+            debugging = true;
+        } else if (strcmp(argv[i], "--continue") == 0) {
+            keep_going = true;
+        } else if (strcmp(argv[i], "--gdb") == 0 && i + 1 < argc) {
+            gdb_where = argv[++i];
+            debugging = true;
+        } else if (strcmp(argv[i], "--blocks") == 0) {
+            use_blocks = true;
+        } else if (strcmp(argv[i], "--wav") == 0 && i + 1 < argc) {
+            wav_path = argv[++i];
+        } else if (strcmp(argv[i], "--icache") == 0) {
+            use_icache = true;
+        } else if (strcmp(argv[i], "--core") == 0 && i + 1 < argc &&
+                   (strcmp(argv[i + 1], "exact") == 0 || strcmp(argv[i + 1], "fast") == 0)) {
+            fast_core = strcmp(argv[++i], "fast") == 0;
+        }
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (replay && script_path) {
+        fprintf(stderr, "--replay and --script both drive the keyboard: pick one\n");
+        return 1;
+    }
+    if (!replay && !script_path && !gdb_where && max_frames < 0)
+        max_frames = 500;   // 10 emulated seconds
+
+    static zx_spectrum zx;  // Static: ~160 KB is too big for some stacks
+    if (!rom)
+        rom = model == ZX_MODEL_128K ? "128.rom" : "48.rom";
+    if (!zx_init_model(&zx, model, rom))
+        return 1;
+    zx.kempston_attached = kempston;   // Must match the recording machine
+    if (fast_core)
+        z80_set_core(&zx.cpu, Z80_CORE_FAST);
+
+    // --- [ Input Script ] ---
+    // Its steps are scheduler events: the run loop below needs no help
+    static zx_script script;
+    if (script_path) {
+        if (!script_load(&script, script_path))
+            return 1;
+        script_attach(&script, &zx);
+    }
+
+    // --- [ Block Cache ] ---
+    // Only the plain run loop uses it: tracing, profiling and breakpoints
+    // keep stepping the interpreter.
+    if (use_blocks && !(zx.cpu.blocks = z80_blocks_new())) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    // --- [ Decode Cache ] ---
+    // Used by every z80_step; the ROM is never written, so its instructions
+    // stay decoded for the whole run.
+    if (use_icache) {
+        if (!(zx.cpu.icache = z80_icache_new())) {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+        z80_icache_set_rom(zx.cpu.icache, 0, ZX_ROM_SIZE);
+    }
+
+    movie_player movie;
+    if (replay && !movie_play_open(&movie, replay))
+        return 1;
+
+    video_recorder video = {0};
+    if (video_path && !video_open(&video, video_path))
+        return 1;
+
+    // --- [ Sound Capture ] ---
+    // Each frame's sound is rendered at its end and written straight out,
+    // so the ring never has to hold more than one frame.
+    static zx_sound sound;
+    FILE* wav = NULL;
+    if (wav_path) {
+        if (!(wav = fopen(wav_path, "wb"))) {
+            perror(wav_path);
+            return 1;
+        }
+        wav_header(wav, 0);             // Sizes are filled in at the end
+        sound_init(&sound, (uint32_t)zx.frame_tstates * ZX_FRAMES_PER_SECOND, WAV_RATE);
+        zx.sound = &sound;
+    }
+    uint32_t wav_samples = 0;
+
+    // --- [ Guest Hotspot Profiler ] ---
+    static hotspot_profile hotspots;
+    if (hotspot_path) {
+        if (!hotspot_init(&hotspots, model))
+            return 1;
+        for (int i = 0; i < nsymbols; i++)
+            if (!hotspot_load_symbols(&hotspots, symbol_paths[i]))
+                return 1;
+        zx.hotspots = &hotspots;
+    }
+
+    // --- [ Breakpoints and Watchpoints ] ---
+    // They were collected before the machine existed: attach, then restore.
+    if (debugging) {
+        zx_debugger wanted = debug;
+        dbg_attach(&debug, &zx);
+        memcpy(debug.pc_bits, wanted.pc_bits, sizeof(debug.pc_bits));
+        debug.nbreaks = wanted.nbreaks;
+        for (int i = 0; i < DBG_MAX_WATCHES; i++)
+            if (wanted.watches[i].used)
+                dbg_watch_add(&debug, wanted.watches[i].kind,
+                              wanted.watches[i].start, wanted.watches[i].end);
+    }
+
+    // --- [ GDB Remote Stub ] ---
+    static gdb_stub gdb;
+    if (gdb_where) {
+        if (!gdb_start(&gdb, &zx, &debug, gdb_where))
+            return 1;
+        printf("gdb:      listening on %s\n", gdb_where);
+        fflush(stdout);
+    }
+
+    // --- [ Execution Trace ] ---
+    // Streams every instruction through a 64K-record ring, or with
+    // --trace-last keeps only the most recent ones and writes them at the end.
+    static trace_ring trace;
+    if (trace_path) {
+        if (!trace_init(&trace, trace_last > 0 ? (uint32_t)trace_last : 65536))
+            return 1;
+        if (trace_last <= 0 && !trace_stream(&trace, trace_path))
+            return 1;
+        zx.trace = &trace;
+    }
+
+    // --- [ Opcode Profiler ] ---
+#ifdef Z80_PROFILE
+    static z80_profile profile;
+    if (profile_path) {
+        z80_profile_reset(&profile);
+        zx.cpu.profile = &profile;
+    }
+#else
+    if (profile_path) {
+        fprintf(stderr, "--profile: this build has no profiler (rebuild with PROFILE=1)\n");
+        return 1;
+    }
+#endif
+
+    // --- [ Main Loop: as fast as the host allows ] ---
+    double t0 = now_seconds();
+    bool hash_found = false, stopped = false;
+    while (max_frames < 0 || zx.frame < (uint32_t)max_frames) {
+        bool ran = replay ? movie_play_frame(&movie, &zx) : zx_run_frame(&zx);
+
+        // Debugger stop: report it, then either resume mid-frame or quit
+        if (debugging && debug.stop != DBG_STOP_NONE) {
+            if (gdb_where) {
+                gdb_wait(&gdb, -1);   // The client looks around, then resumes
+                continue;
+            }
+            char what[96];
+            printf("stop:     frame %u, t-state %lu: %s\n", zx.frame,
+                   zx_frame_tstate(&zx), dbg_stop_text(&debug, what, sizeof(what)));
+            printf("          PC=%04X SP=%04X AF=%02X%02X BC=%02X%02X DE=%02X%02X "
+                   "HL=%02X%02X IX=%04X IY=%04X\n", zx.cpu.pc, zx.cpu.sp,
+                   zx.cpu.a, z80_get_f(&zx.cpu), zx.cpu.b, zx.cpu.c, zx.cpu.d,
+                   zx.cpu.e, zx.cpu.h, zx.cpu.l, zx.cpu.ix, zx.cpu.iy);
+            z80_dis next;
+            uint8_t code[4];
+            for (int k = 0; k < 4; k++)
+                code[k] = zx_peek(&zx, (uint16_t)(zx.cpu.pc + k));
+            z80_disasm(&next, code, 4, zx.cpu.pc);
+            printf("          next: %04X  %s\n", zx.cpu.pc, next.text);
+            if (!keep_going) {
+                stopped = true;
+                break;
+            }
+            dbg_resume(&debug);
+            continue;
+        }
+        if (!ran)
+            break;
+        video_push_frame(&video, &zx);
+        if (wav) {
+            int16_t pcm[1024];
+            unsigned n;
+            while ((n = sound_read(&sound, pcm, 1024)) > 0)
+                wav_samples += (uint32_t)fwrite(pcm, sizeof(pcm[0]), n, wav);
+        }
+
+        if (wait_hash && zx_screen_hash(&zx, &mask) == target_hash) {
+            hash_found = true;
+            break;
+        }
+        if (script_path && max_frames < 0 && (script.done || script.failed))
+            break;
+    }
+    double elapsed = now_seconds() - t0;
+    video_close(&video);
+    if (wav) {
+        fseek(wav, 0, SEEK_SET);
+        wav_header(wav, wav_samples);
+        fclose(wav);
+    }
+    if (gdb_where)
+        gdb_stop(&gdb);
+
+    // --- [ Report ] ---
+    double emulated = (double)zx.frame / ZX_FRAMES_PER_SECOND;
+    printf("frames:   %u\n", zx.frame);
+    printf("checksum: %08X\n", zx_state_checksum(&zx));
+    printf("screen:   %016llX\n", (unsigned long long)zx_screen_hash(&zx, &mask));
+    printf("time:     %.3f s (%.1fx real time, %.2f MHz)\n", elapsed,
+           elapsed > 0 ? emulated / elapsed : 0.0,
+           elapsed > 0 ? zx.cpu.cyc / elapsed / 1e6 : 0.0);
+    if (zx.cpu.blocks) {
+        const z80_block_stats* bs = z80_blocks_stats(zx.cpu.blocks);
+        uint64_t total = bs->insns + bs->steps;
+        printf("blocks:   %.1f%% of %llu instructions in %llu block runs "
+               "(%llu decoded, %llu page invalidations, %llu flushes)\n",
+               total ? 100.0 * bs->insns / total : 0.0, (unsigned long long)total,
+               (unsigned long long)bs->runs, (unsigned long long)bs->translated,
+               (unsigned long long)bs->invalidated, (unsigned long long)bs->flushes);
+        z80_blocks_free(zx.cpu.blocks);
+    }
+    if (zx.cpu.icache) {
+        const z80_decode_stats* ds = z80_icache_stats(zx.cpu.icache);
+        printf("icache:   %llu instructions from %llu decoded "
+               "(%llu writes retired entries, %llu flushes)\n",
+               (unsigned long long)ds->runs, (unsigned long long)ds->decoded,
+               (unsigned long long)ds->retired, (unsigned long long)ds->flushes);
+        z80_icache_free(zx.cpu.icache);
+    }
+
+    if (trace_path) {
+        if (trace_last > 0)
+            trace_save(&trace, trace_path);
+        trace_close(&trace);
+    }
+
+    if (hotspot_path) {
+        FILE* hf = fopen(hotspot_path, "w");
+        if (!hf) {
+            perror(hotspot_path);
+        } else {
+            hotspot_write_folded(&hotspots, hf);
+            fclose(hf);
+        }
+        printf("\n");
+        hotspot_write_report(&hotspots, stdout, 20);
+        hotspot_free(&hotspots);
+    }
+
+#ifdef Z80_PROFILE
+    if (profile_path) {
+        FILE* pf = strcmp(profile_path, "-") == 0 ? stdout : fopen(profile_path, "w");
+        if (!pf) {
+            perror(profile_path);
+        } else {
+            z80_profile_dump(&profile, pf, 40);
+            if (pf != stdout)
+                fclose(pf);
+        }
+    }
+#endif
+
+    int status = stopped ? 4 : 0;
+    if (wait_hash && !hash_found) {
+        fprintf(stderr, "screen hash %016llX not reached\n",
+                (unsigned long long)target_hash);
+        status = 3;
+    }
+    if (script_path) {
+        if (script.failed) {
+            fprintf(stderr, "script: %s\n", script.error);
+            status = 5;
+        } else if (!script.done) {
+            fprintf(stderr, "script: stopped at line %d\n", script.ops[script.next].line);
+        }
+        script_free(&script);
+    }
+    if (replay) {
+        if (movie.diverged) {
+            fprintf(stderr, "replay diverged at frame %u (checksum mismatch)\n",
+                    movie.diverged_frame);
+            status = 2;
+        }
+        movie_play_close(&movie);
+    }
+    return status;
+}
@@ -0,0 +1,305 @@
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "hotspot.h"
+
+// --- [ 48K ROM Labels ] ---
+// Entry points of the main ROM routines, named as in "The Complete Spectrum
+// ROM Disassembly" (Logan & O'Hara).
+static const struct { uint16_t addr; const char* name; } rom_labels[] = {
+    {0x0000, "START"},      {0x0008, "ERROR-1"},    {0x0010, "PRINT-A-1"},
+    {0x0018, "GET-CHAR"},   {0x0020, "NEXT-CHAR"},  {0x0028, "FP-CALC"},
+    {0x0030, "BC-SPACES"},  {0x0038, "MASK-INT"},   {0x0053, "ERROR-2"},
+    {0x0066, "RESET"},      {0x0074, "CH-ADD+1"},   {0x007D, "SKIP-OVER"},
+    {0x028E, "KEY-SCAN"},   {0x02BF, "KEYBOARD"},   {0x031E, "K-TEST"},
+    {0x0333, "K-DECODE"},   {0x03B5, "BEEPER"},     {0x03F8, "BEEP"},
+    {0x04C2, "SA-BYTES"},   {0x0556, "LD-BYTES"},   {0x05E3, "LD-EDGE-2"},
+    {0x05E7, "LD-EDGE-1"},  {0x0605, "SAVE-ETC"},   {0x09F4, "PRINT-OUT"},
+    {0x0B24, "PO-ANY"},     {0x0B65, "PO-CHAR"},    {0x0C0A, "PO-MSG"},
+    {0x0D6B, "CLS"},        {0x0DAF, "CL-ALL"},     {0x0DFE, "CL-SC-ALL"},
+    {0x0E44, "CL-LINE"},    {0x0E9B, "CL-ADDR"},    {0x0EAC, "COPY"},
+    {0x0F2C, "EDITOR"},     {0x10A8, "KEY-INPUT"},  {0x11B7, "NEW"},
+    {0x11CB, "START/NEW"},  {0x12A2, "MAIN-EXEC"},  {0x12A9, "MAIN-1"},
+    {0x15D4, "WAIT-KEY"},   {0x15E6, "INPUT-AD"},   {0x15F2, "PRINT-A-2"},
+    {0x15F7, "CALL-SUB"},   {0x1601, "CHAN-OPEN"},  {0x162C, "CALL-JUMP"},
+    {0x1655, "MAKE-ROOM"},
+    {0x1795, "AUTO-LIST"},  {0x196E, "LINE-ADDR"},  {0x19B8, "NEXT-ONE"},
+    {0x1B17, "LINE-SCAN"},  {0x1B8A, "LINE-RUN"},   {0x1F54, "BREAK-KEY"},
+    {0x22AA, "PIXEL-ADD"},  {0x22DC, "PLOT"},       {0x2382, "DRAW"},
+    {0x24FB, "SCANNING"},   {0x2BF1, "STK-FETCH"},  {0x2D28, "STACK-A"},
+    {0x2D2B, "STACK-BC"},   {0x2D3B, "INT-TO-FP"},  {0x2D4F, "E-TO-FP"},
+    {0x2DA2, "FP-TO-BC"},   {0x2DE3, "PRINT-FP"},   {0x3014, "ADDITION"},
+    {0x30CA, "MULTIPLY"},   {0x31AF, "DIVISION"},   {0x335B, "CALCULATE"},
+    {0x33B4, "STACK-NUM"},  {0x3449, "SERIES-XX"},  {0x36C4, "EXP"},
+    {0x3713, "LN"},         {0x37AA, "COS"},        {0x37B5, "SIN"},
+    {0x37DA, "TAN"},        {0x37E2, "ATN"},        {0x3833, "ASN"},
+    {0x3843, "ACS"},        {0x384A, "SQR"},        {0x3851, "TO-POWER"},
+};
+
+// --- [ Symbol Table ] ---
+static bool add_symbol(hotspot_profile* hp, uint16_t addr, const char* name) {
+    hotspot_symbol* symbols = realloc(hp->symbols, (hp->nsymbols + 1) * sizeof(hotspot_symbol));
+    if (!symbols)
+        return false;
+    hp->symbols = symbols;
+    hotspot_symbol* s = &hp->symbols[hp->nsymbols++];
+    s->addr = addr;
+    snprintf(s->name, sizeof(s->name), "%s", name);
+    return true;
+}
+
+static int cmp_symbol(const void* a, const void* b) {
+    const hotspot_symbol* x = a;
+    const hotspot_symbol* y = b;
+    return (int)x->addr - (int)y->addr;
+}
+
+// Nearest symbol at or below "addr", or NULL
+static const hotspot_symbol* find_symbol(const hotspot_profile* hp, uint16_t addr) {
+    int lo = 0, hi = hp->nsymbols - 1, best = -1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (hp->symbols[mid].addr <= addr) {
+            best = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return best < 0 ? NULL : &hp->symbols[best];
+}
+
+// "NAME", "NAME+12" (within 256 bytes of a label) or "$8000"
+static void addr_name(const hotspot_profile* hp, uint16_t addr, char* out, size_t size) {
+    const hotspot_symbol* s = find_symbol(hp, addr);
+    if (s && s->addr == addr)
+        snprintf(out, size, "%s", s->name);
+    else if (s && addr - s->addr < 0x100)
+        snprintf(out, size, "%s+%d", s->name, addr - s->addr);
+    else
+        snprintf(out, size, "$%04X", addr);
+}
+
+bool hotspot_load_symbols(hotspot_profile* hp, const char* path) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "#;\r\n")] = '\0';   // Strip comments
+        char* p = line;
+        while (isspace((unsigned char)*p)) p++;
+        if (*p == '$') p++;
+
+        char* end;
+        unsigned long addr = strtoul(p, &end, 16);
+        if (end == p || addr > 0xFFFF)
+            continue;                           // Blank or not an address
+        if (*end == 'h' || *end == 'H') end++;
+
+        char name[32];
+        if (sscanf(end, "%31s", name) == 1 && !add_symbol(hp, (uint16_t)addr, name)) {
+            fprintf(stderr, "%s: out of memory\n", path);
+            fclose(f);
+            return false;
+        }
+    }
+    fclose(f);
+    qsort(hp->symbols, hp->nsymbols, sizeof(hotspot_symbol), cmp_symbol);
+    return true;
+}
+
+// --- [ Setup ] ---
+bool hotspot_init(hotspot_profile* hp, zx_model model) {
+    memset(hp, 0, sizeof(*hp));
+    hp->nodes = malloc(HOTSPOT_MAX_NODES * sizeof(hotspot_node));
+    if (!hp->nodes)
+        return false;
+    hp->nodes[0] = (hotspot_node){0, -1, -1, -1, 0};   // Root: code running at start
+    hp->nnodes = 1;
+
+    // A 128K starts in its editor ROM, where these names would all be wrong
+    if (model == ZX_MODEL_48K)
+        for (size_t i = 0; i < sizeof(rom_labels) / sizeof(rom_labels[0]); i++)
+            if (!add_symbol(hp, rom_labels[i].addr, rom_labels[i].name)) {
+                hotspot_free(hp);
+                return false;
+            }
+    qsort(hp->symbols, hp->nsymbols, sizeof(hotspot_symbol), cmp_symbol);
+    return true;
+}
+
+void hotspot_free(hotspot_profile* hp) {
+    free(hp->nodes);
+    free(hp->symbols);
+    hp->nodes = NULL;
+    hp->symbols = NULL;
+}
+
+// --- [ Call Tree ] ---
+static int32_t current_node(const hotspot_profile* hp) {
+    return hp->depth ? hp->stack[hp->depth - 1].node : 0;
+}
+
+static void push_frame(hotspot_profile* hp, uint16_t func, uint16_t sp) {
+    if (hp->depth == HOTSPOT_MAX_DEPTH)
+        return;
+    int32_t parent = current_node(hp);
+
+    // Find the child for "func", or add it
+    int32_t n = hp->nodes[parent].child;
+    while (n >= 0 && hp->nodes[n].func != func)
+        n = hp->nodes[n].sibling;
+    if (n < 0) {
+        if (hp->nnodes == HOTSPOT_MAX_NODES)
+            n = parent;                     // Tree full: stay in the caller
+        else {
+            n = hp->nnodes++;
+            hp->nodes[n] = (hotspot_node){func, parent, -1, hp->nodes[parent].child, 0};
+            hp->nodes[parent].child = n;
+        }
+    }
+    hp->stack[hp->depth].node = n;
+    hp->stack[hp->depth].sp = sp;
+    hp->depth++;
+}
+
+// Ends every frame whose return address slot is now above SP
+static void unwind(hotspot_profile* hp, uint16_t sp) {
+    while (hp->depth > 0 && sp > hp->stack[hp->depth - 1].sp)
+        hp->depth--;
+}
+
+// --- [ Instrumented Step ] ---
+void hotspot_step(hotspot_profile* hp, zx_spectrum* zx) {
+    z80* cpu = &zx->cpu;
+    uint16_t pc = cpu->pc;
+    uint16_t sp = cpu->sp;
+    uint8_t op = cpu->halted ? 0x00 : zx_peek(zx, pc);
+    bool int_pending = cpu->int_pending, nmi_pending = cpu->nmi_pending;
+    unsigned long cyc = cpu->cyc;
+
+    z80_step(cpu);
+
+    // Charge the T-states to the instruction and to the running routine
+    uint32_t t = (uint32_t)(cpu->cyc - cyc);
+    uint32_t c = hp->pc_cycles[pc];
+    hp->pc_cycles[pc] = c + t < c ? UINT32_MAX : c + t;
+    hp->nodes[current_node(hp)].cycles += t;
+
+    // Was an interrupt accepted at the end of this step? It pushed PC,
+    // except in IM 0 when the data byte is not an RST.
+    bool irq = (nmi_pending && !cpu->nmi_pending) ||
+               (int_pending && !cpu->int_pending &&
+                (cpu->interrupt_mode != 0 || (cpu->int_data & 0xC7) == 0xC7));
+    uint16_t sp_insn = irq ? (uint16_t)(cpu->sp + 2) : cpu->sp;  // SP after the instruction
+
+    unwind(hp, sp_insn);
+
+    // CALL nn, CALL cc,nn (taken if it pushed) and RST n
+    bool is_call = op == 0xCD || (op & 0xC7) == 0xC4;
+    if (is_call && sp_insn == (uint16_t)(sp - 2))
+        push_frame(hp, (uint16_t)(zx_peek(zx, pc + 1) | zx_peek(zx, pc + 2) << 8), sp_insn);
+    else if ((op & 0xC7) == 0xC7)
+        push_frame(hp, op & 0x38, sp_insn);
+
+    if (irq)
+        push_frame(hp, cpu->pc, cpu->sp);
+}
+
+// --- [ Folded Stacks ] ---
+void hotspot_write_folded(const hotspot_profile* hp, FILE* f) {
+    int32_t path[HOTSPOT_MAX_DEPTH + 1];
+    for (int32_t n = 0; n < hp->nnodes; n++) {
+        if (!hp->nodes[n].cycles)
+            continue;
+        int len = 0;
+        for (int32_t k = n; k >= 0 && len <= HOTSPOT_MAX_DEPTH; k = hp->nodes[k].parent)
+            path[len++] = k;
+
+        for (int i = len - 1; i >= 0; i--) {
+            char name[48];
+            if (path[i] == 0)
+                snprintf(name, sizeof(name), "(start)");
+            else
+                addr_name(hp, hp->nodes[path[i]].func, name, sizeof(name));
+            fprintf(f, "%s%s", name, i ? ";" : "");
+        }
+        fprintf(f, " %llu\n", (unsigned long long)hp->nodes[n].cycles);
+    }
+}
+
+// --- [ Summary Report ] ---
+typedef struct hotspot_entry {
+    uint32_t key;            // Symbol index, or 0x10000 + page for unnamed code
+    uint64_t cycles;
+} hotspot_entry;
+
+static int cmp_entry(const void* a, const void* b) {
+    const hotspot_entry* x = a;
+    const hotspot_entry* y = b;
+    return x->cycles < y->cycles ? 1 : x->cycles > y->cycles ? -1 : 0;
+}
+
+void hotspot_write_report(const hotspot_profile* hp, FILE* f, int top) {
+    uint64_t total = 0;
+    for (int a = 0; a < 65536; a++)
+        total += hp->pc_cycles[a];
+    if (!total) {
+        fprintf(f, "hotspots: nothing recorded\n");
+        return;
+    }
+
+    // Routines: code is charged to the nearest label below it (if within
+    // 1 KB), anything else to its 256-byte page
+    int nkeys = hp->nsymbols + 256;
+    hotspot_entry* e = calloc(nkeys, sizeof(hotspot_entry));
+    hotspot_entry* pcs = malloc(65536 * sizeof(hotspot_entry));
+    if (!e || !pcs) {
+        fprintf(f, "hotspots: out of memory\n");
+        free(e);
+        free(pcs);
+        return;
+    }
+    for (int k = 0; k < nkeys; k++)
+        e[k].key = (uint32_t)(k < hp->nsymbols ? k : 0x10000 + (k - hp->nsymbols));
+    for (int a = 0; a < 65536; a++) {
+        if (!hp->pc_cycles[a])
+            continue;
+        const hotspot_symbol* s = find_symbol(hp, (uint16_t)a);
+        int k = s && a - s->addr < 0x400 ? (int)(s - hp->symbols) : hp->nsymbols + (a >> 8);
+        e[k].cycles += hp->pc_cycles[a];
+    }
+    qsort(e, nkeys, sizeof(hotspot_entry), cmp_entry);
+
+    fprintf(f, "%-20s %14s %7s\n", "routine", "t-states", "%");
+    for (int i = 0; i < top && i < nkeys && e[i].cycles; i++) {
+        char name[40];
+        if (e[i].key < 0x10000)
+            snprintf(name, sizeof(name), "%s", hp->symbols[e[i].key].name);
+        else
+            snprintf(name, sizeof(name), "$%02Xxx", e[i].key - 0x10000);
+        fprintf(f, "%-20s %14llu %6.2f%%\n", name, (unsigned long long)e[i].cycles,
+                100.0 * e[i].cycles / total);
+    }
+    free(e);
+
+    // Single addresses
+    for (int a = 0; a < 65536; a++) {
+        pcs[a].key = (uint32_t)a;
+        pcs[a].cycles = hp->pc_cycles[a];
+    }
+    qsort(pcs, 65536, sizeof(hotspot_entry), cmp_entry);
+
+    fprintf(f, "\n%-20s %6s %14s %7s\n", "address", "", "t-states", "%");
+    for (int i = 0; i < top && pcs[i].cycles; i++) {
+        char name[48];
+        addr_name(hp, (uint16_t)pcs[i].key, name, sizeof(name));
+        fprintf(f, "%-20s $%04X %14llu %6.2f%%\n", name, pcs[i].key,
+                (unsigned long long)pcs[i].cycles, 100.0 * pcs[i].cycles / total);
+    }
+    free(pcs);
+}
@@ -0,0 +1,84 @@
+#ifndef ZX_HOTSPOT_H_
+#define ZX_HOTSPOT_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "spectrum.h"
+
+// --- [ Guest Hotspot Profiler ] ---
+// Shows which Spectrum routines use up the emulated CPU (not the host CPU:
+// for that see Z80_PROFILE in z80.h).
+//
+// While a profile is attached to a machine (zx->hotspots), zx_run_until
+// switches to an instrumented loop that, for every instruction:
+//
+//   - adds its T-states to a 64K-entry table indexed by its address, and
+//   - adds them to the current node of a call tree. The call stack is rebuilt
+//     from CALL, RST and accepted interrupts (push a frame) and from the
+//     stack pointer: a frame ends as soon as SP moves above the slot where
+//     its return address was pushed. That covers RET, RETI/RETN, and the
+//     ROM's tricks of dropping return addresses or resetting SP on errors.
+//
+// Nothing is measured when no profile is attached; the normal run loop does
+// not change.
+//
+// Addresses are named from the built-in 48K ROM labels (48K model only: the
+// 128K pages its ROMs) plus symbol files ("ADDR NAME" per line). Reports:
+//
+//   hotspot_write_folded  flamegraph-compatible folded stacks
+//                         ("MAIN-4;PRINT-OUT;PO-CHAR 12345", in T-states)
+//   hotspot_write_report  top routines and top addresses
+
+#define HOTSPOT_MAX_DEPTH  256      // Deeper calls are charged to the deepest frame
+#define HOTSPOT_MAX_NODES  65536    // Distinct call paths kept
+
+typedef struct hotspot_node {
+    uint16_t func;           // Entry address of the routine
+    int32_t  parent;         // -1 for the root
+    int32_t  child;          // First child, -1 if none
+    int32_t  sibling;        // Next child of the same parent, -1 if none
+    uint64_t cycles;         // T-states spent in this routine itself
+} hotspot_node;
+
+typedef struct hotspot_symbol {
+    uint16_t addr;
+    char     name[32];
+} hotspot_symbol;
+
+typedef struct hotspot_profile {
+    uint32_t pc_cycles[65536];   // T-states per instruction address (saturating)
+
+    hotspot_node* nodes;         // Call tree, node 0 = the root
+    int32_t nnodes;
+
+    struct {                     // Shadow call stack
+        int32_t  node;
+        uint16_t sp;             // Where the return address was pushed
+    } stack[HOTSPOT_MAX_DEPTH];
+    int depth;                   // Frames on the stack (the root is not one)
+
+    hotspot_symbol* symbols;     // Sorted by address
+    int nsymbols;
+} hotspot_profile;
+
+// Allocates an empty profile, with the ROM labels loaded for a 48K.
+bool hotspot_init(hotspot_profile* hp, zx_model model);
+void hotspot_free(hotspot_profile* hp);
+
+// Adds labels from a text file: "ADDR NAME" per line, ADDR in hex
+// (optionally written as $8000, 0x8000 or 8000h). '#' or ';' start comments.
+bool hotspot_load_symbols(hotspot_profile* hp, const char* path);
+
+// Runs one instruction of the machine and charges its T-states.
+// (zx_run_until calls this when zx->hotspots is set.)
+void hotspot_step(hotspot_profile* hp, zx_spectrum* zx);
+
+// Folded stacks, one line per call path: "A;B;C <T-states>"
+void hotspot_write_folded(const hotspot_profile* hp, FILE* f);
+
+// Human-readable summary: the "top" routines and addresses by T-states.
+void hotspot_write_report(const hotspot_profile* hp, FILE* f, int top);
+
+#endif // ZX_HOTSPOT_H_
@@ -0,0 +1,282 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "keymap.h"
+
+// --- [ Key Codes ] ---
+// Spectrum keys are row << 3 | bit (0-63); joystick directions follow
+#define KEY(row, bit)  ((row) << 3 | (bit))
+#define KEY_JOY        64
+#define KEY_NONE       0xFF
+
+enum { JOY_UP, JOY_DOWN, JOY_LEFT, JOY_RIGHT, JOY_FIRE, JOY_DIRECTIONS };
+
+static const char* const key_names[8][5] = {
+    {"CAPS",  "Z",      "X", "C", "V"},
+    {"A",     "S",      "D", "F", "G"},
+    {"Q",     "W",      "E", "R", "T"},
+    {"1",     "2",      "3", "4", "5"},
+    {"0",     "9",      "8", "7", "6"},
+    {"P",     "O",      "I", "U", "Y"},
+    {"ENTER", "L",      "K", "J", "H"},
+    {"SPACE", "SYMBOL", "M", "N", "B"},
+};
+
+static const char* const joy_names[JOY_DIRECTIONS] = {
+    "JOY_UP", "JOY_DOWN", "JOY_LEFT", "JOY_RIGHT", "JOY_FIRE"
+};
+
+// Keys pressed by each direction of the keyboard-based joysticks
+#define CAPS  KEY(0, 0)
+#define N1    KEY(3, 0)
+#define N2    KEY(3, 1)
+#define N3    KEY(3, 2)
+#define N4    KEY(3, 3)
+#define N5    KEY(3, 4)
+#define N0    KEY(4, 0)
+#define N9    KEY(4, 1)
+#define N8    KEY(4, 2)
+#define N7    KEY(4, 3)
+#define N6    KEY(4, 4)
+
+static const uint8_t joy_keys[KEYMAP_JOY_TYPES][JOY_DIRECTIONS][2] = {
+    //          up                down              left              right             fire
+    [KEYMAP_JOY_NONE]      = {{CAPS, N7},       {CAPS, N6},       {CAPS, N5},       {CAPS, N8},       {KEY_NONE, KEY_NONE}},
+    [KEYMAP_JOY_SINCLAIR1] = {{N9, KEY_NONE},   {N8, KEY_NONE},   {N6, KEY_NONE},   {N7, KEY_NONE},   {N0, KEY_NONE}},
+    [KEYMAP_JOY_SINCLAIR2] = {{N4, KEY_NONE},   {N3, KEY_NONE},   {N1, KEY_NONE},   {N2, KEY_NONE},   {N5, KEY_NONE}},
+    [KEYMAP_JOY_CURSOR]    = {{N7, KEY_NONE},   {N6, KEY_NONE},   {N5, KEY_NONE},   {N8, KEY_NONE},   {N0, KEY_NONE}},
+};
+
+static const uint8_t kempston_bits[JOY_DIRECTIONS] = {
+    ZX_KEMPSTON_UP, ZX_KEMPSTON_DOWN, ZX_KEMPSTON_LEFT, ZX_KEMPSTON_RIGHT, ZX_KEMPSTON_FIRE
+};
+
+// --- [ Built-in Layout ] ---
+// Letters and digits map to themselves (added in code); the rest follows
+// the PC keyboard: punctuation through SYMBOL SHIFT, arrows as joystick.
+static const char builtin_layout[] =
+    "Return      = ENTER\n"
+    "Space       = SPACE\n"
+    "Left Shift  = CAPS\n"
+    "Right Shift = SYMBOL\n"
+    "Left Ctrl   = SYMBOL\n"
+    "Right Ctrl  = SYMBOL\n"
+    "Backspace   = CAPS+0\n"       // DELETE
+    "Escape      = CAPS+SPACE\n"   // BREAK
+    "Up          = JOY_UP\n"
+    "Down        = JOY_DOWN\n"
+    "Left        = JOY_LEFT\n"
+    "Right       = JOY_RIGHT\n"
+    "Tab         = JOY_FIRE\n"
+    ",           = SYMBOL+N\n"
+    ".           = SYMBOL+M\n"
+    "/           = SYMBOL+V\n"
+    ";           = SYMBOL+O\n"
+    "'           = SYMBOL+7\n"
+    "-           = SYMBOL+J\n"
+    "=           = SYMBOL+L\n";
+
+// --- [ Parsing ] ---
+static bool same_name(const char* a, const char* b) {
+    while (*a && toupper((unsigned char)*a) == toupper((unsigned char)*b))
+        a++, b++;
+    return *a == *b;
+}
+
+static char* trim(char* s) {
+    while (isspace((unsigned char)*s))
+        s++;
+    char* end = s + strlen(s);
+    while (end > s && isspace((unsigned char)end[-1]))
+        *--end = '\0';
+    return s;
+}
+
+static uint8_t parse_key(const char* name) {
+    for (int row = 0; row < 8; row++)
+        for (int bit = 0; bit < 5; bit++)
+            if (same_name(name, key_names[row][bit]))
+                return KEY(row, bit);
+    for (int dir = 0; dir < JOY_DIRECTIONS; dir++)
+        if (same_name(name, joy_names[dir]))
+            return KEY_JOY + dir;
+    return KEY_NONE;
+}
+
+int keymap_spectrum_key(const char* name) {
+    uint8_t key = parse_key(name);
+    return key < KEY_JOY ? key : -1;
+}
+
+// "HOST = KEY[+KEY]". The host name may itself be "=", so the line is split
+// at its last "=".
+static bool parse_line(keymap* km, char* line, keymap_lookup_fn lookup,
+                       const char* source, int lineno) {
+    char* eq = strrchr(line, '=');
+    if (!eq || eq == line) {
+        fprintf(stderr, "%s:%d: expected \"HOST KEY = SPECTRUM KEY\"\n", source, lineno);
+        return false;
+    }
+    *eq = '\0';
+    char* host_name = trim(line);
+    char* value = trim(eq + 1);
+    int host = lookup(host_name);
+    if (host < 0 || host >= KEYMAP_HOST_KEYS) {
+        fprintf(stderr, "%s:%d: unknown host key \"%s\"\n", source, lineno, host_name);
+        return false;
+    }
+
+    keymap_entry entry = {0};
+    if (!same_name(value, "NONE")) {
+        for (char* part = strtok(value, "+"); part; part = strtok(NULL, "+")) {
+            uint8_t key = parse_key(trim(part));
+            if (key == KEY_NONE || entry.count == 2) {
+                fprintf(stderr, "%s:%d: bad Spectrum key \"%s\"\n", source, lineno, part);
+                return false;
+            }
+            entry.key[entry.count++] = key;
+        }
+    }
+    km->map[host] = entry;
+    return true;
+}
+
+// Applies the lines of "text" outside any section and those of "layout"
+// (NULL: the first section). Sets *found when that section exists.
+static bool parse_text(keymap* km, char* text, const char* layout, keymap_lookup_fn lookup,
+                       const char* source, bool* found) {
+    bool active = true;                // Lines before the first section
+    bool seen_section = false;
+    int lineno = 0;
+    for (char* line = text; line; ) {
+        char* next = strchr(line, '\n');
+        if (next)
+            *next++ = '\0';
+        lineno++;
+        char* s = trim(line);
+        line = next;
+
+        if (*s == '\0' || *s == '#')
+            continue;
+        if (*s == '[') {
+            char* close = strchr(s, ']');
+            if (!close) {
+                fprintf(stderr, "%s:%d: unterminated [layout]\n", source, lineno);
+                return false;
+            }
+            *close = '\0';
+            const char* name = trim(s + 1);
+            active = layout ? strcmp(name, layout) == 0 : !seen_section;
+            seen_section = true;
+            if (active)
+                *found = true;
+            continue;
+        }
+        if (active && !parse_line(km, s, lookup, source, lineno))
+            return false;
+    }
+    return true;
+}
+
+bool keymap_load(keymap* km, const char* path, const char* layout, keymap_lookup_fn lookup) {
+    memset(km, 0, sizeof(*km));
+
+    // Letters and digits are the same key on both keyboards
+    for (int row = 0; row < 8; row++)
+        for (int bit = 0; bit < 5; bit++) {
+            const char* name = key_names[row][bit];
+            int host = name[1] == '\0' ? lookup(name) : -1;
+            if (host >= 0 && host < KEYMAP_HOST_KEYS)
+                km->map[host] = (keymap_entry){1, {KEY(row, bit), 0}};
+        }
+    char builtin[sizeof(builtin_layout)];
+    memcpy(builtin, builtin_layout, sizeof(builtin));
+    bool found = false;
+    if (!parse_text(km, builtin, NULL, lookup, "built-in layout", &found))
+        return false;
+    if (!path)
+        return true;
+
+    // --- [ Layout File ] ---
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char* text = size >= 0 ? malloc((size_t)size + 1) : NULL;
+    bool ok = text && fread(text, 1, (size_t)size, f) == (size_t)size;
+    fclose(f);
+    if (!ok) {
+        fprintf(stderr, "%s: cannot read\n", path);
+        free(text);
+        return false;
+    }
+    text[size] = '\0';
+
+    found = false;
+    ok = parse_text(km, text, layout, lookup, path, &found);
+    free(text);
+    if (ok && layout && !found) {
+        fprintf(stderr, "%s: no layout [%s]\n", path, layout);
+        return false;
+    }
+    return ok;
+}
+
+// --- [ Joysticks ] ---
+bool keymap_parse_joystick(const char* name, keymap_joystick* joy) {
+    static const char* const names[KEYMAP_JOY_TYPES] = {
+        "none", "kempston", "sinclair1", "sinclair2", "cursor"
+    };
+    for (int i = 0; i < KEYMAP_JOY_TYPES; i++)
+        if (same_name(name, names[i])) {
+            *joy = (keymap_joystick)i;
+            return true;
+        }
+    return false;
+}
+
+void keymap_set_joystick(keymap* km, zx_spectrum* zx, keymap_joystick joy) {
+    km->joystick = joy;
+    zx->kempston_attached = joy == KEYMAP_JOY_KEMPSTON;
+    zx->kempston = 0;
+}
+
+// --- [ Key Events ] ---
+// A Spectrum key stays down while any host key holding it is down, so
+// e.g. releasing "," (SYMBOL+N) does not release a SYMBOL SHIFT still held.
+static void press(keymap* km, zx_spectrum* zx, uint8_t key, bool pressed) {
+    if (key == KEY_NONE)
+        return;
+    if (pressed) {
+        if (km->held[key]++ > 0)
+            return;                    // Already down
+    } else {
+        if (km->held[key] == 0 || --km->held[key] > 0)
+            return;                    // Still held by another host key
+    }
+
+    if (key < KEY_JOY) {
+        zx_set_key(zx, key >> 3, key & 7, pressed);
+    } else if (km->joystick == KEYMAP_JOY_KEMPSTON) {
+        uint8_t bit = kempston_bits[key - KEY_JOY];
+        zx->kempston = pressed ? zx->kempston | bit : zx->kempston & ~bit;
+    } else {
+        const uint8_t* keys = joy_keys[km->joystick][key - KEY_JOY];
+        press(km, zx, keys[0], pressed);
+        press(km, zx, keys[1], pressed);
+    }
+}
+
+void keymap_key(keymap* km, zx_spectrum* zx, int host_key, bool pressed) {
+    if (host_key < 0 || host_key >= KEYMAP_HOST_KEYS)
+        return;
+    const keymap_entry* e = &km->map[host_key];
+    for (int i = 0; i < e->count; i++)
+        press(km, zx, e->key[i], pressed);
+}
@@ -0,0 +1,77 @@
+#ifndef ZX_KEYMAP_H_
+#define ZX_KEYMAP_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "spectrum.h"
+
+// --- [ Keyboard Layouts and Joysticks ] ---
+// Host keys are looked up in a table: each one presses up to two Spectrum
+// keys (so PC punctuation can be SYMBOL SHIFT + a key) or a joystick
+// direction. Nothing here depends on SDL: host keys are plain numbers (the
+// front end uses SDL scancodes) and names are resolved by a callback.
+//
+// Layout files are text, one mapping per line, "#" starting a comment line:
+//
+//   Left Shift = CAPS
+//   ,          = SYMBOL+N
+//   Up         = JOY_UP
+//   F1         = NONE          (removes a mapping)
+//   [game]                     (the lines below form the layout "game")
+//
+// Host names are whatever the callback understands (SDL key names); the
+// right-hand side is a Spectrum key (1-0, A-Z, ENTER, SPACE, CAPS, SYMBOL),
+// two of them joined by "+", a JOY_* direction, or NONE. Every layout starts
+// from the built-in one and only lists its differences; lines before the
+// first [section] apply to all layouts of the file.
+//
+// The joystick directions mean whatever joystick is emulated: the Kempston
+// interface (port 0x1F), the Sinclair Interface 2 ports (keys 6-0 and 1-5),
+// the Cursor/Protek joystick (5-8, 0), or with none, the Spectrum's own
+// cursor keys (CAPS SHIFT + 5-8).
+
+#define KEYMAP_HOST_KEYS 512           // Host key codes are below this
+
+typedef enum keymap_joystick {
+    KEYMAP_JOY_NONE,                   // Directions are the cursor keys
+    KEYMAP_JOY_KEMPSTON,
+    KEYMAP_JOY_SINCLAIR1,              // Interface 2, left port: 6-0
+    KEYMAP_JOY_SINCLAIR2,              // Interface 2, right port: 1-5
+    KEYMAP_JOY_CURSOR,                 // Cursor/Protek/AGF: 5-8, 0
+    KEYMAP_JOY_TYPES
+} keymap_joystick;
+
+typedef struct keymap_entry {
+    uint8_t count;                     // 0 = not mapped
+    uint8_t key[2];                    // Spectrum key (row << 3 | bit) or joystick direction
+} keymap_entry;
+
+typedef struct keymap {
+    keymap_entry map[KEYMAP_HOST_KEYS];
+    keymap_joystick joystick;
+    uint8_t held[72];                  // Host keys holding each key/direction down
+} keymap;
+
+// Host key code for a name, or -1 if unknown
+typedef int (*keymap_lookup_fn)(const char* name);
+
+// Builds the built-in layout, then applies "layout" from the file at "path"
+// (NULL: the first one in the file; no path: built-in only). Prints the
+// problem and returns false on a bad file or an unknown layout.
+bool keymap_load(keymap* km, const char* path, const char* layout, keymap_lookup_fn lookup);
+
+// Spectrum key (row << 3 | bit) for a name such as "J" or "SYMBOL", or -1
+int keymap_spectrum_key(const char* name);
+
+// Parses "kempston", "sinclair1", "sinclair2", "cursor" or "none".
+bool keymap_parse_joystick(const char* name, keymap_joystick* joy);
+
+// Selects the emulated joystick (before any key is pressed). A Kempston
+// interface is attached to the machine for it.
+void keymap_set_joystick(keymap* km, zx_spectrum* zx, keymap_joystick joy);
+
+// A host key went down or up. Key repeats must not be passed in.
+void keymap_key(keymap* km, zx_spectrum* zx, int host_key, bool pressed);
+
+#endif // ZX_KEYMAP_H_
@@ -0,0 +1,136 @@
+#include <string.h>
+#include <time.h>
+
+#include "metrics.h"
+
+static const char* series_names[METRIC_COUNT] = {
+    "emulate_us", "render_us", "present_us", "sleep_us", "frame_us", "audio_gap_us",
+    "audio_queue_samples",
+};
+
+double metrics_now(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// --- [ Histograms ] ---
+void metrics_hist_reset(metrics_hist* h) {
+    memset(h, 0, sizeof(*h));
+    h->min = UINT32_MAX;
+}
+
+// Largest value that falls into bucket "b"
+static uint32_t bucket_high(uint32_t b) {
+    if (b < METRICS_SUB_COUNT)
+        return b;
+    uint32_t shift = (b - METRICS_SUB_COUNT) / (METRICS_SUB_COUNT / 2) + 1;
+    uint64_t m = (b - METRICS_SUB_COUNT) % (METRICS_SUB_COUNT / 2) + METRICS_SUB_COUNT / 2;
+    uint64_t high = ((m + 1) << shift) - 1;
+    return high > UINT32_MAX ? UINT32_MAX : (uint32_t)high;
+}
+
+uint32_t metrics_hist_percentile(const metrics_hist* h, double p) {
+    if (h->total == 0)
+        return 0;
+    uint64_t rank = (uint64_t)(p / 100.0 * h->total + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > h->total) rank = h->total;
+
+    uint64_t seen = 0;
+    for (uint32_t b = 0; b < METRICS_BUCKETS; b++) {
+        seen += h->counts[b];
+        if (seen >= rank) {
+            uint32_t v = bucket_high(b);
+            return v > h->max ? h->max : v;
+        }
+    }
+    return h->max;
+}
+
+// --- [ Intervals ] ---
+static void start_interval(frame_metrics* m, uint32_t frame, uint64_t cyc) {
+    for (int i = 0; i < METRIC_COUNT; i++)
+        metrics_hist_reset(&m->hist[i]);
+    m->over_budget = 0;
+    m->audio_late = 0;
+    m->frames = 0;
+    m->first_frame = frame;
+    m->start_cyc = cyc;
+    m->start_time = metrics_now();
+}
+
+bool metrics_open(frame_metrics* m, const char* path, uint32_t every_frames,
+                  uint32_t budget_us, const char* label) {
+    memset(m, 0, sizeof(*m));
+    m->out = strcmp(path, "-") == 0 ? stdout : fopen(path, "w");
+    if (!m->out) {
+        perror(path);
+        return false;
+    }
+    m->every_frames = every_frames ? every_frames : 1;
+    m->budget_us = budget_us;
+    m->label = label;
+    start_interval(m, 0, 0);
+    return true;
+}
+
+// Writes "s" as a JSON string, quotes included
+static void put_json_string(FILE* f, const char* s) {
+    fputc('"', f);
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\')
+            fprintf(f, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(f, "\\u%04x", c);
+        else
+            fputc(c, f);
+    }
+    fputc('"', f);
+}
+
+void metrics_dump(frame_metrics* m, uint32_t frame, uint64_t cyc) {
+    if (!m->out)
+        return;
+    double elapsed = metrics_now() - m->start_time;
+
+    // One JSON object per line
+    fputs("{\"label\":", m->out);
+    put_json_string(m->out, m->label ? m->label : "");
+    fprintf(m->out, ",\"frames\":[%u,%u],\"seconds\":%.3f,"
+            "\"fps\":%.2f,\"mhz\":%.3f,\"over_budget\":%u,\"audio_late\":%u",
+            m->first_frame, frame, elapsed,
+            elapsed > 0 ? m->frames / elapsed : 0.0,
+            elapsed > 0 ? (cyc - m->start_cyc) / elapsed / 1e6 : 0.0,
+            m->over_budget, m->audio_late);
+    for (int i = 0; i < METRIC_COUNT; i++) {
+        const metrics_hist* h = &m->hist[i];
+        fprintf(m->out, ",\"%s\":{\"count\":%llu,\"mean\":%.1f,\"p50\":%u,\"p90\":%u,"
+                "\"p99\":%u,\"p999\":%u,\"max\":%u}",
+                series_names[i], (unsigned long long)h->total,
+                h->total ? (double)h->sum / h->total : 0.0,
+                metrics_hist_percentile(h, 50), metrics_hist_percentile(h, 90),
+                metrics_hist_percentile(h, 99), metrics_hist_percentile(h, 99.9), h->max);
+    }
+    fprintf(m->out, "}\n");
+    fflush(m->out);
+    start_interval(m, frame, cyc);
+}
+
+void metrics_end_frame(frame_metrics* m, uint32_t work_us, uint32_t frame, uint64_t cyc) {
+    if (work_us > m->budget_us)
+        m->over_budget++;
+    if (++m->frames >= m->every_frames)
+        metrics_dump(m, frame, cyc);
+}
+
+void metrics_close(frame_metrics* m, uint32_t frame, uint64_t cyc) {
+    if (!m->out)
+        return;
+    if (m->frames)
+        metrics_dump(m, frame, cyc);
+    if (m->out != stdout)
+        fclose(m->out);
+    m->out = NULL;
+}
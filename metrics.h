@@ -0,0 +1,104 @@
+#ifndef ZX_METRICS_H_
+#define ZX_METRICS_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// --- [ Frame Loop Metrics ] ---
+// Shows whether the emulator keeps up with the 50 Hz display: how long
+// each part of a frame takes, and how many frames blow the 20 ms budget.
+//
+// Every quantity goes into a fixed-size log-linear histogram (the layout
+// HdrHistogram uses): values below 64 have a bucket each, above that every
+// power of two is split into 32 buckets, so any value is known to within
+// ~3%. Recording is a count-leading-zeros and an increment, with no
+// allocation and no locking; 896 buckets cover 1 us to over an hour.
+//
+// Every "every_frames" frames the histograms are written as one JSON line
+// (count, mean, p50, p90, p99, p99.9, max per series, plus emulated MHz and
+// frames over budget) and then cleared, so each line covers one interval.
+// Series are times in microseconds, except the sound ring depth (samples).
+
+#define METRICS_SUB_BITS   6
+#define METRICS_SUB_COUNT  (1u << METRICS_SUB_BITS)              // 64
+#define METRICS_BUCKETS    (METRICS_SUB_COUNT + \
+                            (32 - METRICS_SUB_BITS) * (METRICS_SUB_COUNT / 2)) // 896
+
+typedef struct metrics_hist {
+    uint32_t counts[METRICS_BUCKETS];
+    uint64_t total;              // Number of values
+    uint64_t sum;                // For the mean
+    uint32_t min, max;
+} metrics_hist;
+
+// What the frame loop measures (times in microseconds)
+typedef enum metrics_series {
+    METRIC_EMULATE,              // Running the Z80 for one frame (plus recorders)
+    METRIC_RENDER,               // Building the framebuffer
+    METRIC_PRESENT,              // Texture upload and present
+    METRIC_SLEEP,                // Waiting for the next frame
+    METRIC_FRAME,                // Whole frame, sleep included
+    METRIC_AUDIO,                // Time between two audio buffer requests
+    METRIC_AUDIO_QUEUE,          // Samples waiting in the sound ring at each request
+    METRIC_COUNT
+} metrics_series;
+
+typedef struct frame_metrics {
+    metrics_hist hist[METRIC_COUNT];
+    uint32_t budget_us;          // Work (emulate + render + present) allowed per frame
+    uint32_t over_budget;        // Frames over budget in this interval
+    uint32_t audio_late;         // Audio requests over two buffers apart (sound ran dry)
+
+    FILE*       out;             // JSON lines go here
+    const char* label;           // Copied into every line (game name...), may be NULL
+    uint32_t    every_frames;
+    uint32_t    frames;          // Frames in this interval
+    uint32_t    first_frame;     // Emulated frame number at the start of the interval
+    uint64_t    start_cyc;       // T-states at the start of the interval
+    double      start_time;      // Seconds, metrics_now()
+} frame_metrics;
+
+// Monotonic-enough wall clock in seconds
+double metrics_now(void);
+
+void metrics_hist_reset(metrics_hist* h);
+
+// Bucket of a value: exact below 64, then 32 buckets per power of two
+static inline uint32_t metrics_bucket(uint32_t v) {
+    if (v < METRICS_SUB_COUNT)
+        return v;
+    int msb = 31 - __builtin_clz(v);
+    int shift = msb - METRICS_SUB_BITS + 1;                  // >= 1
+    return METRICS_SUB_COUNT + (uint32_t)(shift - 1) * (METRICS_SUB_COUNT / 2) +
+           ((v >> shift) - METRICS_SUB_COUNT / 2);
+}
+
+static inline void metrics_hist_record(metrics_hist* h, uint32_t v) {
+    h->counts[metrics_bucket(v)]++;
+    h->total++;
+    h->sum += v;
+    if (v < h->min) h->min = v;
+    if (v > h->max) h->max = v;
+}
+
+// Value below which "p" percent of the recorded values fall (bucket upper
+// bound, never above the largest value seen). 0 if nothing was recorded.
+uint32_t metrics_hist_percentile(const metrics_hist* h, double p);
+
+// Starts writing JSON lines to "path" ("-" = stdout) every "every_frames"
+// frames. "budget_us" is the work time allowed per frame.
+bool metrics_open(frame_metrics* m, const char* path, uint32_t every_frames,
+                  uint32_t budget_us, const char* label);
+
+// Ends a frame: "work_us" is the time spent before sleeping. Writes and
+// clears the interval when it is complete.
+void metrics_end_frame(frame_metrics* m, uint32_t work_us, uint32_t frame, uint64_t cyc);
+
+// Writes the interval so far and clears it
+void metrics_dump(frame_metrics* m, uint32_t frame, uint64_t cyc);
+
+// Writes what is left and closes the file
+void metrics_close(frame_metrics* m, uint32_t frame, uint64_t cyc);
+
+#endif // ZX_METRICS_H_
@@ -0,0 +1,208 @@
+#include <string.h>   // memcpy, memcmp
+
+#include "movie.h"
+
+#define TAG_END      0x00
+#define TAG_CHECKSUM 0x01
+#define TAG_JOY      0x02
+#define TAG_KEY      0x80
+
+// --- [ Small Binary Helpers ] ---
+static void put_varint(FILE* f, uint32_t v) {
+    while (v >= 0x80) {
+        fputc((int)(v | 0x80) & 0xFF, f);
+        v >>= 7;
+    }
+    fputc((int)v, f);
+}
+
+static bool get_varint(FILE* f, uint32_t* v) {
+    *v = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        int c = fgetc(f);
+        if (c == EOF)
+            return false;
+        *v |= (uint32_t)(c & 0x7F) << shift;
+        if (!(c & 0x80))
+            return true;
+    }
+    return false;
+}
+
+static void put_u32(FILE* f, uint32_t v) {
+    for (int i = 0; i < 4; i++)
+        fputc((int)(v >> (8 * i)) & 0xFF, f);
+}
+
+static bool get_u32(FILE* f, uint32_t* v) {
+    uint8_t b[4];
+    if (fread(b, 1, 4, f) != 4)
+        return false;
+    *v = b[0] | b[1] << 8 | b[2] << 16 | (uint32_t)b[3] << 24;
+    return true;
+}
+
+// Starts a record: tag byte + frame delta since the previous record
+static void put_header(movie_recorder* m, uint8_t tag, uint32_t frame) {
+    fputc(tag, m->f);
+    put_varint(m->f, frame - m->last_frame);
+    m->last_frame = frame;
+}
+
+// --- [ Recording ] ---
+bool movie_record_open(movie_recorder* m, const char* path,
+                       const zx_spectrum* zx, uint16_t checksum_interval) {
+    m->f = fopen(path, "wb");
+    if (!m->f) {
+        perror(path);
+        return false;
+    }
+    m->interval = checksum_interval;
+    m->last_frame = zx->frame;
+    memcpy(m->rows, zx->key_matrix, sizeof(m->rows));
+    m->kempston = 0;
+
+    const uint8_t header[8] = {'Z', 'X', 'M', 'V', MOVIE_VERSION, 0,
+                               checksum_interval & 0xFF, checksum_interval >> 8};
+    fwrite(header, 1, sizeof(header), m->f);
+
+    // The initial state is checked too: catches a different ROM right away
+    put_header(m, TAG_CHECKSUM, zx->frame);
+    put_u32(m->f, zx_state_checksum(zx));
+    return true;
+}
+
+void movie_record_keys(movie_recorder* m, const zx_spectrum* zx) {
+    if (!m->f)
+        return;
+    if (zx->kempston != m->kempston) {
+        put_header(m, TAG_JOY, zx->frame);
+        put_varint(m->f, (uint32_t)zx_frame_tstate(zx));
+        fputc(zx->kempston, m->f);
+        m->kempston = zx->kempston;
+    }
+    if (memcmp(m->rows, zx->key_matrix, sizeof(m->rows)) == 0)
+        return;
+
+    for (int row = 0; row < 8; row++) {
+        if (zx->key_matrix[row] == m->rows[row])
+            continue;
+        put_header(m, TAG_KEY | row, zx->frame);
+        put_varint(m->f, (uint32_t)zx_frame_tstate(zx));
+        fputc(zx->key_matrix[row], m->f);
+        m->rows[row] = zx->key_matrix[row];
+    }
+}
+
+void movie_record_frame(movie_recorder* m, const zx_spectrum* zx) {
+    if (!m->f || m->interval == 0 || zx->frame % m->interval != 0)
+        return;
+    put_header(m, TAG_CHECKSUM, zx->frame);
+    put_u32(m->f, zx_state_checksum(zx));
+}
+
+void movie_record_close(movie_recorder* m, const zx_spectrum* zx) {
+    if (!m->f)
+        return;
+    put_header(m, TAG_END, zx->frame);
+    fclose(m->f);
+    m->f = NULL;
+}
+
+// --- [ Replay ] ---
+// Decodes the next record into m->tag/frame/tstate/value.
+// A truncated file simply ends the movie at the last complete record.
+static void next_record(movie_player* m) {
+    int tag = fgetc(m->f);
+    uint32_t delta = 0;
+
+    if (tag == EOF || !get_varint(m->f, &delta)) {
+        m->tag = TAG_END;
+        m->frame = m->last_frame;
+        return;
+    }
+    m->tag = (uint8_t)tag;
+    m->frame = m->last_frame + delta;
+    m->last_frame = m->frame;
+
+    bool ok = true;
+    if (tag & TAG_KEY || (tag == TAG_JOY && m->version >= 2)) {
+        int value;
+        ok = get_varint(m->f, &m->tstate) && (value = fgetc(m->f)) != EOF;
+        if (ok)
+            m->value = (uint32_t)value;
+    } else if (tag == TAG_CHECKSUM) {
+        ok = get_u32(m->f, &m->value);
+    } else if (tag != TAG_END) {
+        ok = false;  // Unknown record: stop here rather than guess
+    }
+
+    if (!ok) {
+        m->tag = TAG_END;
+        m->frame = m->last_frame;
+    }
+}
+
+bool movie_play_open(movie_player* m, const char* path) {
+    memset(m, 0, sizeof(*m));
+    m->f = fopen(path, "rb");
+    if (!m->f) {
+        perror(path);
+        return false;
+    }
+
+    uint8_t header[8];
+    if (fread(header, 1, sizeof(header), m->f) != sizeof(header) ||
+        memcmp(header, "ZXMV", 4) != 0 || header[4] < 1 || header[4] > MOVIE_VERSION) {
+        fprintf(stderr, "%s: not a version 1-%d movie file\n", path, MOVIE_VERSION);
+        fclose(m->f);
+        m->f = NULL;
+        return false;
+    }
+    m->version = header[4];
+    m->interval = header[6] | header[7] << 8;
+
+    next_record(m);
+    return true;
+}
+
+bool movie_play_frame(movie_player* m, zx_spectrum* zx) {
+    if (!m->f || m->diverged)
+        return false;
+
+    // --- [ Apply every record stamped with this frame ] ---
+    while (m->frame <= zx->frame) {
+        if (m->tag == TAG_END) {
+            m->end_frame = m->frame;
+            return false;
+        }
+
+        if (m->tag == TAG_CHECKSUM) {
+            if (m->frame == zx->frame && zx_state_checksum(zx) != m->value) {
+                m->diverged = true;
+                m->diverged_frame = zx->frame;
+                return false;
+            }
+        } else if (m->frame == zx->frame) {
+            // Input change: run up to its T-state, then update the row
+            // (or the joystick).
+            // If the debugger stops the machine first, the record stays
+            // pending and the next call picks up from here.
+            if (!zx_run_until(zx, m->tstate))
+                return false;
+            if (m->tag == TAG_JOY)
+                zx->kempston = (uint8_t)m->value;
+            else
+                zx_set_key_row(zx, m->tag & 7, (uint8_t)m->value);
+        }
+        next_record(m);
+    }
+
+    return zx_end_frame(zx);
+}
+
+void movie_play_close(movie_player* m) {
+    if (m->f)
+        fclose(m->f);
+    m->f = NULL;
+}
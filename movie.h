@@ -0,0 +1,86 @@
+#ifndef ZX_MOVIE_H_
+#define ZX_MOVIE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "spectrum.h"
+
+// --- [ Input Movies ] ---
+// A movie is the list of keyboard matrix changes of one run, each stamped
+// with the frame number and the T-state within that frame. Feeding it back
+// into a freshly reset machine reproduces the run bit for bit, without SDL.
+//
+// File layout (all multi-byte integers are little-endian):
+//
+//   "ZXMV" <version u8> <reserved u8> <checksum interval u16>
+//   record*
+//
+// Every record starts with a tag byte and a varint frame delta (frames
+// since the previous record):
+//
+//   0x80|row  <frame delta> <tstate varint> <row value u8>  key row change
+//   0x02      <frame delta> <tstate varint> <bits u8>       Kempston joystick change (v2)
+//   0x01      <frame delta> <checksum u32>                  state checksum
+//   0x00      <frame delta>                                 end of movie
+//
+// A checksum record stamped with frame F holds zx_state_checksum() taken
+// right after frame F-1 finished, i.e. before any input of frame F.
+//
+// Whether a Kempston interface is attached is not recorded: replay with the
+// same setting (zxheadless --kempston), as with the model.
+
+// Version 2 added the joystick record; version 1 files (keys only) still play.
+#define MOVIE_VERSION 2
+
+typedef struct movie_recorder {
+    FILE*    f;
+    uint8_t  rows[8];         // Key matrix as last written to the file
+    uint8_t  kempston;        // Joystick bits as last written
+    uint32_t last_frame;      // Frame of the previous record
+    uint16_t interval;        // Checksum every N frames (0 = never)
+} movie_recorder;
+
+typedef struct movie_player {
+    FILE*    f;
+    uint8_t  version;         // Of the file being played
+    uint16_t interval;
+    uint32_t last_frame;
+
+    // Next record, already decoded (tag 0x00 once the movie is over)
+    uint8_t  tag;
+    uint32_t frame;
+    uint32_t tstate;
+    uint32_t value;           // Row value, joystick bits or checksum
+
+    uint32_t end_frame;       // Total frames once the end record is seen
+    bool     diverged;        // A checksum did not match
+    uint32_t diverged_frame;
+} movie_player;
+
+// --- [ Recording ] ---
+bool movie_record_open(movie_recorder* m, const char* path,
+                       const zx_spectrum* zx, uint16_t checksum_interval);
+
+// Writes every key row (and the Kempston joystick) that changed since the
+// last call. Call it whenever the front end may have changed the input.
+void movie_record_keys(movie_recorder* m, const zx_spectrum* zx);
+
+// Call after every completed frame; writes a checksum every N frames.
+void movie_record_frame(movie_recorder* m, const zx_spectrum* zx);
+
+void movie_record_close(movie_recorder* m, const zx_spectrum* zx);
+
+// --- [ Replay ] ---
+bool movie_play_open(movie_player* m, const char* path);
+
+// Runs one complete frame, applying the recorded input at the exact
+// T-states and verifying any checksum due. Returns false once the movie
+// has ended or a checksum mismatched (see m->diverged), or when the debugger
+// stopped the machine mid-frame (call again to resume).
+bool movie_play_frame(movie_player* m, zx_spectrum* zx);
+
+void movie_play_close(movie_player* m);
+
+#endif // ZX_MOVIE_H_
@@ -0,0 +1,188 @@
+#include <stdlib.h>   // malloc, free
+#include <string.h>   // memcpy, memset
+
+#include "rewind.h"
+#include "delta.h"
+
+// A keyframe is forced at least once per second of history. Every delta is
+// taken against the last keyframe, so deltas never chain; the interval
+// bounds their size instead, as RAM drifts further from the keyframe.
+#define REWIND_KEY_INTERVAL 50
+
+// --- [ Ring Helpers ] ---
+static uint32_t ring_index(const rewind_buffer* rw, uint32_t i) {
+    return (rw->head + i) % rw->capacity;
+}
+
+// Drops the oldest entry. If it was a keyframe, the deltas that depend on
+// it are useless now, so they are dropped as well.
+static void drop_oldest(rewind_buffer* rw) {
+    do {
+        if (rw->head == rw->last_key)
+            rw->since_key = rw->key_interval;  // Next push must be a keyframe
+        rw->head = (rw->head + 1) % rw->capacity;
+        rw->count--;
+    } while (rw->count > 0 && !rw->entries[rw->head].is_key);
+
+    if (rw->count == 0) {
+        rw->arena_head = rw->arena_tail = 0;
+        rw->since_key = rw->key_interval;
+    } else {
+        rw->arena_head = rw->entries[rw->head].offset;
+    }
+}
+
+// Reserves "size" contiguous bytes in the arena, evicting old entries as
+// needed. The caller guarantees size <= budget.
+static size_t arena_alloc(rewind_buffer* rw, size_t size) {
+    for (;;) {
+        if (rw->count == 0)
+            return 0;
+
+        // The oldest entry is always a (non-empty) keyframe, so
+        // tail == head can only mean that the arena is completely full.
+        if (rw->arena_tail > rw->arena_head) {
+            // Used region is [head, tail): free space at the end, then at 0
+            if (rw->arena_tail + size <= rw->budget)
+                return rw->arena_tail;
+            if (size <= rw->arena_head)
+                return 0;
+        } else if (rw->arena_tail < rw->arena_head) {
+            // Used region wraps: the only gap is [tail, head)
+            if (rw->arena_tail + size <= rw->arena_head)
+                return rw->arena_tail;
+        }
+        drop_oldest(rw);
+    }
+}
+
+// --- [ Public Interface ] ---
+bool rewind_init(rewind_buffer* rw, uint32_t frames, size_t budget,
+                 size_t ram_size) {
+    memset(rw, 0, sizeof(*rw));
+    if (frames == 0 || budget < 2 * ram_size)
+        return false;
+
+    rw->entries = calloc(frames, sizeof(rewind_entry));
+    rw->arena = malloc(budget);
+    rw->scratch = malloc(DELTA_MAX_SIZE(ram_size));
+    if (!rw->entries || !rw->arena || !rw->scratch) {
+        rewind_free(rw);
+        return false;
+    }
+
+    rw->capacity = frames;
+    rw->budget = budget;
+    rw->ram_size = ram_size;
+    rw->key_interval = REWIND_KEY_INTERVAL;
+    rw->since_key = rw->key_interval;
+    return true;
+}
+
+void rewind_free(rewind_buffer* rw) {
+    free(rw->entries);
+    free(rw->arena);
+    free(rw->scratch);
+    memset(rw, 0, sizeof(*rw));
+}
+
+void rewind_push(rewind_buffer* rw, uint32_t frame, const z80* cpu,
+                 const uint8_t* ram, uint32_t aux) {
+    if (!rw->entries)
+        return;
+
+    // Make room for one more descriptor
+    if (rw->count == rw->capacity)
+        drop_oldest(rw);
+
+    // --- [ Try a delta against the current keyframe first ] ---
+    // Deltas larger than half the RAM are not worth it: store a keyframe.
+    size_t size = DELTA_OVERFLOW;
+    if (rw->since_key < rw->key_interval) {
+        const rewind_entry* key = &rw->entries[rw->last_key];
+        size = delta_encode(ram, rw->arena + key->offset, rw->ram_size,
+                            rw->scratch, rw->ram_size / 2);
+    }
+
+    bool is_key = (size == DELTA_OVERFLOW);
+    size_t offset = 0;
+    if (!is_key) {
+        offset = arena_alloc(rw, size);
+
+        // Evicting old data may have taken our keyframe with it
+        if (rw->since_key >= rw->key_interval)
+            is_key = true;
+    }
+    if (is_key) {
+        size = rw->ram_size;
+        offset = arena_alloc(rw, size);
+    }
+
+    // --- [ Commit the entry ] ---
+    uint32_t idx = ring_index(rw, rw->count);
+    rewind_entry* e = &rw->entries[idx];
+    e->cpu = *cpu;
+    e->aux = aux;
+    e->frame = frame;
+    e->offset = offset;
+    e->size = size;
+    e->is_key = is_key;
+
+    if (is_key) {
+        memcpy(rw->arena + offset, ram, size);
+        e->key = idx;
+        rw->last_key = idx;
+        rw->since_key = 0;
+    } else {
+        memcpy(rw->arena + offset, rw->scratch, size);
+        e->key = rw->last_key;
+        rw->since_key++;
+    }
+
+    if (rw->count == 0)
+        rw->arena_head = offset;
+    rw->arena_tail = offset + size;
+    rw->count++;
+}
+
+bool rewind_restore(rewind_buffer* rw, uint32_t back, z80* cpu, uint8_t* ram,
+                    uint32_t* aux, uint32_t* frame) {
+    if (back >= rw->count)
+        return false;
+
+    uint32_t pos = rw->count - 1 - back;
+    const rewind_entry* e = &rw->entries[ring_index(rw, pos)];
+    const rewind_entry* key = &rw->entries[e->key];
+
+    // --- [ Rebuild RAM: keyframe copy + one delta ] ---
+    memcpy(ram, rw->arena + key->offset, rw->ram_size);
+    if (!e->is_key)
+        delta_apply(ram, rw->ram_size, rw->arena + e->offset, e->size);
+
+    z80_blocks_flush(cpu->blocks);  // RAM changed behind the core's back
+    z80_icache_flush(cpu->icache);
+
+    // --- [ Restore registers, keeping the caller's callbacks ] ---
+    z80 saved = *cpu;
+    *cpu = e->cpu;
+    cpu->read_byte = saved.read_byte;
+    cpu->write_byte = saved.write_byte;
+    cpu->port_in = saved.port_in;
+    cpu->port_out = saved.port_out;
+    cpu->userdata = saved.userdata;
+    cpu->blocks = saved.blocks;     // ...and its decode caches
+    cpu->icache = saved.icache;
+    cpu->core = saved.core;         // ...its core variant and profiler
+    cpu->profile = saved.profile;
+    if (aux)
+        *aux = e->aux;
+    if (frame)
+        *frame = e->frame;
+
+    // --- [ Forget the future: recording continues from this frame ] ---
+    rw->count = pos + 1;
+    rw->arena_tail = e->offset + e->size;
+    rw->last_key = e->key;
+    rw->since_key = (ring_index(rw, pos) + rw->capacity - e->key) % rw->capacity;
+    return true;
+}
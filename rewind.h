@@ -0,0 +1,69 @@
+#ifndef ZX_REWIND_H_
+#define ZX_REWIND_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "z80.h"
+
+// --- [ Rewind History ] ---
+// Keeps the last N frames of machine state in a bounded ring buffer.
+//
+// Every entry stores the CPU registers plus RAM, either as a full copy
+// (a "keyframe") or as an XOR/RLE delta against the most recent keyframe.
+// Deltas never chain on each other, so restoring any frame costs one
+// memcpy of the keyframe plus one delta_apply, whatever its age.
+//
+// All memory is allocated up front by rewind_init: "budget" bytes of data
+// arena plus one small descriptor per frame. When the arena is full the
+// oldest frames are dropped, never the newest.
+
+typedef struct rewind_entry {
+    z80      cpu;        // Register snapshot (callbacks are not restored)
+    uint32_t aux;        // Other machine state supplied by the caller (paging)
+    uint32_t frame;      // Frame number supplied by the caller
+    uint32_t key;        // Index of the keyframe this entry depends on
+    size_t   offset;     // Start of this entry's data in the arena
+    size_t   size;       // Size of this entry's data in the arena
+    bool     is_key;     // true = full RAM copy, false = delta
+} rewind_entry;
+
+typedef struct rewind_buffer {
+    rewind_entry* entries;   // Ring of "capacity" descriptors
+    uint32_t capacity;
+    uint32_t head;           // Index of the oldest entry
+    uint32_t count;          // Number of valid entries
+
+    uint8_t* arena;          // Fixed-size data store for RAM images
+    size_t   budget;
+    size_t   arena_head;     // Where the oldest entry's data starts
+    size_t   arena_tail;     // Where the next entry's data will go
+
+    size_t   ram_size;       // Bytes of RAM captured per frame
+    uint32_t key_interval;   // Force a keyframe at least this often
+    uint32_t since_key;      // Frames pushed since the last keyframe
+    uint32_t last_key;       // Ring index of the last keyframe
+
+    uint8_t* scratch;        // Encoder output before it is copied in
+} rewind_buffer;
+
+// Allocates the history. Returns false if out of memory or if the budget
+// cannot hold at least one keyframe.
+bool rewind_init(rewind_buffer* rw, uint32_t frames, size_t budget,
+                 size_t ram_size);
+void rewind_free(rewind_buffer* rw);
+
+// Appends the current machine state as the newest frame. "aux" is kept
+// as is (state outside the CPU and RAM, e.g. the 128K paging register).
+void rewind_push(rewind_buffer* rw, uint32_t frame, const z80* cpu,
+                 const uint8_t* ram, uint32_t aux);
+
+// Restores the state "back" frames before the newest one (0 = newest),
+// and discards every newer frame so recording continues from there.
+// Returns false if that frame is no longer in the history. "aux" and
+// "frame" may be NULL.
+bool rewind_restore(rewind_buffer* rw, uint32_t back, z80* cpu, uint8_t* ram,
+                    uint32_t* aux, uint32_t* frame);
+
+#endif // ZX_REWIND_H_
@@ -0,0 +1,90 @@
+#include <string.h>
+
+#include "sched.h"
+
+void sched_init(zx_scheduler* s) {
+    memset(s, 0, sizeof(*s));
+    memset(s->pos, -1, sizeof(s->pos));
+}
+
+void sched_set_handler(zx_scheduler* s, int id, sched_fn fn) {
+    s->fn[id] = fn;
+}
+
+// --- [ Binary Heap ] ---
+// Earlier due time first; same time: scheduled first
+static bool earlier(const zx_scheduler* s, int a, int b) {
+    if (s->when[a] != s->when[b])
+        return sched_before(s->when[a], s->when[b]);
+    return (int32_t)(s->seq[a] - s->seq[b]) < 0;
+}
+
+static void place(zx_scheduler* s, int i, int id) {
+    s->heap[i] = (uint8_t)id;
+    s->pos[id] = (int8_t)i;
+}
+
+static void sift_up(zx_scheduler* s, int i) {
+    int id = s->heap[i];
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!earlier(s, id, s->heap[parent]))
+            break;
+        place(s, i, s->heap[parent]);
+        i = parent;
+    }
+    place(s, i, id);
+}
+
+static void sift_down(zx_scheduler* s, int i) {
+    int id = s->heap[i];
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= s->count)
+            break;
+        if (child + 1 < s->count && earlier(s, s->heap[child + 1], s->heap[child]))
+            child++;
+        if (!earlier(s, s->heap[child], id))
+            break;
+        place(s, i, s->heap[child]);
+        i = child;
+    }
+    place(s, i, id);
+}
+
+static void remove_at(zx_scheduler* s, int i) {
+    int id = s->heap[i];
+    s->pos[id] = -1;
+    if (--s->count == i)
+        return;
+    int moved = s->heap[s->count];    // Last event fills the hole...
+    place(s, i, moved);
+    sift_down(s, i);                  // ...and moves to where it belongs
+    sift_up(s, s->pos[moved]);
+}
+
+// --- [ Scheduling ] ---
+void sched_at(zx_scheduler* s, int id, unsigned long when) {
+    sched_cancel(s, id);
+    s->when[id] = when;
+    s->seq[id] = s->next_seq++;
+    place(s, s->count++, id);
+    sift_up(s, s->count - 1);
+}
+
+void sched_cancel(zx_scheduler* s, int id) {
+    if (s->pos[id] >= 0)
+        remove_at(s, s->pos[id]);
+}
+
+void sched_dispatch(zx_scheduler* s, unsigned long now, void* ctx) {
+    while (s->count > 0) {
+        int id = s->heap[0];
+        unsigned long when = s->when[id];
+        if (sched_before(now, when))
+            break;
+        remove_at(s, 0);
+        if (s->fn[id])
+            s->fn[id](ctx, when);
+    }
+}
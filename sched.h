@@ -0,0 +1,72 @@
+#ifndef ZX_SCHED_H_
+#define ZX_SCHED_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// --- [ Event Scheduler ] ---
+// Timed machine events (end of frame, and later tape edges, beam position,
+// scripted input...) are kept in a binary min-heap ordered by the T-state
+// at which they are due. The run loop asks for the earliest deadline, runs
+// the CPU straight up to it without checking anything else, and only then
+// calls the handlers that are due. Nothing is polled per instruction.
+//
+// Each event id has at most one pending occurrence; scheduling it again
+// moves it. Handlers may schedule events (their own id included).
+//
+// Times are absolute cpu.cyc values. cyc is an unsigned long, which is 32
+// bits on Windows and wraps after ~20 minutes at 3.5 MHz, so times are
+// compared by their signed difference: pending events must be less than
+// 2^31 T-states (10 minutes) apart.
+
+#define SCHED_MAX_EVENTS 16
+
+// Handler: "ctx" is what sched_dispatch was given, "when" the time it was due
+typedef void (*sched_fn)(void* ctx, unsigned long when);
+
+typedef struct zx_scheduler {
+    unsigned long when[SCHED_MAX_EVENTS];    // Due time of each event id
+    uint32_t      seq[SCHED_MAX_EVENTS];     // Scheduling order (ties)
+    sched_fn      fn[SCHED_MAX_EVENTS];      // Handler of each event id
+    int8_t        pos[SCHED_MAX_EVENTS];     // Heap index, -1 = not pending
+    uint8_t       heap[SCHED_MAX_EVENTS];    // Event ids, earliest first
+    int           count;
+    uint32_t      next_seq;
+} zx_scheduler;
+
+// True if time "a" comes before time "b" (wrap-safe)
+static inline bool sched_before(unsigned long a, unsigned long b) {
+    return (long)(a - b) < 0;
+}
+
+// The scheduler holds no pointer to its owner, so a machine copied by value
+// (benchmarks, rewind) keeps working: the owner is passed to each dispatch.
+void sched_init(zx_scheduler* s);
+
+// Sets the handler of event "id" (0 .. SCHED_MAX_EVENTS-1)
+void sched_set_handler(zx_scheduler* s, int id, sched_fn fn);
+
+// Schedules (or moves) event "id" to T-state "when"
+void sched_at(zx_scheduler* s, int id, unsigned long when);
+
+// Removes event "id" if it is pending
+void sched_cancel(zx_scheduler* s, int id);
+
+static inline bool sched_pending(const zx_scheduler* s, int id) {
+    return s->pos[id] >= 0;
+}
+
+// Due time of the earliest event, or "limit" if it comes later (or there
+// are no events)
+static inline unsigned long sched_next(const zx_scheduler* s, unsigned long limit) {
+    if (s->count == 0)
+        return limit;
+    unsigned long t = s->when[s->heap[0]];
+    return sched_before(t, limit) ? t : limit;
+}
+
+// Calls the handlers of every event due at or before "now", earliest first
+// (events due at the same time run in the order they were scheduled).
+void sched_dispatch(zx_scheduler* s, unsigned long now, void* ctx);
+
+#endif // ZX_SCHED_H_
@@ -0,0 +1,56 @@
+#include <string.h>   // memset, memcpy
+
+#include "screenhash.h"
+
+// --- [ Mask Building ] ---
+void zx_hash_mask_init(zx_hash_mask* m) {
+    memset(m->keep, 0xFF, sizeof(m->keep));
+}
+
+void zx_hash_mask_cells(zx_hash_mask* m, int col, int row, int w, int h) {
+    for (int r = row; r < row + h; r++) {
+        for (int c = col; c < col + w; c++) {
+            if (r < 0 || r >= 24 || c < 0 || c >= 32)
+                continue;
+            // The 8 bitmap bytes of a cell are 256 bytes apart
+            int base = (r & 0x18) << 8 | (r & 0x07) << 5 | c;
+            for (int k = 0; k < 8; k++)
+                m->keep[base + (k << 8)] = 0;
+            m->keep[6144 + r * 32 + c] = 0;   // Its attribute byte
+        }
+    }
+}
+
+// --- [ Hashing ] ---
+static uint64_t mix(uint64_t h, uint64_t v) {
+    h ^= v;
+    h *= 0x100000001B3ull;   // FNV-1a 64-bit prime
+    return h ^ (h >> 29);
+}
+
+uint64_t zx_hash_screen(const uint8_t* screen, bool flash_state,
+                        const zx_hash_mask* mask) {
+    uint64_t h = 0xCBF29CE484222325ull;  // FNV-1a 64-bit offset basis
+    uint64_t flashing = 0;               // FLASH bits of visible attributes
+
+    for (int i = 0; i < ZX_SCREEN_BYTES; i += 8) {
+        uint64_t w;
+        memcpy(&w, screen + i, 8);
+        if (mask) {
+            uint64_t k;
+            memcpy(&k, mask->keep + i, 8);
+            w &= k;
+        }
+        if (i >= 6144)
+            flashing |= w & 0x8080808080808080ull;
+        h = mix(h, w);
+    }
+
+    if (flashing && flash_state)
+        h = mix(h, 1);
+    return h ^ (h >> 32);
+}
+
+uint64_t zx_screen_hash(const zx_spectrum* zx, const zx_hash_mask* mask) {
+    return zx_hash_screen(zx_screen(zx), zx->flash_state, mask);
+}
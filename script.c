@@ -0,0 +1,361 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "script.h"
+#include "keymap.h"
+
+enum {
+    OP_AT,                     // Wait for frame.tstate
+    OP_AFTER,                  // Wait that many frames from here
+    OP_DOWN,                   // Press keys
+    OP_UP,                     // Release keys
+    OP_WAIT_HASH,
+    OP_WAIT_MEM,
+    OP_WAIT_PC,
+};
+
+// --- [ Typing ] ---
+// Characters that are SYMBOL SHIFT + a key on the Spectrum keyboard
+static const char symbol_chars[] = "!@#$%&'()_<>^-+=;:\"?,./*";
+static const char symbol_keys[]  = "1234567890RTHJKLOZPCNMVB";
+
+// Keys for one typed character; 0 if it cannot be typed
+static int char_keys(char c, uint8_t keys[2]) {
+    char name[2] = {(char)toupper((unsigned char)c), '\0'};
+    const char* sym = c ? strchr(symbol_chars, c) : NULL;
+    if (sym) {
+        keys[0] = (uint8_t)keymap_spectrum_key("SYMBOL");
+        name[0] = symbol_keys[sym - symbol_chars];
+        keys[1] = (uint8_t)keymap_spectrum_key(name);
+        return 2;
+    }
+    int key = isalnum((unsigned char)c) ? keymap_spectrum_key(name) : -1;
+    if (key < 0)
+        return 0;
+    keys[0] = (uint8_t)key;
+    return 1;
+}
+
+// --- [ Parsing ] ---
+typedef struct parser {
+    zx_script* s;
+    const char* source;
+    int line;
+    uint32_t hold, gap;        // Typing speed, frames
+} parser;
+
+static script_op* add(parser* p, int kind) {
+    zx_script* s = p->s;
+    if (s->nops == s->cap) {
+        int cap = s->cap ? s->cap * 2 : 64;
+        script_op* ops = realloc(s->ops, (size_t)cap * sizeof(*ops));
+        if (!ops)
+            return NULL;
+        s->ops = ops;
+        s->cap = cap;
+    }
+    script_op* op = &s->ops[s->nops++];
+    memset(op, 0, sizeof(*op));
+    op->kind = (uint8_t)kind;
+    op->line = p->line;
+    return op;
+}
+
+static bool add_after(parser* p, uint32_t frames) {
+    script_op* op = add(p, OP_AFTER);
+    if (op)
+        op->frame = frames;
+    return op != NULL;
+}
+
+// Press for "hold" frames, then release, then "gap" frames up (gap 0: none)
+static bool add_keys(parser* p, const uint8_t* keys, int nkeys, uint32_t hold, uint32_t gap) {
+    script_op* down = add(p, OP_DOWN);
+    if (!down)
+        return false;
+    down->nkeys = (uint8_t)nkeys;
+    memcpy(down->keys, keys, (size_t)nkeys);
+    if (!add_after(p, hold))
+        return false;
+    script_op* up = add(p, OP_UP);
+    if (!up)
+        return false;
+    up->nkeys = (uint8_t)nkeys;
+    memcpy(up->keys, keys, (size_t)nkeys);
+    return gap == 0 || add_after(p, gap);
+}
+
+static bool fail(const parser* p, const char* what, const char* word) {
+    fprintf(stderr, "%s:%d: %s%s%s\n", p->source, p->line, what,
+            word ? ": " : "", word ? word : "");
+    return false;
+}
+
+// "J", "SYMBOL+P": at most two keys
+static int parse_keys(char* word, uint8_t keys[2]) {
+    int n = 0;
+    for (char* part = strtok(word, "+"); part; part = strtok(NULL, "+")) {
+        int key = keymap_spectrum_key(part);
+        if (key < 0 || n == 2)
+            return 0;
+        keys[n++] = (uint8_t)key;
+    }
+    return n;
+}
+
+static bool parse_number(const char* word, int base, unsigned long long max,
+                         unsigned long long* value) {
+    char* end;
+    if (!word || !*word)
+        return false;
+    *value = strtoull(word, &end, base);
+    return *end == '\0' && *value <= max;
+}
+
+static bool parse_line(parser* p, char* line) {
+    char* words[64];
+    int n = 0;
+    for (char* w = strtok(line, " \t\r"); w && n < 64; w = strtok(NULL, " \t\r"))
+        words[n++] = w;
+    if (n == 0 || words[0][0] == '#')
+        return true;
+
+    // --- [ Time Prefix ] ---
+    int i = 0;
+    unsigned long long v;
+    if (strcmp(words[0], "at") == 0 && n > 1) {
+        script_op* op = add(p, OP_AT);
+        char* dot = strchr(words[1], '.');
+        if (dot)
+            *dot++ = '\0';
+        if (!op || !parse_number(words[1], 10, UINT32_MAX, &v))
+            return fail(p, "bad frame", words[1]);
+        op->frame = (uint32_t)v;
+        if (dot) {
+            if (!parse_number(dot, 10, UINT32_MAX, &v))
+                return fail(p, "bad T-state", dot);
+            op->tstate = (uint32_t)v;
+        }
+        i = 2;
+    } else if (strcmp(words[0], "after") == 0 && n > 1) {
+        if (!parse_number(words[1], 10, UINT32_MAX, &v) || !add_after(p, (uint32_t)v))
+            return fail(p, "bad frame count", words[1]);
+        i = 2;
+    }
+    if (i == n)
+        return true;               // Just a wait for that time
+
+    // --- [ Commands ] ---
+    const char* cmd = words[i++];
+    uint8_t keys[2];
+    int nkeys;
+    if (strcmp(cmd, "press") == 0 || strcmp(cmd, "hold") == 0 || strcmp(cmd, "release") == 0) {
+        if (i >= n || !(nkeys = parse_keys(words[i], keys)))
+            return fail(p, "bad keys", i < n ? words[i] : NULL);
+        i++;
+        if (cmd[0] == 'p') {
+            uint32_t frames = 1;
+            if (i + 1 < n && strcmp(words[i], "for") == 0) {
+                if (!parse_number(words[i + 1], 10, UINT32_MAX, &v))
+                    return fail(p, "bad frame count", words[i + 1]);
+                frames = (uint32_t)v;
+                i += 2;
+            }
+            if (!add_keys(p, keys, nkeys, frames, 0))
+                return fail(p, "out of memory", NULL);
+        } else {
+            script_op* op = add(p, cmd[0] == 'h' ? OP_DOWN : OP_UP);
+            if (!op)
+                return fail(p, "out of memory", NULL);
+            op->nkeys = (uint8_t)nkeys;
+            memcpy(op->keys, keys, (size_t)nkeys);
+        }
+    } else if (strcmp(cmd, "type") == 0) {
+        for (; i < n; i++) {
+            const char* word = words[i];
+            int key = strlen(word) > 1 ? keymap_spectrum_key(word) : -1;
+            if (key >= 0) {        // ENTER, SPACE...
+                keys[0] = (uint8_t)key;
+                if (!add_keys(p, keys, 1, p->hold, p->gap))
+                    return fail(p, "out of memory", NULL);
+                continue;
+            }
+            for (const char* c = word; *c; c++) {
+                if (!(nkeys = char_keys(*c, keys)))
+                    return fail(p, "cannot type", word);
+                if (!add_keys(p, keys, nkeys, p->hold, p->gap))
+                    return fail(p, "out of memory", NULL);
+            }
+        }
+    } else if (strcmp(cmd, "set") == 0 && i + 1 < n) {
+        if (!parse_number(words[i + 1], 10, 1000, &v) || v == 0)
+            return fail(p, "bad frame count", words[i + 1]);
+        if (strcmp(words[i], "hold") == 0)
+            p->hold = (uint32_t)v;
+        else if (strcmp(words[i], "gap") == 0)
+            p->gap = (uint32_t)v;
+        else
+            return fail(p, "unknown setting", words[i]);
+        i += 2;
+    } else if (strcmp(cmd, "mask") == 0 && i < n) {
+        int c, r, w, h;
+        if (sscanf(words[i], "%d,%d,%d,%d", &c, &r, &w, &h) != 4)
+            return fail(p, "bad mask (COL,ROW,W,H)", words[i]);
+        zx_hash_mask_cells(&p->s->mask, c, r, w, h);
+        i++;
+    } else if (strcmp(cmd, "wait") == 0 && i + 1 < n) {
+        const char* what = words[i++];
+        script_op* op;
+        if (strcmp(what, "hash") == 0) {
+            if (!(op = add(p, OP_WAIT_HASH)) || !parse_number(words[i], 16, UINT64_MAX, &v))
+                return fail(p, "bad hash", words[i]);
+            op->hash = v;
+            i++;
+        } else if (strcmp(what, "pc") == 0) {
+            if (!(op = add(p, OP_WAIT_PC)) || !parse_number(words[i], 16, 0xFFFF, &v))
+                return fail(p, "bad address", words[i]);
+            op->addr = (uint16_t)v;
+            i++;
+        } else if (strcmp(what, "mem") == 0 && i + 1 < n) {
+            if (!(op = add(p, OP_WAIT_MEM)) || !parse_number(words[i], 16, 0xFFFF, &v))
+                return fail(p, "bad address", words[i]);
+            op->addr = (uint16_t)v;
+            if (!parse_number(words[i + 1], 16, 0xFF, &v))
+                return fail(p, "bad byte", words[i + 1]);
+            op->value = (uint8_t)v;
+            i += 2;
+        } else {
+            return fail(p, "unknown wait", what);
+        }
+        if (i + 1 < n && strcmp(words[i], "timeout") == 0) {
+            if (!parse_number(words[i + 1], 10, UINT32_MAX, &v))
+                return fail(p, "bad frame count", words[i + 1]);
+            op->timeout = (uint32_t)v;
+            i += 2;
+        }
+    } else {
+        return fail(p, "unknown command", cmd);
+    }
+    return i == n || fail(p, "unexpected", words[i]);
+}
+
+bool script_load(zx_script* s, const char* path) {
+    memset(s, 0, sizeof(*s));
+    zx_hash_mask_init(&s->mask);
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    parser p = {s, path, 0, 2, 6};     // Keys must stay up 5 frames for the ROM
+    char line[512];
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), f)) {
+        p.line++;
+        line[strcspn(line, "\n")] = '\0';
+        ok = parse_line(&p, line);
+    }
+    fclose(f);
+    if (!ok)
+        script_free(s);
+    return ok;
+}
+
+void script_free(zx_script* s) {
+    free(s->ops);
+    s->ops = NULL;
+    s->nops = s->cap = 0;
+}
+
+// --- [ Running ] ---
+static bool reached(const zx_spectrum* zx, uint32_t frame, uint32_t tstate) {
+    return zx->frame > frame || (zx->frame == frame && zx_frame_tstate(zx) >= tstate);
+}
+
+// The event is due at the target itself if it is in this frame, otherwise
+// at the end of the frame (the frame event runs first, as it was scheduled
+// first): frames can overrun by a few T-states, so later ones have no
+// exact start yet.
+static void wake_at(zx_spectrum* zx, uint32_t frame, uint32_t tstate) {
+    unsigned long when = zx->frame == frame ? zx->frame_start + tstate
+                                            : zx->frame_start + zx->frame_tstates;
+    sched_at(&zx->sched, ZX_EV_SCRIPT, when);
+}
+
+static bool condition_met(const zx_script* s, const script_op* op, const zx_spectrum* zx) {
+    switch (op->kind) {
+    case OP_WAIT_HASH: return zx_screen_hash(zx, &s->mask) == op->hash;
+    case OP_WAIT_MEM:  return zx_peek(zx, op->addr) == op->value;
+    default:           return zx->cpu.pc == op->addr;
+    }
+}
+
+// Runs steps until one has to wait, then schedules the next look
+static void run(zx_script* s, zx_spectrum* zx) {
+    for (; s->next < s->nops; s->next++, s->armed = false) {
+        const script_op* op = &s->ops[s->next];
+        switch (op->kind) {
+        case OP_AT:
+        case OP_AFTER:
+            if (!s->armed) {
+                s->target_frame = op->frame;
+                s->target_tstate = op->tstate;
+                if (op->kind == OP_AFTER) {
+                    s->target_frame += zx->frame;
+                    s->target_tstate = (uint32_t)zx_frame_tstate(zx);
+                }
+                s->armed = true;
+            }
+            if (!reached(zx, s->target_frame, s->target_tstate)) {
+                wake_at(zx, s->target_frame, s->target_tstate);
+                return;
+            }
+            break;
+
+        case OP_DOWN:
+        case OP_UP:
+            for (int k = 0; k < op->nkeys; k++)
+                zx_set_key(zx, op->keys[k] >> 3, op->keys[k] & 7, op->kind == OP_DOWN);
+            break;
+
+        default:                   // Waits: look again at every frame end
+            if (!s->armed) {
+                s->target_frame = zx->frame + op->timeout;
+                s->armed = true;
+            }
+            if (!condition_met(s, op, zx)) {
+                if (op->timeout && zx->frame >= s->target_frame) {
+                    s->failed = true;
+                    snprintf(s->error, sizeof(s->error),
+                             "wait on line %d timed out at frame %u", op->line, zx->frame);
+                    zx->script_pc = -1;
+                    return;
+                }
+                if (op->kind == OP_WAIT_PC)
+                    zx->script_pc = op->addr;
+                wake_at(zx, zx->frame + 1, 0);
+                return;
+            }
+            zx->script_pc = -1;
+            break;
+        }
+    }
+    s->done = true;
+}
+
+static void script_event(void* ctx, unsigned long when) {
+    (void)when;
+    zx_spectrum* zx = ctx;
+    if (zx->script)
+        run(zx->script, zx);
+}
+
+void script_attach(zx_script* s, zx_spectrum* zx) {
+    s->next = 0;
+    s->armed = s->done = s->failed = false;
+    zx->script = s;
+    sched_set_handler(&zx->sched, ZX_EV_SCRIPT, script_event);
+    sched_at(&zx->sched, ZX_EV_SCRIPT, zx->cpu.cyc);
+}
@@ -0,0 +1,74 @@
+#ifndef ZX_SCRIPT_H_
+#define ZX_SCRIPT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "spectrum.h"
+#include "screenhash.h"
+
+// --- [ Scripted Input ] ---
+// Drives the keyboard from a text script, inside the emulation: every step
+// is an event on the machine's scheduler (ZX_EV_SCRIPT), so keys change at
+// exact T-states and a run is as deterministic as a movie, with no host
+// involvement per frame. One command per line, "#" starts a comment line:
+//
+//   at 120 press J for 3        at frame 120, hold J for 3 frames
+//   at 300.14000 press ENTER    frame 300, T-state 14000 (released after 1 frame)
+//   after 50 release J          50 frames after the previous step
+//   press SYMBOL+P              several keys at once
+//   hold CAPS / release CAPS    down until released
+//   type J "" ENTER             typed key by key: LOAD "" on the 48K, where
+//                               keywords are keys. Words that name a key
+//                               (ENTER, SPACE, CAPS, SYMBOL) press it, the
+//                               others are typed character by character,
+//                               punctuation through SYMBOL SHIFT; spaces
+//                               between words are not typed (use SPACE),
+//                               and letters press their key whatever their
+//                               case (hold CAPS for capitals)
+//   set hold 2 / set gap 6      typing speed: frames down and up per key
+//   mask 0,0,32,2               leave character cells out of "wait hash"
+//   wait hash 07E9BADB0E6DB74A  until the screen hash matches
+//   wait mem 5C3B 0C            until the byte at 5C3B is 0C
+//   wait pc 12A2 timeout 500    until PC reaches 12A2, fail after 500 frames
+//
+// Numbers after "at", "after", "for", "timeout" and "set" are decimal;
+// addresses, bytes and hashes are hex. Steps run in order: "at" waits for
+// an absolute time, "after" and "for" count from the end of the previous
+// step. Screen and memory conditions are checked at every frame end; a PC
+// condition switches the run loop to per-instruction checks while it waits.
+
+typedef struct script_op {
+    uint8_t  kind;
+    uint8_t  nkeys;
+    uint8_t  keys[2];                 // Spectrum keys (row << 3 | bit)
+    uint8_t  value;                   // wait mem
+    uint16_t addr;                    // wait mem / wait pc
+    uint32_t frame, tstate;           // at (absolute), after (relative)
+    uint32_t timeout;                 // Frames a wait may take (0 = forever)
+    uint64_t hash;                    // wait hash
+    int      line;                    // In the script, for messages
+} script_op;
+
+typedef struct zx_script {
+    script_op* ops;
+    int        nops, cap;
+    int        next;                  // Step being run
+    bool       armed;                 // Its target time / deadline is set
+    uint32_t   target_frame, target_tstate;
+    bool       done;                  // Every step has run
+    bool       failed;                // A wait timed out (see "error")
+    char       error[96];
+    zx_hash_mask mask;                // For wait hash
+} zx_script;
+
+// Parses a script file. Prints the problem and returns false if it is bad.
+bool script_load(zx_script* s, const char* path);
+
+// Starts running it on "zx", from the current T-state. The script must
+// outlive the run; check "done" and "failed" between frames.
+void script_attach(zx_script* s, zx_spectrum* zx);
+
+void script_free(zx_script* s);
+
+#endif // ZX_SCRIPT_H_
@@ -0,0 +1,190 @@
+#include <string.h>
+
+#include "sound.h"
+
+// --- [ Output Levels ] ---
+// The AY's DAC is logarithmic: these are its 16 levels (measured curve),
+// scaled so that three channels at full volume plus the beeper stay well
+// inside 16 bits.
+static const int16_t ay_level[16] = {
+    0, 70, 101, 147, 215, 319, 451, 752,
+    886, 1435, 2045, 2610, 3448, 4447, 5639, 7000
+};
+
+#define BEEPER_LEVEL  8000
+#define DC_POLE       32604            // 0.995 in Q15: ~35 Hz high-pass at 44.1 kHz
+
+// Envelope shape bits (register 13)
+#define ENV_HOLD      0x01
+#define ENV_ALT       0x02
+#define ENV_ATTACK    0x04
+#define ENV_CONT      0x08
+
+void sound_init(zx_sound* s, uint32_t cpu_hz, uint32_t rate) {
+    memset(s, 0, sizeof(*s));
+    s->ay.noise_lfsr = 1;
+    s->ay.env_holding = true;          // Shape 0 after reset: silent
+    s->ay.env_step = 15;
+    uint32_t tick_rate = cpu_hz / SOUND_TICK;
+    s->out_period = (uint32_t)(((uint64_t)tick_rate << 16) / rate);
+    atomic_init(&s->head, 0);
+    atomic_init(&s->tail, 0);
+    atomic_init(&s->dropped, 0);
+}
+
+// --- [ AY-3-8912 ] ---
+static void ay_write(ay_chip* ay, uint8_t reg, uint8_t value) {
+    ay->regs[reg & 15] = value;
+    if (reg == 13) {                   // A new shape restarts the envelope
+        ay->env_attack = (value & ENV_ATTACK) != 0;
+        ay->env_step = 0;
+        ay->env_count = 0;
+        ay->env_holding = false;
+    }
+}
+
+static void env_next(ay_chip* ay) {
+    if (++ay->env_step < 16)
+        return;
+    uint8_t shape = ay->regs[13];
+    ay->env_step = 15;
+    if (!(shape & ENV_CONT)) {         // One ramp, then 0
+        ay->env_attack = false;
+        ay->env_holding = true;
+    } else if (shape & ENV_HOLD) {     // One ramp, then hold (flipped by ALT)
+        if (shape & ENV_ALT)
+            ay->env_attack = !ay->env_attack;
+        ay->env_holding = true;
+    } else {                           // Repeat, changing direction with ALT
+        if (shape & ENV_ALT)
+            ay->env_attack = !ay->env_attack;
+        ay->env_step = 0;
+    }
+}
+
+// One tick of the chip's counters (AY clock / 8). A period of 0 acts as 1.
+static void ay_tick(ay_chip* ay) {
+    for (int c = 0; c < 3; c++) {
+        uint16_t period = ay->regs[2 * c] | (ay->regs[2 * c + 1] & 0x0F) << 8;
+        if (++ay->tone_count[c] >= period) {
+            ay->tone_count[c] = 0;
+            ay->tone_out[c] = !ay->tone_out[c];
+        }
+    }
+
+    // Noise shifts at half the tone rate for the same period
+    uint16_t noise = ay->regs[6] & 0x1F;
+    if (++ay->noise_count >= (noise ? noise : 1) * 2) {
+        ay->noise_count = 0;
+        uint32_t bit = (ay->noise_lfsr ^ (ay->noise_lfsr >> 3)) & 1;
+        ay->noise_lfsr = (ay->noise_lfsr >> 1) | bit << 16;
+    }
+
+    // 16 envelope steps per period of 256 AY clocks: 2 ticks each
+    if (!ay->env_holding) {
+        uint32_t env = ay->regs[11] | ay->regs[12] << 8;
+        if (++ay->env_count >= (env ? env : 1) * 2u) {
+            ay->env_count = 0;
+            env_next(ay);
+        }
+    }
+}
+
+static int32_t ay_output(const ay_chip* ay) {
+    int env = ay->env_attack ? ay->env_step : 15 - ay->env_step;
+    bool noise = ay->noise_lfsr & 1;
+    uint8_t mixer = ay->regs[7];       // Bits 0-2 tone off, 3-5 noise off
+    int32_t out = 0;
+    for (int c = 0; c < 3; c++) {
+        bool on = (ay->tone_out[c] || (mixer >> c & 1)) &&
+                  (noise || (mixer >> (3 + c) & 1));
+        if (on) {
+            uint8_t vol = ay->regs[8 + c];
+            out += ay_level[(vol & 0x10) ? env : (vol & 0x0F)];
+        }
+    }
+    return out;
+}
+
+// --- [ Decimation to the Output Rate ] ---
+static void emit(zx_sound* s, int32_t x) {
+    int32_t y = x - s->dc_in + (int32_t)(((int64_t)s->dc_out * DC_POLE) >> 15);
+    s->dc_in = x;
+    s->dc_out = y;
+    if (y > 32767) y = 32767;
+    if (y < -32768) y = -32768;
+
+    unsigned head = atomic_load_explicit(&s->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&s->tail, memory_order_acquire);
+    if (head - tail == SOUND_RING_SIZE) {     // Nobody is listening fast enough
+        atomic_fetch_add_explicit(&s->dropped, 1, memory_order_relaxed);
+        return;
+    }
+    s->ring[head & (SOUND_RING_SIZE - 1)] = (int16_t)y;
+    atomic_store_explicit(&s->head, head + 1, memory_order_release);
+}
+
+// Box filter: each output sample is the average of the ticks it covers,
+// the ones on its edges weighted by the fraction inside (16.16 fixed point)
+static void push_tick(zx_sound* s, int32_t v) {
+    uint32_t left = s->out_period - s->out_filled;
+    if (left > 0x10000) {
+        s->out_sum += (int64_t)v << 16;
+        s->out_filled += 0x10000;
+        return;
+    }
+    s->out_sum += (int64_t)v * left;
+    emit(s, (int32_t)(s->out_sum / s->out_period));
+    s->out_filled = 0x10000 - left;
+    s->out_sum = (int64_t)v * s->out_filled;
+}
+
+// --- [ Rendering ] ---
+static void apply(zx_sound* s, const sound_event* e) {
+    if (e->kind == SOUND_BEEPER)
+        s->beeper = e->value != 0;
+    else
+        ay_write(&s->ay, e->reg, e->value);
+}
+
+// Steps everything up to "until" (T-states into the frame), then applies
+// the rest of the log: all of it is due before the next tick.
+static void render(zx_sound* s, uint32_t until) {
+    int e = 0;
+    while (s->tick_pos < until) {
+        while (e < s->nlog && s->log[e].tstate <= s->tick_pos)
+            apply(s, &s->log[e++]);
+        ay_tick(&s->ay);
+        push_tick(s, ay_output(&s->ay) + (s->beeper ? BEEPER_LEVEL : 0));
+        s->tick_pos += SOUND_TICK;
+    }
+    while (e < s->nlog)
+        apply(s, &s->log[e++]);
+    s->nlog = 0;
+}
+
+void sound_flush_log(zx_sound* s, uint32_t tstate) {
+    render(s, tstate);
+}
+
+void sound_end_frame(zx_sound* s, uint32_t length) {
+    render(s, length);
+    s->tick_pos -= length;             // The overshoot carries into the next frame
+}
+
+void sound_restart(zx_sound* s) {
+    s->nlog = 0;
+    s->tick_pos = 0;
+}
+
+// --- [ Audio Thread ] ---
+unsigned sound_read(zx_sound* s, int16_t* out, unsigned n) {
+    unsigned tail = atomic_load_explicit(&s->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&s->head, memory_order_acquire);
+    if (n > head - tail)
+        n = head - tail;
+    for (unsigned i = 0; i < n; i++)
+        out[i] = s->ring[(tail + i) & (SOUND_RING_SIZE - 1)];
+    atomic_store_explicit(&s->tail, tail + n, memory_order_release);
+    return n;
+}
@@ -0,0 +1,110 @@
+#ifndef ZX_SOUND_H_
+#define ZX_SOUND_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+// --- [ Sound: Beeper and AY-3-8912 ] ---
+// Nothing is synthesised while the CPU runs. The port handlers only append
+// what changed (beeper level, AY register write) to a log, stamped with the
+// T-state within the frame. At the end of each frame the whole frame is
+// rendered in one pass:
+//
+//   1. The AY and the beeper are stepped at the rate the AY's tone counters
+//      run at (its clock / 8, CPU clock / 16: ~220 kHz), applying logged
+//      writes as their time comes. That is 5x oversampling of 44.1 kHz.
+//   2. The mixed signal goes through a fixed-point box filter that averages
+//      each output sample's exact share of input ticks (fractions included),
+//      then a one-pole DC blocker (the beeper is a 0/1 level).
+//   3. The 16-bit mono samples land in a single-producer/single-consumer
+//      ring that the audio thread drains (sound_read).
+//
+// A full log just renders what it holds early, so busy frames cost no more
+// than quiet ones per event.
+
+#define SOUND_LOG_SIZE   4096          // Events per frame before an early render
+#define SOUND_RING_SIZE  8192          // Output samples (power of two, ~185 ms)
+#define SOUND_TICK       16            // T-states per AY tick (AY clock = CPU/2, /8)
+
+typedef enum sound_event_kind {
+    SOUND_BEEPER,                      // value = speaker level (0/1)
+    SOUND_AY,                          // reg, value = AY register write
+} sound_event_kind;
+
+typedef struct sound_event {
+    uint32_t tstate;                   // T-states since the start of the frame
+    uint8_t  kind;
+    uint8_t  reg;
+    uint8_t  value;
+} sound_event;
+
+// --- [ AY-3-8912 State ] ---
+typedef struct ay_chip {
+    uint8_t  regs[16];
+    uint16_t tone_count[3];
+    bool     tone_out[3];
+    uint16_t noise_count;
+    uint32_t noise_lfsr;               // 17-bit shift register
+    uint32_t env_count;                // Ticks into the current envelope step
+    int      env_step;                 // 0-15 within the current ramp
+    bool     env_attack;               // Ramp direction (up)
+    bool     env_holding;
+} ay_chip;
+
+typedef struct zx_sound {
+    // --- Written by the emulation thread ---
+    sound_event log[SOUND_LOG_SIZE];
+    int         nlog;
+    ay_chip     ay;
+    bool        beeper;                // Beeper level as of "tick_pos"
+
+    uint32_t    tick_pos;              // Next tick, T-states into this frame
+    uint32_t    out_period;            // Input ticks per output sample, 16.16
+    uint32_t    out_filled;            // Share of the current sample summed, 16.16
+    int64_t     out_sum;               // Weighted sum of its ticks
+    int32_t     dc_in, dc_out;         // DC blocker memory
+
+    // --- Shared with the audio thread ---
+    int16_t      ring[SOUND_RING_SIZE];
+    atomic_uint  head;                 // Next sample to write (emulation)
+    atomic_uint  tail;                 // Next sample to read (audio thread)
+    atomic_uint  dropped;              // Samples lost to a full ring
+} zx_sound;
+
+// Prepares output at "rate" Hz for a CPU running "cpu_hz".
+void sound_init(zx_sound* s, uint32_t cpu_hz, uint32_t rate);
+
+// Renders everything logged before "tstate" now (called when the log fills).
+void sound_flush_log(zx_sound* s, uint32_t tstate);
+
+// Logs a change at "tstate" (T-states since the start of the frame).
+static inline void sound_log(zx_sound* s, uint32_t tstate, sound_event_kind kind,
+                             uint8_t reg, uint8_t value) {
+    if (s->nlog == SOUND_LOG_SIZE)
+        sound_flush_log(s, tstate);
+    sound_event* e = &s->log[s->nlog++];
+    e->tstate = tstate;
+    e->kind = (uint8_t)kind;
+    e->reg = reg;
+    e->value = value;
+}
+
+// Renders the rest of a frame that lasted "length" T-states and starts the
+// next one.
+void sound_end_frame(zx_sound* s, uint32_t length);
+
+// Drops what was logged and starts a new frame here (the machine state was
+// replaced, e.g. by rewind). The chip keeps its registers.
+void sound_restart(zx_sound* s);
+
+// Samples rendered but not read yet (either thread; a snapshot)
+static inline unsigned sound_queued(zx_sound* s) {
+    return atomic_load_explicit(&s->head, memory_order_acquire) -
+           atomic_load_explicit(&s->tail, memory_order_acquire);
+}
+
+// Audio thread: copies up to "n" samples out, returns how many there were.
+unsigned sound_read(zx_sound* s, int16_t* out, unsigned n);
+
+#endif // ZX_SOUND_H_
@@ -0,0 +1,535 @@
+// --- [ Standard C Libraries ] ---
+#include <stdio.h>    // File operations (fopen, fread, etc.)
+#include <string.h>   // memset, memcpy
+
+#include "spectrum.h"
+#include "hotspot.h"
+#include "trace.h"
+#include "debug.h"
+#include "sound.h"
+
+const uint32_t zx_palette[16] = {
+    0xFF000000,0xFF0000D7,0xFFD70000,0xFFD700D7,
+    0xFF00D700,0xFF00D7D7,0xFFD7D700,0xFFD7D7D7,
+    0xFF000000,0xFF0000FF,0xFFFF0000,0xFFFF00FF,
+    0xFF00FF00,0xFF00FFFF,0xFFFFFF00,0xFFFFFFFF
+};
+
+// --- [ Memory Read Function for CPU ] ---
+static uint8_t read_byte(void* userdata, uint16_t addr) {
+    zx_spectrum* zx = userdata;
+    return zx->memory[zx->page[addr >> 14] + (addr & (ZX_BANK_SIZE - 1))];
+}
+
+// --- [ Mirrored Bank ] ---
+// On a 128K, bank 5 or 2 can be paged in at 0xC000 as well. Code decoded
+// through one window is then retired here for writes through the other.
+static void forget_mirror(zx_spectrum* zx, uint16_t addr, uint32_t len) {
+    uint32_t end = addr + len < 0x10000 ? addr + len : 0x10000;
+    for (uint32_t a = addr; a < end; a = (a | (ZX_BANK_SIZE - 1)) + 1) {
+        uint32_t stop = (a | (ZX_BANK_SIZE - 1)) + 1;   // End of this window
+        if (stop > end)
+            stop = end;
+        unsigned slot = a >> 14;
+        unsigned other = slot == 3 ? zx->mirror_slot : slot == zx->mirror_slot ? 3 : 0;
+        if (other) {
+            uint16_t start = (uint16_t)(other * ZX_BANK_SIZE + (a & (ZX_BANK_SIZE - 1)));
+            z80_blocks_forget(zx->cpu.blocks, start, stop - a);
+            z80_icache_forget(zx->cpu.icache, start, stop - a);
+        }
+    }
+}
+
+// --- [ Memory Write Function for CPU ] ---
+// The core retires the code decoded at "addr" itself.
+static void write_byte(void* userdata, uint16_t addr, uint8_t val) {
+    zx_spectrum* zx = userdata;
+    if (addr < ZX_ROM_SIZE)  // Protect ROM area from writes
+        return;
+    zx->memory[zx->page[addr >> 14] + (addr & (ZX_BANK_SIZE - 1))] = val;
+    if (zx->mirror_slot)
+        forget_mirror(zx, addr, 1);
+}
+
+// --- [ Watched Memory Access (only installed while watchpoints exist) ] ---
+static uint8_t read_byte_watched(void* userdata, uint16_t addr) {
+    zx_spectrum* zx = userdata;
+    uint8_t val = read_byte(userdata, addr);
+    if (zx->debug->page_flags[addr >> 8] & DBG_WATCH_READ)
+        dbg_access(zx->debug, DBG_WATCH_READ, addr, val);
+    return val;
+}
+
+static void write_byte_watched(void* userdata, uint16_t addr, uint8_t val) {
+    zx_spectrum* zx = userdata;
+    if (zx->debug->page_flags[addr >> 8] & DBG_WATCH_WRITE)
+        dbg_access(zx->debug, DBG_WATCH_WRITE, addr, val);
+    write_byte(userdata, addr, val);
+}
+
+// --- [ Port Decoding ] ---
+// Devices only look at a few address lines, so many ports reach the same
+// device and some reach several. Which ones answer at each of the 65536
+// ports is worked out once per model; the handlers look it up instead of
+// testing bits.
+enum {
+    PORT_ULA       = 0x01,     // A0 = 0: keyboard, beeper, border
+    PORT_PAGING    = 0x02,     // 128K 0x7FFD: A15 = 0, A1 = 0
+    PORT_AY_SELECT = 0x04,     // 128K 0xFFFD: A15 = A14 = 1, A1 = 0
+    PORT_AY_DATA   = 0x08,     // 128K 0xBFFD: A15 = 1, A14 = 0, A1 = 0
+    PORT_KEMPSTON  = 0x10,     // A5 = 0 on an odd port (0x1F)
+};
+
+static uint8_t port_map[ZX_MODEL_128K + 1][65536];
+
+static void build_port_map(void) {
+    static bool built;         // Same for every machine: built by the first one
+    if (built)
+        return;
+    for (uint32_t port = 0; port < 65536; port++) {
+        uint8_t ula = (port & 0x0001) ? 0 : PORT_ULA;
+        if ((port & 0x0021) == 0x0001)
+            ula |= PORT_KEMPSTON;      // An interface, so on both models
+        uint8_t dev = ula;
+        if ((port & 0x0002) == 0) {
+            if ((port & 0xC000) == 0xC000)
+                dev |= PORT_AY_SELECT;
+            else if (port & 0x8000)
+                dev |= PORT_AY_DATA;
+            else
+                dev |= PORT_PAGING;
+        }
+        port_map[ZX_MODEL_48K][port] = ula;
+        port_map[ZX_MODEL_128K][port] = dev;
+    }
+    built = true;
+}
+
+// --- [ Port Input: Keyboard, Joystick and AY Registers ] ---
+static uint8_t port_in(z80* cpu, uint16_t port, unsigned long cyc) {
+    (void)cyc;
+    zx_spectrum* zx = cpu->userdata;
+    uint8_t dev = zx->ports[port];
+    uint8_t res = 0xFF;            // Nothing answering: idle bus
+    if (dev & PORT_ULA)            // Half-rows selected by the high byte
+        res = zx->key_rows[port >> 8];
+    if (dev & PORT_KEMPSTON && zx->kempston_attached)
+        res = zx->kempston;
+    if (dev & PORT_AY_SELECT)      // Reads the selected AY register
+        res = zx->ay_regs[zx->ay_select];
+    if (zx->debug && (zx->debug->port_flags[port & 0xFF] & DBG_WATCH_IN))
+        dbg_access(zx->debug, DBG_WATCH_IN, port, res);
+    return res;
+}
+
+// --- [ Port Output: Control Beeper, AY and 128K Paging ] ---
+// Bits the AY keeps of each register (reads give back no more)
+static const uint8_t ay_mask[16] = {
+    0xFF, 0x0F, 0xFF, 0x0F, 0xFF, 0x0F, 0x1F, 0xFF,
+    0x1F, 0x1F, 0x1F, 0xFF, 0xFF, 0x0F, 0xFF, 0xFF
+};
+
+static void port_out(z80* cpu, uint16_t port, uint8_t val, unsigned long cyc) {
+    zx_spectrum* zx = cpu->userdata;
+    uint8_t dev = zx->ports[port];
+    if (dev & PORT_ULA) {
+        bool on = (val & 0x10) != 0;         // Bit 4 = speaker control
+        if (zx->sound && on != zx->speaker_on)
+            sound_log(zx->sound, cyc - zx->frame_start, SOUND_BEEPER, 0, on);
+        zx->speaker_on = on;
+    }
+    if (dev & PORT_PAGING && !(zx->paging & ZX_PAGING_LOCK))
+        zx_set_paging(zx, val);
+    if (dev & PORT_AY_SELECT)
+        zx->ay_select = val & 0x0F;
+    if (dev & PORT_AY_DATA) {
+        val &= ay_mask[zx->ay_select];
+        zx->ay_regs[zx->ay_select] = val;
+        if (zx->sound)
+            sound_log(zx->sound, cyc - zx->frame_start, SOUND_AY, zx->ay_select, val);
+    }
+    if (zx->debug && (zx->debug->port_flags[port & 0xFF] & DBG_WATCH_OUT))
+        dbg_access(zx->debug, DBG_WATCH_OUT, port, val);
+}
+
+void zx_update_hooks(zx_spectrum* zx) {
+    bool watched = zx->debug && zx->debug->mem_watches;
+    zx->cpu.read_byte = watched ? read_byte_watched : read_byte;
+    zx->cpu.write_byte = watched ? write_byte_watched : write_byte;
+}
+
+// --- [ Memory Paging ] ---
+// Only the page table changes; the caches of decoded code are told which
+// addresses now show different memory.
+static void find_mirror(zx_spectrum* zx) {
+    zx->mirror_slot = zx->page[3] == zx->page[1] ? 1 : zx->page[3] == zx->page[2] ? 2 : 0;
+}
+
+void zx_set_paging(zx_spectrum* zx, uint8_t val) {
+    uint32_t rom = (val & ZX_PAGING_ROM) ? ZX_BANK_SIZE : 0;
+    uint32_t top = zx_bank_offset(val & ZX_PAGING_BANK);
+    zx->paging = val;
+    if (zx->page[0] != rom) {
+        zx->page[0] = rom;
+        z80_blocks_forget(zx->cpu.blocks, 0x0000, ZX_BANK_SIZE);
+        z80_icache_forget(zx->cpu.icache, 0x0000, ZX_BANK_SIZE);
+    }
+    if (zx->page[3] != top) {
+        zx->page[3] = top;
+        find_mirror(zx);
+        z80_blocks_forget(zx->cpu.blocks, 0xC000, ZX_BANK_SIZE);
+        z80_icache_forget(zx->cpu.icache, 0xC000, ZX_BANK_SIZE);
+    }
+}
+
+void zx_code_changed(zx_spectrum* zx, uint16_t addr, uint32_t len) {
+    z80_blocks_forget(zx->cpu.blocks, addr, len);
+    z80_icache_forget(zx->cpu.icache, addr, len);
+    if (zx->mirror_slot)
+        forget_mirror(zx, addr, len);
+}
+
+// --- [ Load ROM File into Memory ] ---
+// Loads the ROM (16 KB, or both 128K ROMs: 32 KB) and clears RAM.
+// In the real ZX Spectrum, RAM starts blank or with random data; we use zeros
+// for simplicity and, above all, so that every run starts identically.
+// (zx_init cleared the whole machine already.)
+static bool load_rom(zx_spectrum* zx, const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        perror(path);  // Print the system error message with the filename
+        return false;
+    }
+
+    size_t size = zx->model == ZX_MODEL_128K ? 2 * ZX_BANK_SIZE : ZX_ROM_SIZE;
+    size_t got = fread(zx->memory, 1, size, f);
+    fclose(f);
+    if (got != size) {
+        fprintf(stderr, "Invalid ROM\n");
+        return false;
+    }
+    return true;
+}
+
+// --- [ Machine Initialisation ] ---
+static void frame_event(void* ctx, unsigned long when);
+
+bool zx_init(zx_spectrum* zx, const char* rom_path) {
+    return zx_init_model(zx, ZX_MODEL_48K, rom_path);
+}
+
+bool zx_init_model(zx_spectrum* zx, zx_model model, const char* rom_path) {
+    memset(zx, 0, sizeof(*zx));
+    zx->model = model;
+    if (!load_rom(zx, rom_path))
+        return false;
+
+    // Power-on mapping, the only one a 48K has: ROM 0, banks 5, 2, 0
+    zx->page[0] = 0;
+    zx->page[1] = zx_bank_offset(5);
+    zx->page[2] = zx_bank_offset(2);
+    zx->page[3] = zx_bank_offset(0);
+    find_mirror(zx);
+    zx->frame_tstates = model == ZX_MODEL_128K ? ZX128_CYCLES_PER_FRAME
+                                               : ZX_CYCLES_PER_FRAME;
+
+    for (int i = 0; i < 8; i++)
+        zx->key_matrix[i] = 0x1F;  // 5 active bits, all set to '1' = unpressed
+    memset(zx->key_rows, 0xFF, sizeof(zx->key_rows));
+
+    z80_init(&zx->cpu);            // Set all CPU registers to their default values
+    zx->cpu.read_byte = read_byte;
+    zx->cpu.write_byte = write_byte;
+    zx->cpu.port_in = port_in;
+    zx->cpu.port_out = port_out;
+    zx->cpu.userdata = zx;         // Callbacks find their machine through this
+    build_port_map();
+    zx->ports = port_map[model];   // Who answers at each port on this model
+    zx->cpu.pc = 0;                // Program counter starts at 0 (beginning of ROM)
+    zx->script_pc = -1;
+
+    sched_init(&zx->sched);        // Timed events: handlers get the machine
+    sched_set_handler(&zx->sched, ZX_EV_FRAME, frame_event);
+    zx_restart_frame(zx);
+    return true;
+}
+
+// --- [ Update a Key's State in the Matrix ] ---
+// Every high byte selects the half-rows whose bit is 0; the result merges
+// them (a pressed key in any selected row reads as 0). Each entry is the
+// entry without its lowest selected row, merged with that row.
+static void rebuild_key_rows(zx_spectrum* zx) {
+    zx->key_rows[0xFF] = 0xFF;     // No row selected; top bits always high
+    for (int sel = 1; sel < 256; sel++) {
+        int row = __builtin_ctz(sel);
+        zx->key_rows[(uint8_t)~sel] =
+            zx->key_rows[(uint8_t)~(sel & (sel - 1))] & (zx->key_matrix[row] | 0xE0);
+    }
+}
+
+void zx_set_key(zx_spectrum* zx, int row, int bit, bool pressed) {
+    if (pressed)
+        zx->key_matrix[row] &= ~(1 << bit); // Clear bit to mark as pressed
+    else
+        zx->key_matrix[row] |= (1 << bit);  // Set bit to mark as released
+    rebuild_key_rows(zx);
+}
+
+void zx_set_key_row(zx_spectrum* zx, int row, uint8_t value) {
+    zx->key_matrix[row] = value;
+    rebuild_key_rows(zx);
+}
+
+// --- [ Frame Timing ] ---
+unsigned long zx_frame_tstate(const zx_spectrum* zx) {
+    return zx->cpu.cyc - zx->frame_start;
+}
+
+// --- [ Timed Events ] ---
+// The end of each frame is an event on the scheduler (sched.h): the run
+// loop below only ever compares cyc against the next deadline, and the
+// interrupt, frame count and FLASH phase are all handled here when it
+// comes due. Handlers run at the first instruction boundary at or after
+// their time, so "when" can be a few T-states in the past.
+static void frame_event(void* ctx, unsigned long when) {
+    (void)when;
+    zx_spectrum* zx = ctx;
+    z80_gen_int(&zx->cpu, 0);  // Interrupt after each frame (Spectrum design)
+
+    if (zx->sound)             // Render the frame's sound in one go
+        sound_end_frame(zx->sound, zx->cpu.cyc - zx->frame_start);
+
+    zx->frame++;
+    zx->frame_start = zx->cpu.cyc;  // The overshoot carries into the next frame
+    sched_at(&zx->sched, ZX_EV_FRAME, zx->frame_start + zx->frame_tstates);
+
+    // --- [ Flash effect (for blinking colors) ] ---
+    if (++zx->flash_counter >= 16) { // Every 16 frames
+        zx->flash_counter = 0;
+        zx->flash_state = !zx->flash_state;  // Toggle flash ON/OFF
+    }
+}
+
+void zx_restart_frame(zx_spectrum* zx) {
+    if (zx->sound)
+        sound_restart(zx->sound);
+    zx->frame_start = zx->cpu.cyc;
+    sched_at(&zx->sched, ZX_EV_FRAME, zx->frame_start + zx->frame_tstates);
+}
+
+// The plain loop in zx_run_until is the fast path. Tracing, profiling and
+// debugging get their own loop, so they cost nothing while switched off.
+static bool run_each(zx_spectrum* zx, unsigned long until) {
+    trace_ring* trace = zx->trace;
+    hotspot_profile* hotspots = zx->hotspots;
+    zx_debugger* debug = zx->debug;
+    while (sched_before(zx->cpu.cyc, until)) {
+        if (zx->cpu.pc == zx->script_pc) {
+            // The script waits for this PC: its event is due now, before
+            // the instruction runs
+            zx->script_pc = -1;
+            sched_at(&zx->sched, ZX_EV_SCRIPT, zx->cpu.cyc);
+            return true;
+        }
+        if (debug) {
+            uint16_t pc = zx->cpu.pc;
+            if (debug->nbreaks && !zx->cpu.halted && dbg_break_at(debug, pc) &&
+                !debug->skip_break) {
+                debug->stop = DBG_STOP_BREAK;
+                debug->stop_pc = pc;
+                return false;
+            }
+            if (dbg_take_request(debug, pc))
+                return false;
+            debug->skip_break = false;
+            debug->insn_pc = pc;
+        }
+        if (trace)
+            trace_record(trace, &zx->cpu, zx->memory, zx->page);
+        if (hotspots)
+            hotspot_step(hotspots, zx);
+        else
+            z80_step(&zx->cpu);
+        if (debug) {
+            if (debug->step) {         // Single step: this was the one
+                debug->step = false;
+                if (debug->stop == DBG_STOP_NONE) {
+                    debug->stop = DBG_STOP_STEP;
+                    debug->stop_pc = debug->insn_pc;
+                }
+            }
+            if (debug->stop != DBG_STOP_NONE)
+                return false;   // A watchpoint fired during this instruction
+        }
+    }
+    return true;
+}
+
+static bool run_instrumented(zx_spectrum* zx, unsigned long until) {
+    z80_icache* icache = zx->cpu.icache;
+    if (!icache || !zx->debug || !zx->debug->mem_watches)
+        return run_each(zx, until);
+
+    // Memory watchpoints must see opcode fetches too, which the decode
+    // cache skips: it is set aside, then dropped (writes went unseen)
+    zx->cpu.icache = NULL;
+    bool ok = run_each(zx, until);
+    zx->cpu.icache = icache;
+    z80_icache_flush(icache);
+    return ok;
+}
+
+bool zx_run_until(zx_spectrum* zx, unsigned long tstate) {
+    zx_debugger* debug = zx->debug;
+    bool instrumented = false;
+    unsigned long target = zx->frame_start + tstate;
+    for (;;) {
+        // Event handlers may change this (a script starting to wait for a PC)
+        instrumented = zx->hotspots || zx->trace || zx->script_pc >= 0 ||
+                       (debug && dbg_per_instruction(debug));
+        // Run straight to the next event or the target, whichever is first
+        unsigned long until = sched_next(&zx->sched, target);
+        if (instrumented) {
+            if (!run_instrumented(zx, until))
+                return false;
+        } else {
+            z80_run(&zx->cpu, until);  // Same stop as stepping while cyc < until
+        }
+        if (!sched_before(zx->cpu.cyc, target))
+            break;
+        sched_dispatch(&zx->sched, zx->cpu.cyc, zx);
+    }
+    // Nothing to check per instruction: a stop request waits until here,
+    // before the events due now (so a stop at the end of a frame comes
+    // before its interrupt, as it would in the instrumented loop)
+    if (debug && !instrumented && dbg_take_request(debug, zx->cpu.pc))
+        return false;
+    sched_dispatch(&zx->sched, zx->cpu.cyc, zx);
+    return true;
+}
+
+bool zx_end_frame(zx_spectrum* zx) {
+    // The frame event is due exactly at the end of the frame, so it has
+    // run (interrupt raised, next frame started) by the time this returns
+    return zx_run_until(zx, zx->frame_tstates);
+}
+
+bool zx_run_frame(zx_spectrum* zx) {
+    return zx_end_frame(zx);
+}
+
+// --- [ Video Rendering: Screen Memory to 4-bit Framebuffer ] ---
+// Each bitmap byte holds 8 pixels; its 8x8 cell shares one attribute byte:
+//   bits 0-2 = INK, bits 3-5 = PAPER, bit 6 = BRIGHT, bit 7 = FLASH.
+// Instead of deciding pixel by pixel, the byte is expanded into a 32-bit mask
+// with one nibble per pixel (0xF = ink, 0x0 = paper), and the 8 pixels are
+// produced in one go: (ink & mask) | (paper & ~mask).
+static const uint16_t expand_nibble[16] = {  // 4 pixel bits -> 4 nibble masks
+    0x0000, 0x000F, 0x00F0, 0x00FF, 0x0F00, 0x0F0F, 0x0FF0, 0x0FFF,
+    0xF000, 0xF00F, 0xF0F0, 0xF0FF, 0xFF00, 0xFF0F, 0xFFF0, 0xFFFF
+};
+
+void zx_render_screen(const uint8_t* screen, bool flash_state, uint8_t* fb) {
+    for (int y = 0; y < ZX_SCREEN_H; y++) {  // For each line on the screen
+
+        // --- [ Calculate Spectrum's weird screen memory address for this y ] ---
+        int y0 = (y & 0xC0) << 5      // Top 2 bits of Y (bits 6–7) shifted to 11–12
+               | (y & 0x07) << 8       // Bottom 3 bits of Y (bits 0–2) shifted to 8–10
+               | (y & 0x38) << 2;      // Middle 3 bits of Y (bits 3–5) shifted to 5–7
+        // ⚡ Explanation:
+        // ZX Spectrum has a strange screen layout:
+        //   - 0x4000..0x57FF stores the pixel data (bitmap)
+        //   - 192 lines are divided into 3 zones (64 lines each)
+        //   - Each 8-pixel block is stored non-linearly (this formula computes that)
+
+        const uint8_t* bitmap = screen + y0;
+        const uint8_t* attrs = screen + 6144 + (y / 8) * 32; // 1 attribute per 8x8 block
+        uint8_t* out = fb + y * (ZX_SCREEN_W / 2);
+
+        for (int cx = 0; cx < 32; cx++) {  // For each 8-pixel block in the line
+            uint8_t A = attrs[cx];
+            uint32_t ink = A & 0x07;            // Bits 0–2 = ink (foreground color)
+            uint32_t pap = (A >> 3) & 0x07;     // Bits 3–5 = paper (background color)
+
+            // --- [ Handle FLASH attribute (color swap) ] ---
+            if ((A & 0x80) && flash_state) {
+                uint32_t t = ink;
+                ink = pap;
+                pap = t;
+            }
+            // Add 8 if bright is enabled (palette has bright colors at index 8+)
+            if (A & 0x40) {
+                ink += 8;
+                pap += 8;
+            }
+
+            uint8_t bits = bitmap[cx];  // Leftmost pixel = bit 7 = top nibble
+            uint32_t mask = (uint32_t)expand_nibble[bits >> 4] << 16 | expand_nibble[bits & 15];
+            uint32_t px = ((ink * 0x11111111u) & mask) | ((pap * 0x11111111u) & ~mask);
+            out[0] = (uint8_t)(px >> 24);
+            out[1] = (uint8_t)(px >> 16);
+            out[2] = (uint8_t)(px >> 8);
+            out[3] = (uint8_t)px;
+            out += 4;
+        }
+    }
+}
+
+void zx_render(const zx_spectrum* zx, uint8_t* fb) {
+    zx_render_screen(zx_screen(zx), zx->flash_state, fb);
+}
+
+// --- [ Presentation: 4-bit Framebuffer to ARGB ] ---
+// One byte = two pixels, so a 256-entry table of colour pairs converts it
+// with a single lookup.
+void zx_framebuf_to_argb(const uint8_t* fb, uint32_t* argb, const uint32_t palette[16]) {
+    uint32_t pairs[256][2];
+    for (int i = 0; i < 256; i++) {
+        pairs[i][0] = palette[i >> 4];
+        pairs[i][1] = palette[i & 15];
+    }
+    for (int i = 0; i < ZX_FRAMEBUF_BYTES; i++) {
+        argb[2 * i] = pairs[fb[i]][0];
+        argb[2 * i + 1] = pairs[fb[i]][1];
+    }
+}
+
+// --- [ State Checksum ] ---
+// A 64-bit multiply/xor hash over RAM (8 bytes per step) folded to 32 bits,
+// followed by every register. Cheap enough to run every few frames.
+static uint64_t mix(uint64_t h, uint64_t v) {
+    h ^= v;
+    h *= 0x100000001B3ull;   // FNV-1a 64-bit prime
+    return h ^ (h >> 29);
+}
+
+uint32_t zx_state_checksum(const zx_spectrum* zx) {
+    uint64_t h = 0xCBF29CE484222325ull;  // FNV-1a 64-bit offset basis
+    size_t ram_size = zx_ram_size(zx);
+    for (size_t i = 0; i < ram_size; i += 8) {
+        uint64_t w;
+        memcpy(&w, zx->memory + ZX_RAM_OFFSET + i, 8);
+        h = mix(h, w);
+    }
+    if (zx->model == ZX_MODEL_128K)
+        h = mix(h, zx->paging);
+
+    const z80* c = &zx->cpu;
+    h = mix(h, (uint64_t)c->pc | (uint64_t)c->sp << 16 |
+               (uint64_t)c->ix << 32 | (uint64_t)c->iy << 48);
+    h = mix(h, (uint64_t)c->a | (uint64_t)c->b << 8 | (uint64_t)c->c << 16 |
+               (uint64_t)c->d << 24 | (uint64_t)c->e << 32 |
+               (uint64_t)c->h << 40 | (uint64_t)c->l << 48 |
+               (uint64_t)c->i << 56);
+    h = mix(h, (uint64_t)c->a_ | (uint64_t)c->b_ << 8 | (uint64_t)c->c_ << 16 |
+               (uint64_t)c->d_ << 24 | (uint64_t)c->e_ << 32 |
+               (uint64_t)c->h_ << 40 | (uint64_t)c->l_ << 48 |
+               (uint64_t)c->f_ << 56);
+    h = mix(h, (uint64_t)c->sf << 7 | (uint64_t)c->zf << 6 |
+               (uint64_t)c->yf << 5 | (uint64_t)c->hf << 4 |
+               (uint64_t)c->xf << 3 | (uint64_t)c->pf << 2 |
+               (uint64_t)c->nf << 1 | (uint64_t)c->cf |
+               (uint64_t)c->r << 8 | (uint64_t)c->mem_ptr << 16 |
+               (uint64_t)(c->cyc - zx->frame_start) << 32);
+    return (uint32_t)(h ^ (h >> 32));
+}
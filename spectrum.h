@@ -0,0 +1,207 @@
+#ifndef ZX_SPECTRUM_H_
+#define ZX_SPECTRUM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "z80.h"
+#include "sched.h"
+
+// --- [ Constants for the ZX Spectrum 48K System ] ---
+#define ZX_ROM_SIZE          0x4000              // 16KB ROM size (16384 bytes)
+#define ZX_RAM_SIZE          (65536 - ZX_ROM_SIZE) // 48KB RAM above the ROM
+#define ZX_SCREEN_W          256                 // Screen width in pixels
+#define ZX_SCREEN_H          192                 // Screen height in pixels
+#define ZX_CYCLES_PER_FRAME  (3500000/50)        // 3.5 MHz CPU, 50 frames per second
+#define ZX_FRAMES_PER_SECOND 50                  // PAL refresh rate
+
+// --- [ ZX Spectrum 128K ] ---
+#define ZX_BANK_SIZE         0x4000              // Memory is mapped in 16KB banks
+#define ZX_RAM_BANKS         8                   // 128KB RAM: banks 0-7
+#define ZX128_RAM_SIZE       (ZX_RAM_BANKS * ZX_BANK_SIZE)
+#define ZX_RAM_OFFSET        (2 * ZX_BANK_SIZE)  // RAM follows both ROMs in "memory"
+#define ZX_MEMORY_SIZE       (ZX_RAM_OFFSET + ZX128_RAM_SIZE)
+#define ZX128_CYCLES_PER_FRAME (228 * 311)       // 70908: longer lines, more of them
+
+// Port 0x7FFD (write only, decoded on A15 = A1 = 0)
+#define ZX_PAGING_BANK       0x07                // RAM bank at 0xC000
+#define ZX_PAGING_SCREEN     0x08                // Show bank 7 instead of bank 5
+#define ZX_PAGING_ROM        0x10                // ROM 1 (48 BASIC) instead of ROM 0
+#define ZX_PAGING_LOCK       0x20                // Ignore further writes until reset
+
+typedef enum zx_model {
+    ZX_MODEL_48K,
+    ZX_MODEL_128K,
+} zx_model;
+
+// --- [ Video Memory and Framebuffer Format ] ---
+#define ZX_SCREEN_ADDR       0x4000              // Bitmap (6144 bytes) then attributes
+#define ZX_SCREEN_BYTES      6912                // Bitmap + 768 attribute bytes
+#define ZX_FRAMEBUF_BYTES    (ZX_SCREEN_W * ZX_SCREEN_H / 2) // 4 bits per pixel (24 KB)
+
+// The Spectrum only ever shows 16 colours, so the internal framebuffer holds
+// one palette index (0-15) per pixel, two pixels per byte: the left pixel in
+// the high nibble. That is 24 KB instead of 192 KB of ARGB, small enough to
+// stay in L2 cache, and two frames can be compared with a plain memcmp.
+// Conversion to ARGB only happens at presentation time (zx_framebuf_to_argb).
+
+// Palette in ARGB8888: first 8 entries = normal colors; next 8 = bright versions
+extern const uint32_t zx_palette[16];
+
+// --- [ Timed Events ] ---
+// Scheduler event ids (sched.h); each has at most one occurrence pending.
+enum zx_event {
+    ZX_EV_FRAME,                 // End of frame: interrupt, next frame, FLASH
+    ZX_EV_SCRIPT,                // Next step of an input script (script.h)
+    ZX_EV_COUNT
+};
+
+// --- [ Emulated Machine ] ---
+// Everything that makes up one Spectrum lives in this struct, so a front end
+// (SDL window, headless runner, benchmark) can own as many as it wants.
+// None of this code depends on SDL.
+//
+// The CPU sees memory through a table of four 16KB pages, so switching
+// banks changes one entry, never copies memory. The entries are offsets
+// rather than pointers so that a machine copied by value still works.
+//
+// "memory" holds ROM 0 (128K menu/editor; the 48K ROM), ROM 1 (48 BASIC),
+// then the RAM banks in the order 5, 2, 0, 1, 3, 4, 6, 7: the first 48KB of
+// RAM is exactly what appears at 0x4000-0xFFFF in a 48K (or a freshly
+// reset 128K), and a 48K simply never maps the other banks.
+typedef struct zx_spectrum {
+    z80 cpu;                     // Z80 CPU state (userdata points back here)
+    zx_model model;
+    uint32_t page[4];            // Offsets in "memory" of 0x0000, 0x4000, 0x8000, 0xC000
+    uint8_t mirror_slot;         // 1 or 2: page[3] shows that slot's bank too (128K), else 0
+    uint8_t memory[ZX_MEMORY_SIZE]; // ROMs, then RAM banks (see above)
+    uint8_t paging;              // Last value written to port 0x7FFD (128K)
+    const uint8_t* ports;        // Devices answering at each 16-bit port (shared table)
+    unsigned long frame_tstates; // Frame length for this model
+    uint8_t key_matrix[8];       // Keyboard half-rows (bit = 0 means pressed)
+    uint8_t key_rows[256];       // IN 0xFE result for each high byte (see zx_set_key)
+    uint8_t kempston;            // Kempston joystick bits (1 = pressed): R, L, D, U, fire
+    bool kempston_attached;      // Port 0x1F answers (otherwise it reads 0xFF)
+
+    uint32_t frame;              // Number of completed frames
+    unsigned long frame_start;   // cpu.cyc when the current frame began
+    zx_scheduler sched;          // Timed events, keyed on cpu.cyc
+
+    int  flash_counter;          // Frames since the last FLASH toggle
+    bool flash_state;            // Current FLASH phase (true = swapped)
+    bool speaker_on;             // Beeper bit (bit 4 of the last OUT to 0xFE)
+    uint8_t ay_regs[16];         // AY-3-8912 registers as the CPU reads them (128K)
+    uint8_t ay_select;           // Register selected through port 0xFFFD
+
+
+    struct hotspot_profile* hotspots; // Guest profiler, NULL = off (hotspot.h)
+    struct trace_ring* trace;         // Execution trace, NULL = off (trace.h)
+    struct zx_debugger* debug;        // Breakpoints/watchpoints, NULL = off (debug.h)
+    struct zx_sound* sound;           // Beeper/AY renderer, NULL = silent (sound.h)
+    struct zx_script* script;         // Scripted input, NULL = none (script.h)
+    int32_t script_pc;                // Reaching this PC fires ZX_EV_SCRIPT (-1 = none)
+} zx_spectrum;
+
+// Loads the ROM and resets the machine. Returns false if the ROM is unusable.
+bool zx_init(zx_spectrum* zx, const char* rom_path);
+
+// Same for a given model. The 128K ROM file holds both ROMs (32KB).
+bool zx_init_model(zx_spectrum* zx, zx_model model, const char* rom_path);
+
+// --- [ Memory Access for Tools ] ---
+// Where RAM bank "n" (0-7) is stored in "memory"
+static inline uint32_t zx_bank_offset(int n) {
+    static const uint8_t slot[ZX_RAM_BANKS] = {2, 3, 1, 4, 5, 0, 6, 7};
+    return ZX_RAM_OFFSET + slot[n] * ZX_BANK_SIZE;
+}
+
+// All of the model's RAM, banks in storage order (rewind, checksums)
+static inline uint8_t* zx_ram(zx_spectrum* zx) {
+    return zx->memory + ZX_RAM_OFFSET;
+}
+
+static inline size_t zx_ram_size(const zx_spectrum* zx) {
+    return zx->model == ZX_MODEL_128K ? ZX128_RAM_SIZE : ZX_RAM_SIZE;
+}
+
+// The byte the CPU sees at "addr"
+static inline uint8_t zx_peek(const zx_spectrum* zx, uint16_t addr) {
+    return zx->memory[zx->page[addr >> 14] + (addr & (ZX_BANK_SIZE - 1))];
+}
+
+// Writes the byte the CPU sees at "addr", ROM included (debuggers,
+// loaders). Code caches are not told: see zx_code_changed.
+static inline void zx_poke(zx_spectrum* zx, uint16_t addr, uint8_t val) {
+    zx->memory[zx->page[addr >> 14] + (addr & (ZX_BANK_SIZE - 1))] = val;
+}
+
+// The screen being displayed: bank 5, or bank 7 on a 128K that selected it
+static inline const uint8_t* zx_screen(const zx_spectrum* zx) {
+    return zx->memory + zx_bank_offset((zx->paging & ZX_PAGING_SCREEN) ? 7 : 5);
+}
+
+// Maps memory as a write of "val" to port 0x7FFD would (the lock bit
+// included). Also used to restore the paging of a saved state.
+void zx_set_paging(zx_spectrum* zx, uint8_t val);
+
+// Memory at [addr, addr + len) was changed behind the CPU's back: retires
+// the code decoded from it, at these addresses and wherever else the same
+// bank is paged in (bank 5 or 2 can also be at 0xC000 on a 128K).
+void zx_code_changed(zx_spectrum* zx, uint16_t addr, uint32_t len);
+
+// Presses or releases the key at (row, bit) of the keyboard matrix.
+// Keyboard reads are one lookup in key_rows, which is rebuilt here: keys
+// change a few times a second, the ROM scans the keyboard 400 times.
+void zx_set_key(zx_spectrum* zx, int row, int bit, bool pressed);
+
+// Sets a whole half-row at once (bit = 0 means pressed), e.g. from a movie.
+void zx_set_key_row(zx_spectrum* zx, int row, uint8_t value);
+
+// Kempston joystick state (ZX_KEMPSTON_* bits, 1 = pressed)
+#define ZX_KEMPSTON_RIGHT 0x01
+#define ZX_KEMPSTON_LEFT  0x02
+#define ZX_KEMPSTON_DOWN  0x04
+#define ZX_KEMPSTON_UP    0x08
+#define ZX_KEMPSTON_FIRE  0x10
+
+// T-states elapsed since the start of the current frame.
+unsigned long zx_frame_tstate(const zx_spectrum* zx);
+
+// Starts a new frame at the current T-state, e.g. after the CPU state was
+// restored from elsewhere (rewind): re-arms the end-of-frame event.
+void zx_restart_frame(zx_spectrum* zx);
+
+// Runs the CPU until "tstate" T-states into the current frame, calling
+// the handlers of timed events as they come due. Returns false if the
+// debugger stopped it first (see debug.h); calling it again resumes from
+// where it stopped.
+bool zx_run_until(zx_spectrum* zx, unsigned long tstate);
+
+// Finishes the current frame: runs to the frame length, raises the
+// 50 Hz interrupt and starts the next frame. Returns false (frame not
+// finished) if the debugger stopped the machine.
+bool zx_end_frame(zx_spectrum* zx);
+
+// Runs the rest of the current frame (zx_end_frame).
+bool zx_run_frame(zx_spectrum* zx);
+
+// Picks the memory callbacks: checked ones while the attached debugger
+// has memory watchpoints, the plain ones otherwise.
+void zx_update_hooks(zx_spectrum* zx);
+
+// Draws a screen image (ZX_SCREEN_BYTES laid out like video memory) into a
+// 4-bit indexed framebuffer of ZX_FRAMEBUF_BYTES.
+void zx_render_screen(const uint8_t* screen, bool flash_state, uint8_t* fb);
+
+// Draws the machine's current screen into a 4-bit indexed framebuffer.
+void zx_render(const zx_spectrum* zx, uint8_t* fb);
+
+// Expands a 4-bit indexed framebuffer to ARGB8888 (ZX_SCREEN_W * ZX_SCREEN_H pixels).
+void zx_framebuf_to_argb(const uint8_t* fb, uint32_t* argb, const uint32_t palette[16]);
+
+// Checksum of RAM (all banks on a 128K, with the paging) and CPU registers,
+// used to detect divergence between runs.
+uint32_t zx_state_checksum(const zx_spectrum* zx);
+
+#endif // ZX_SPECTRUM_H_
@@ -0,0 +1,75 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+
+bool trace_init(trace_ring* tr, uint32_t capacity) {
+    memset(tr, 0, sizeof(*tr));
+    uint32_t n = 1;
+    while (n < capacity && n < 0x80000000u)
+        n <<= 1;
+    tr->recs = malloc((size_t)n * sizeof(trace_rec));
+    if (!tr->recs)
+        return false;
+    tr->mask = n - 1;
+    return true;
+}
+
+static bool write_header(FILE* f, uint64_t first) {
+    uint8_t h[16] = {'Z', 'X', 'T', 'R', TRACE_VERSION, sizeof(trace_rec), 0, 0};
+    memcpy(h + 8, &first, 8);
+    return fwrite(h, 1, sizeof(h), f) == sizeof(h);
+}
+
+bool trace_stream(trace_ring* tr, const char* path) {
+    tr->stream = fopen(path, "wb");
+    tr->path = path;
+    if (!tr->stream || !write_header(tr->stream, tr->total)) {
+        perror(path);
+        return false;
+    }
+    return true;
+}
+
+// Called exactly when the ring has just filled up: it is written in one block
+void trace_flush(trace_ring* tr) {
+    size_t n = (size_t)tr->mask + 1;
+    if (fwrite(tr->recs, sizeof(trace_rec), n, tr->stream) != n)
+        tr->write_error = true;
+}
+
+bool trace_save(const trace_ring* tr, const char* path) {
+    FILE* f = fopen(path, "wb");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    uint64_t cap = (uint64_t)tr->mask + 1;
+    uint64_t n = tr->total < cap ? tr->total : cap;
+    uint64_t first = tr->total - n;
+    uint32_t start = (uint32_t)(first & tr->mask);
+    uint32_t tail = (uint32_t)(n < cap - start ? n : cap - start);  // Up to the end of the ring
+
+    bool ok = write_header(f, first) &&
+              fwrite(tr->recs + start, sizeof(trace_rec), tail, f) == tail &&
+              fwrite(tr->recs, sizeof(trace_rec), n - tail, f) == n - tail;
+    ok = fclose(f) == 0 && ok;
+    if (!ok)
+        fprintf(stderr, "%s: write error\n", path);
+    return ok;
+}
+
+bool trace_close(trace_ring* tr) {
+    bool ok = true;
+    if (tr->stream) {
+        size_t n = tr->total & tr->mask;
+        ok = !tr->write_error && fwrite(tr->recs, sizeof(trace_rec), n, tr->stream) == n;
+        ok = fclose(tr->stream) == 0 && ok;
+        if (!ok)
+            fprintf(stderr, "%s: write error\n", tr->path);
+        tr->stream = NULL;
+    }
+    free(tr->recs);
+    tr->recs = NULL;
+    return ok;
+}
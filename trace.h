@@ -0,0 +1,103 @@
+#ifndef ZX_TRACE_H_
+#define ZX_TRACE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "z80.h"
+
+// --- [ Binary Execution Trace ] ---
+// Records the CPU state before every instruction as a fixed 32-byte record,
+// with no formatting at all while the emulator runs. Turning records into
+// text (and comparing two traces) is done offline by zxtrace.
+//
+// The records go into a ring buffer owned by the machine (zx->trace):
+//
+//   - flight recorder: the ring keeps the last N instructions, written out
+//     with trace_save() when needed (after a crash, at a breakpoint...)
+//   - streaming: whenever the ring fills up it is written to a file in one
+//     block, so the file holds every instruction executed
+//
+// File layout: "ZXTR" <version u8> <record size u8> <reserved u16>
+//              <index of the first record u64>  record*
+// Records are stored in host byte order (little-endian on every platform
+// the emulator is built for).
+
+#define TRACE_VERSION 1
+
+typedef struct trace_rec {
+    uint64_t cyc;                        // T-state counter before the instruction
+    uint16_t pc, sp, af, bc, de, hl, ix, iy;
+    uint8_t  op[4];                      // Bytes at PC (the instruction and what follows)
+    uint8_t  i, r;
+    uint8_t  flags;                      // TRACE_IFF1 | TRACE_IFF2 | TRACE_HALT | IM << 3
+    uint8_t  pad;
+} trace_rec;
+
+#define TRACE_IFF1   0x01
+#define TRACE_IFF2   0x02
+#define TRACE_HALT   0x04
+#define TRACE_IM(f)  (((f) >> 3) & 3)
+
+typedef struct trace_ring {
+    trace_rec* recs;
+    uint32_t   mask;                     // Capacity - 1 (capacity is a power of two)
+    uint64_t   total;                    // Records written since trace_init
+    FILE*      stream;                   // Streaming mode: every full ring goes here
+    const char* path;                    // ...named this (for error messages)
+    bool       write_error;              // A write to "stream" fell short
+} trace_ring;
+
+// Allocates a ring of at least "capacity" records (rounded up to a power of two).
+bool trace_init(trace_ring* tr, uint32_t capacity);
+
+// Switches to streaming mode: the whole trace is written to "path", which
+// must stay valid until trace_close.
+bool trace_stream(trace_ring* tr, const char* path);
+
+// Streaming mode: writes the full ring to the file (called by trace_record).
+void trace_flush(trace_ring* tr);
+
+// Records the state of "cpu" before it executes the instruction at PC.
+// The opcode bytes are read from "mem" through "page": the offset in "mem"
+// of each 16 KB of the address space (zx_spectrum.page).
+static inline void trace_record(trace_ring* tr, const z80* cpu, const uint8_t* mem,
+                                const uint32_t page[4]) {
+    trace_rec* t = &tr->recs[tr->total & tr->mask];
+    uint16_t pc = cpu->pc;
+    t->cyc = cpu->cyc;
+    t->pc = pc;
+    t->sp = cpu->sp;
+    t->af = cpu->a << 8 | cpu->sf << 7 | cpu->zf << 6 | cpu->yf << 5 | cpu->hf << 4 |
+            cpu->xf << 3 | cpu->pf << 2 | cpu->nf << 1 | cpu->cf;
+    t->bc = cpu->b << 8 | cpu->c;
+    t->de = cpu->d << 8 | cpu->e;
+    t->hl = cpu->h << 8 | cpu->l;
+    t->ix = cpu->ix;
+    t->iy = cpu->iy;
+    if ((pc & 0x3FFF) <= 0x3FFC) {
+        memcpy(t->op, mem + page[pc >> 14] + (pc & 0x3FFF), 4);
+    } else {                             // Runs into the next page (or 0000h)
+        for (int k = 0; k < 4; k++) {
+            uint16_t a = (uint16_t)(pc + k);
+            t->op[k] = mem[page[a >> 14] + (a & 0x3FFF)];
+        }
+    }
+    t->i = cpu->i;
+    t->r = cpu->r;
+    t->flags = cpu->iff1 | cpu->iff2 << 1 | cpu->halted << 2 | (cpu->interrupt_mode & 3) << 3;
+    t->pad = 0;
+    if ((++tr->total & tr->mask) == 0 && tr->stream)
+        trace_flush(tr);
+}
+
+// Flight recorder: writes the records still in the ring, oldest first.
+bool trace_save(const trace_ring* tr, const char* path);
+
+// Writes out what is left in streaming mode and frees the ring. Returns false
+// (after reporting it) if any part of the streamed trace failed to write.
+bool trace_close(trace_ring* tr);
+
+#endif // ZX_TRACE_H_
@@ -0,0 +1,202 @@
+#define _POSIX_C_SOURCE 200809L  // nanosleep under -std=c11
+
+#include <stdlib.h>   // malloc, free
+#include <string.h>   // memcpy, memcmp, strlen
+#include <time.h>     // nanosleep
+
+#include "video.h"
+#include "delta.h"
+
+// --- [ Screen Layout Helpers ] ---
+// Offset of pixel line "y" inside the 6144-byte bitmap: the Spectrum's
+// interleaved layout (thirds, then character row, then pixel row).
+static int line_offset(int y) {
+    return (y & 0xC0) << 5 | (y & 0x07) << 8 | (y & 0x38) << 2;
+}
+
+// --- [ Encoders (background thread only) ] ---
+static void put_varint(FILE* f, uint32_t v) {
+    while (v >= 0x80) {
+        fputc((int)(v | 0x80) & 0xFF, f);
+        v >>= 7;
+    }
+    fputc((int)v, f);
+}
+
+// Writes the current screen as one raw Y4M frame (4:4:4, BT.601 limited range)
+static void write_y4m_frame(video_recorder* vr, const uint8_t* screen, bool flash) {
+    const int n = ZX_SCREEN_W * ZX_SCREEN_H;
+    uint8_t* fb = vr->buf;                       // 4-bit indexed image
+    uint8_t* planes = vr->buf + ZX_FRAMEBUF_BYTES;
+    zx_render_screen(screen, flash, fb);
+    for (int p = 0; p < 3; p++)
+        for (int i = 0; i < n; i++)
+            planes[p * n + i] = vr->ycc[(fb[i / 2] >> (i & 1 ? 0 : 4)) & 15][p];
+
+    fputs("FRAME\n", vr->f);
+    fwrite(planes, 1, 3 * (size_t)n, vr->f);
+}
+
+// Writes one ZXV frame: XOR/RLE delta against the previously written screen.
+// Frame numbers must only grow (the SDL front end disables rewind to capture).
+static void write_zxv_frame(video_recorder* vr, uint32_t frame, bool flash) {
+    size_t size = delta_encode(vr->screen, vr->written, ZX_SCREEN_BYTES,
+                               vr->buf, DELTA_MAX_SIZE(ZX_SCREEN_BYTES));
+    put_varint(vr->f, frame - vr->written_frame);
+    fputc(flash, vr->f);
+    put_varint(vr->f, (uint32_t)size);
+    fwrite(vr->buf, 1, size, vr->f);
+}
+
+static void encode_slot(video_recorder* vr, const video_slot* s) {
+    // --- [ Rebuild the full screen from the changed cells ] ---
+    for (int i = 0; i < s->count; i++) {
+        const video_cell* c = &s->cells[i];
+        int row = c->index / 32, col = c->index % 32;
+        for (int k = 0; k < 8; k++)
+            vr->screen[line_offset(row * 8 + k) + col] = c->bitmap[k];
+        vr->screen[6144 + c->index] = c->attr;
+    }
+
+    if (vr->y4m) {
+        // Keep the 50 fps timeline: repeat the previous image over dropped frames
+        if (vr->frames_written > 0)
+            for (uint32_t f = vr->written_frame + 1; f < s->frame; f++)
+                write_y4m_frame(vr, vr->written, vr->written_flash);
+        write_y4m_frame(vr, vr->screen, s->flash_state);
+    } else {
+        write_zxv_frame(vr, s->frame, s->flash_state);
+    }
+
+    memcpy(vr->written, vr->screen, ZX_SCREEN_BYTES);
+    vr->written_flash = s->flash_state;
+    vr->written_frame = s->frame;
+    vr->frames_written++;
+}
+
+static void* encoder_thread(void* arg) {
+    video_recorder* vr = arg;
+    for (;;) {
+        unsigned head = atomic_load_explicit(&vr->head, memory_order_relaxed);
+        unsigned tail = atomic_load_explicit(&vr->tail, memory_order_acquire);
+
+        if (head == tail) {
+            if (atomic_load(&vr->done))
+                break;   // Producer has finished and the ring is empty
+            struct timespec ts = {0, 2000000};  // Idle: sleep 2 ms
+            nanosleep(&ts, NULL);
+            continue;
+        }
+
+        encode_slot(vr, &vr->slots[head % VIDEO_QUEUE_SLOTS]);
+        atomic_store_explicit(&vr->head, head + 1, memory_order_release);
+    }
+    return NULL;
+}
+
+// --- [ Public Interface ] ---
+bool video_open(video_recorder* vr, const char* path) {
+    memset(vr, 0, sizeof(*vr));
+    size_t len = strlen(path);
+    vr->y4m = len >= 4 && strcmp(path + len - 4, ".y4m") == 0;
+
+    vr->slots = malloc(VIDEO_QUEUE_SLOTS * sizeof(video_slot));
+    vr->buf = malloc(4 * ZX_SCREEN_W * ZX_SCREEN_H);  // Fits both encoders
+    vr->f = fopen(path, "wb");
+    if (!vr->slots || !vr->buf || !vr->f) {
+        if (!vr->f) perror(path);
+        if (vr->f) fclose(vr->f);
+        free(vr->slots);
+        free(vr->buf);
+        return false;
+    }
+
+    // Palette in Y'CbCr, built here before the encoder thread can use it
+    for (int i = 0; i < 16; i++) {
+        int r = (zx_palette[i] >> 16) & 0xFF, g = (zx_palette[i] >> 8) & 0xFF,
+            b = zx_palette[i] & 0xFF;
+        vr->ycc[i][0] = (uint8_t)(16 + (66 * r + 129 * g + 25 * b + 128) / 256);
+        vr->ycc[i][1] = (uint8_t)(128 + (-38 * r - 74 * g + 112 * b + 128) / 256);
+        vr->ycc[i][2] = (uint8_t)(128 + (112 * r - 94 * g - 18 * b + 128) / 256);
+    }
+
+    if (vr->y4m)
+        fprintf(vr->f, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n",
+                ZX_SCREEN_W, ZX_SCREEN_H, ZX_FRAMES_PER_SECOND);
+    else
+        fwrite("ZXV1", 1, 4, vr->f);
+
+    vr->first = true;
+    atomic_init(&vr->head, 0);
+    atomic_init(&vr->tail, 0);
+    atomic_init(&vr->done, false);
+    if (pthread_create(&vr->thread, NULL, encoder_thread, vr) != 0) {
+        fclose(vr->f);
+        free(vr->slots);
+        free(vr->buf);
+        vr->f = NULL;
+        return false;
+    }
+    return true;
+}
+
+void video_push_frame(video_recorder* vr, const zx_spectrum* zx) {
+    if (!vr->f)
+        return;
+
+    unsigned tail = atomic_load_explicit(&vr->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&vr->head, memory_order_acquire);
+    if (tail - head == VIDEO_QUEUE_SLOTS) {
+        // Encoder is behind: drop this frame. "last" is left untouched, so the
+        // next queued frame carries every change since the last one sent.
+        vr->dropped++;
+        return;
+    }
+
+    // --- [ Collect changed cells straight from video memory ] ---
+    video_slot* s = &vr->slots[tail % VIDEO_QUEUE_SLOTS];
+    const uint8_t* screen = zx_screen(zx);
+    s->frame = zx->frame;
+    s->flash_state = zx->flash_state;
+    s->count = 0;
+
+    for (int row = 0; row < 24; row++) {
+        int base = line_offset(row * 8);   // Top pixel line of this cell row
+        for (int col = 0; col < 32; col++) {
+            int cell = row * 32 + col;
+            bool changed = vr->first || screen[6144 + cell] != vr->last[6144 + cell];
+            for (int k = 0; k < 8 && !changed; k++)
+                changed = screen[base + (k << 8) + col] != vr->last[base + (k << 8) + col];
+            if (!changed)
+                continue;
+
+            video_cell* c = &s->cells[s->count++];
+            c->index = (uint16_t)cell;
+            for (int k = 0; k < 8; k++) {
+                // The 8 lines of a cell are 256 bytes apart in video memory
+                c->bitmap[k] = screen[base + (k << 8) + col];
+                vr->last[base + (k << 8) + col] = c->bitmap[k];
+            }
+            c->attr = screen[6144 + cell];
+            vr->last[6144 + cell] = c->attr;
+        }
+    }
+
+    // Unchanged frames are still queued (with no cells) to keep the timeline
+    vr->first = false;
+    atomic_store_explicit(&vr->tail, tail + 1, memory_order_release);
+}
+
+void video_close(video_recorder* vr) {
+    if (!vr->f)
+        return;
+    atomic_store(&vr->done, true);
+    pthread_join(vr->thread, NULL);
+
+    if (vr->dropped)
+        fprintf(stderr, "video: %u frames dropped (encoder too slow)\n", vr->dropped);
+    fclose(vr->f);
+    free(vr->slots);
+    free(vr->buf);
+    vr->f = NULL;
+}
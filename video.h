@@ -0,0 +1,84 @@
+#ifndef ZX_VIDEO_H_
+#define ZX_VIDEO_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "spectrum.h"
+
+// --- [ Video Capture ] ---
+// Records the emulated screen to a file without slowing the emulator down.
+//
+// The emulation thread only compares the 768 character cells (8 bitmap
+// bytes + 1 attribute byte each) against the last frame it queued, and
+// copies the changed ones into a slot of a single-producer/single-consumer
+// lock-free ring. A background thread drains the ring, rebuilds the full
+// screen and encodes it. If the disk (or the encoder) falls behind, the
+// ring fills up and frames are dropped instead of blocking emulation, so
+// the per-frame cost stays bounded at one 6.9 KB compare.
+//
+// Output format is chosen by file extension:
+//
+//   *.y4m  YUV4MPEG2, 4:4:4, 50 fps - readable by ffmpeg, mpv, etc.
+//          Dropped frames are filled with the previous frame.
+//   other  ZXV, lossless native screen data with inter-frame XOR/RLE:
+//            "ZXV1"
+//            per frame: <frame delta varint> <flash u8>
+//                       <size varint> <delta of the 6912 screen bytes>
+//          (see delta.h for the delta encoding)
+
+#define VIDEO_CELLS        768    // 32 x 24 character cells
+#define VIDEO_QUEUE_SLOTS  64     // ~1.3 s of backlog at 50 fps
+
+// One changed character cell, as found in Spectrum video memory
+typedef struct video_cell {
+    uint16_t index;               // Cell number: row * 32 + column
+    uint8_t  bitmap[8];           // Its 8 pixel rows
+    uint8_t  attr;                // Its attribute byte
+} video_cell;
+
+typedef struct video_slot {
+    uint32_t frame;
+    bool     flash_state;
+    uint16_t count;               // Number of valid cells
+    video_cell cells[VIDEO_CELLS];
+} video_slot;
+
+typedef struct video_recorder {
+    FILE* f;
+    bool  y4m;
+
+    // --- Producer side (emulation thread) ---
+    uint8_t  last[ZX_SCREEN_BYTES];   // Screen as last queued
+    bool     first;                      // Next frame must be sent in full
+    uint32_t dropped;
+
+    // --- Lock-free ring (head: consumer, tail: producer) ---
+    video_slot* slots;
+    atomic_uint head;
+    atomic_uint tail;
+    atomic_bool done;
+
+    // --- Consumer side (encoder thread) ---
+    pthread_t thread;
+    uint8_t  screen[ZX_SCREEN_BYTES]; // Rebuilt current screen
+    uint8_t  written[ZX_SCREEN_BYTES];// Screen of the last written frame
+    bool     written_flash;
+    uint32_t written_frame;
+    uint32_t frames_written;
+    uint8_t* buf;                        // Encoder scratch buffer
+    uint8_t  ycc[16][3];                 // Palette as Y'CbCr (Y4M only)
+} video_recorder;
+
+bool video_open(video_recorder* vr, const char* path);
+
+// Queues the current screen. Never blocks; drops the frame if the queue is full.
+void video_push_frame(video_recorder* vr, const zx_spectrum* zx);
+
+// Flushes the queue, stops the encoder thread and closes the file.
+void video_close(video_recorder* vr);
+
+#endif // ZX_VIDEO_H_
@@ -1,7 +1,53 @@
 #include "z80.h"
 
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+// MARK: variants
+// this file is the exact core plus everything the variants share. a variant
+// is the same file compiled again with features switched off (z80_fast.c):
+// their code is gone, not skipped at run time.
+#ifndef Z80_CORE_NAME
+#define Z80_CORE_NAME z80_core_exact
+#define Z80_SHARED 1 // tables, init, cache management: compiled once
+#else
+#define Z80_SHARED 0
+#endif
+#ifndef Z80_MEMPTR
+#define Z80_MEMPTR 1 // the hidden wz register (seen in bit n,(hl) xf/yf)
+#endif
+#ifndef Z80_UNDOC_FLAGS
+#define Z80_UNDOC_FLAGS 1 // xf/yf, bits 3 and 5 of f
+#endif
+#ifndef Z80_R_REGISTER
+#define Z80_R_REGISTER 1 // r counts opcode fetches
+#endif
+
+// statements for a feature. switched off they are still compiled (as the
+// unevaluated operand of sizeof), so the values they used stay used.
+#if Z80_MEMPTR
+#define MEMPTR(...) __VA_ARGS__
+#else
+#define MEMPTR(...) ((void) sizeof((__VA_ARGS__), 0))
+#endif
+#if Z80_UNDOC_FLAGS
+#define XY(...) __VA_ARGS__
+#else
+#define XY(...) ((void) sizeof((__VA_ARGS__), 0))
+#endif
+
+struct z80_core {
+  void (*step)(z80* const z);
+  void (*run)(z80* const z, unsigned long until);
+};
+
+extern const z80_core z80_core_exact;
+extern const z80_core z80_core_fast;
+
+#if Z80_SHARED
 // MARK: timings
-static const uint8_t cyc_00[256] = {4, 10, 7, 6, 4, 4, 7, 4, 4, 11, 7, 6, 4, 4,
+const uint8_t z80_cyc_00[256] = {4, 10, 7, 6, 4, 4, 7, 4, 4, 11, 7, 6, 4, 4,
     7, 4, 8, 10, 7, 6, 4, 4, 7, 4, 12, 11, 7, 6, 4, 4, 7, 4, 7, 10, 16, 6, 4, 4,
     7, 4, 7, 11, 16, 6, 4, 4, 7, 4, 7, 10, 13, 6, 11, 11, 10, 4, 7, 11, 13, 6,
     4, 4, 7, 4, 4, 4, 4, 4, 4, 4, 7, 4, 4, 4, 4, 4, 4, 4, 7, 4, 4, 4, 4, 4, 4,
@@ -14,7 +60,7 @@ static const uint8_t cyc_00[256] = {4, 10, 7, 6, 4, 4, 7, 4, 4, 11, 7, 6, 4, 4,
     10, 11, 7, 11, 5, 4, 10, 4, 10, 0, 7, 11, 5, 10, 10, 4, 10, 11, 7, 11, 5, 6,
     10, 4, 10, 0, 7, 11};
 
-static const uint8_t cyc_ed[256] = {8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
+const uint8_t z80_cyc_ed[256] = {8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
     8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
     8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 12,
     12, 15, 20, 8, 14, 8, 9, 12, 12, 15, 20, 8, 14, 8, 9, 12, 12, 15, 20, 8, 14,
@@ -27,7 +73,7 @@ static const uint8_t cyc_ed[256] = {8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
     8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
     8, 8, 8, 8, 8, 8, 8};
 
-static const uint8_t cyc_ddfd[256] = {4, 4, 4, 4, 4, 4, 4, 4, 4, 15, 4, 4, 4, 4,
+const uint8_t z80_cyc_ddfd[256] = {4, 4, 4, 4, 4, 4, 4, 4, 4, 15, 4, 4, 4, 4,
     4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 15, 4, 4, 4, 4, 4, 4, 4, 14, 20, 10, 8, 8,
     11, 4, 4, 15, 20, 10, 8, 8, 11, 4, 4, 4, 4, 4, 23, 23, 19, 4, 4, 15, 4, 4,
     4, 4, 4, 4, 4, 4, 4, 4, 8, 8, 19, 4, 4, 4, 4, 4, 8, 8, 19, 4, 4, 4, 4, 4, 8,
@@ -40,6 +86,101 @@ static const uint8_t cyc_ddfd[256] = {4, 4, 4, 4, 4, 4, 4, 4, 4, 15, 4, 4, 4, 4,
     15, 4, 4, 4, 8, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 10, 4, 4, 4, 4,
     4, 4};
 
+const uint8_t z80_hl_operand[256] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 3, 3, 3,
+    0, 0, 1, 1, 1, 3, 3, 3, 0, 0, 0, 0, 0, 2, 2, 2, 0, 0, 1, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 3, 3, 2, 0, 0, 0, 0, 0, 3, 3, 2, 0, 0, 0, 0, 0, 3, 3, 2, 0, 0,
+    0, 0, 0, 3, 3, 2, 0, 3, 3, 3, 3, 3, 3, 2, 3, 3, 3, 3, 3, 3, 3, 2, 3, 2, 2,
+    2, 2, 2, 2, 0, 2, 0, 0, 0, 0, 3, 3, 2, 0, 0, 0, 0, 0, 3, 3, 2, 0, 0, 0, 0,
+    0, 3, 3, 2, 0, 0, 0, 0, 0, 3, 3, 2, 0, 0, 0, 0, 0, 3, 3, 2, 0, 0, 0, 0, 0,
+    3, 3, 2, 0, 0, 0, 0, 0, 3, 3, 2, 0, 0, 0, 0, 0, 3, 3, 2, 0, 0, 0, 0, 0, 3,
+    3, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 0, 1, 0, 0, 0, 1, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0};
+
+#endif // Z80_SHARED
+
+// MARK: block cache
+// straight-line code is decoded once into an array of micro-ops (a handler
+// plus its pre-fetched operands) and replayed from there. a block ends at
+// anything that can branch, halt or enable interrupts, so interrupts only
+// need checking between blocks. common instructions get a handler of their
+// own; the others are replayed through the interpreter.
+//
+// every 256-byte page has a generation number, bumped by the first write
+// to a page blocks were decoded from. a block is only used while the
+// generations it was decoded under are current.
+#define BLOCK_MAX_OPS 32
+#define BLOCK_POOL 4096
+
+typedef struct z80_uop z80_uop;
+typedef void (*z80_uop_fn)(z80* const z, const z80_uop* const u);
+
+struct z80_uop {
+  z80_uop_fn fn;
+  uint16_t pc; // address of the instruction
+  uint16_t nn; // immediate word, or branch target
+  uint8_t r1, r2; // register offsets in struct z80, or immediate byte
+  uint8_t cyc; // base t-states
+  uint8_t len;
+};
+
+typedef struct z80_block {
+  uint16_t end; // address after the last instruction
+  uint16_t max_cyc; // upper bound of the t-states it takes
+  uint8_t nops;
+  bool branch; // the last instruction sets pc itself
+  bool fast; // has a handler of its own to run (else z80_step is as good)
+  uint8_t page[2]; // first and last page of its code
+  uint32_t gen[2]; // their generations when it was decoded
+  z80_uop ops[BLOCK_MAX_OPS];
+} z80_block;
+
+struct z80_blocks {
+  uint16_t index[65536]; // start address -> pool slot + 1 (0 = none)
+  uint32_t gen[256];
+  bool code[256]; // blocks were decoded from this page
+  bool stale; // a code page was written during the current block
+  int used;
+  z80_block_stats stats;
+  z80_block pool[BLOCK_POOL];
+};
+
+// MARK: decode cache
+// the interpreter's own cache: the instruction at each address decoded into
+// one of the micro-ops blocks are made of, filled the first time z80_step
+// runs it. an instruction is at most 4 bytes long, so a write retires the
+// entries starting at its address and the 3 before it. pages nothing was
+// decoded from (or that are rom) are not looked at.
+struct z80_icache {
+  z80_uop ops[65536]; // fn == NULL: not decoded yet
+  bool code[256]; // entries overlap this page (and it isn't rom)
+  bool filled[256]; // entries overlap this page
+  bool rom[256];
+  z80_decode_stats stats;
+};
+
+static const z80_uop* icache_fill(
+    z80* const z, z80_icache* const ic, uint16_t pc);
+
+// a write to a page code was decoded from retires that code
+static inline void code_write(z80* const z, uint16_t addr) {
+  z80_blocks* const bs = z->blocks;
+  if (bs && bs->code[addr >> 8]) {
+    bs->code[addr >> 8] = false;
+    bs->gen[addr >> 8] += 1;
+    bs->stale = true;
+    bs->stats.invalidated += 1;
+  }
+  z80_icache* const ic = z->icache;
+  if (ic && ic->code[addr >> 8]) {
+    for (int i = 0; i < 4; i++) {
+      ic->ops[(uint16_t) (addr - i)].fn = NULL;
+    }
+    ic->stats.retired += 1;
+  }
+}
+
 // MARK: helpers
 
 // get bit "n" of number "val"
@@ -51,6 +192,7 @@ static inline uint8_t rb(z80* const z, uint16_t addr) {
 
 static inline void wb(z80* const z, uint16_t addr, uint8_t val) {
   z->write_byte(z->userdata, addr, val);
+  code_write(z, addr);
 }
 
 static inline uint16_t rw(z80* const z, uint16_t addr) {
@@ -61,6 +203,8 @@ static inline uint16_t rw(z80* const z, uint16_t addr) {
 static inline void ww(z80* const z, uint16_t addr, uint16_t val) {
   z->write_byte(z->userdata, addr, val & 0xFF);
   z->write_byte(z->userdata, addr + 1, val >> 8);
+  code_write(z, addr);
+  code_write(z, addr + 1);
 }
 
 static inline void pushw(z80* const z, uint16_t val) {
@@ -135,7 +279,11 @@ static inline void set_f(z80* const z, uint8_t val) {
 
 // increments R, keeping the highest byte intact
 static inline void inc_r(z80* const z) {
+#if Z80_R_REGISTER
   z->r = (z->r & 0x80) | ((z->r + 1) & 0x7f);
+#else
+  (void) z;
+#endif
 }
 
 // returns if there was a carry between bit "bit_no" and "bit_no - 1" when
@@ -163,11 +311,49 @@ static void exec_opcode_dcb(
 static void exec_opcode_ed(z80* const z, uint8_t opcode);
 static void exec_opcode_ddfd(z80* const z, uint8_t opcode, uint16_t* const iz);
 
+// MARK: profiler
+#ifdef Z80_PROFILE
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static inline uint64_t prof_ticks(void) {
+  return __rdtsc();
+}
+#else
+static inline uint64_t prof_ticks(void) {
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+  return (uint64_t) ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+#endif
+
+#if Z80_SHARED
+static double prof_wall(void) {
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+#endif
+
+#define PROF_OP(table, op) (z->prof_table = (table), z->prof_op = (op))
+
+static inline void prof_record(
+    z80* const z, unsigned long cyc0, uint64_t t0) {
+  z80_profile* const p = z->profile;
+  p->count[z->prof_table][z->prof_op] += 1;
+  p->cycles[z->prof_table][z->prof_op] += z->cyc - cyc0;
+  p->ticks[z->prof_table] += prof_ticks() - t0;
+}
+#else
+#define PROF_OP(table, op) ((void) 0)
+#endif
+
 // MARK: opcodes
 // jumps to an address
 static inline void jump(z80* const z, uint16_t addr) {
   z->pc = addr;
-  z->mem_ptr = addr;
+  MEMPTR(z->mem_ptr = addr);
 }
 
 // jumps to next word in memory if condition is true
@@ -176,14 +362,14 @@ static inline void cond_jump(z80* const z, bool condition) {
   if (condition) {
     jump(z, addr);
   }
-  z->mem_ptr = addr;
+  MEMPTR(z->mem_ptr = addr);
 }
 
 // calls to next word in memory
 static inline void call(z80* const z, uint16_t addr) {
   pushw(z, z->pc);
   z->pc = addr;
-  z->mem_ptr = addr;
+  MEMPTR(z->mem_ptr = addr);
 }
 
 // calls to next word in memory if condition is true
@@ -193,13 +379,13 @@ static inline void cond_call(z80* const z, bool condition) {
     call(z, addr);
     z->cyc += 7;
   }
-  z->mem_ptr = addr;
+  MEMPTR(z->mem_ptr = addr);
 }
 
 // returns from subroutine
 static inline void ret(z80* const z) {
   z->pc = popw(z);
-  z->mem_ptr = z->pc;
+  MEMPTR(z->mem_ptr = z->pc);
 }
 
 // returns from subroutine if condition is true
@@ -212,7 +398,7 @@ static inline void cond_ret(z80* const z, bool condition) {
 
 static inline void jr(z80* const z, int8_t displacement) {
   z->pc += displacement;
-  z->mem_ptr = z->pc;
+  MEMPTR(z->mem_ptr = z->pc);
 }
 
 static inline void cond_jr(z80* const z, bool condition) {
@@ -232,8 +418,8 @@ static inline uint8_t addb(z80* const z, uint8_t a, uint8_t b, bool cy) {
   z->pf = carry(7, a, b, cy) != carry(8, a, b, cy);
   z->cf = carry(8, a, b, cy);
   z->nf = 0;
-  z->xf = GET_BIT(3, result);
-  z->yf = GET_BIT(5, result);
+  XY(z->xf = GET_BIT(3, result));
+  XY(z->yf = GET_BIT(5, result));
   return result;
 }
 
@@ -253,7 +439,7 @@ static inline uint16_t addw(z80* const z, uint16_t a, uint16_t b, bool cy) {
 
   uint16_t result = (msb << 8) | lsb;
   z->zf = result == 0;
-  z->mem_ptr = a + 1;
+  MEMPTR(z->mem_ptr = a + 1);
   return result;
 }
 
@@ -264,7 +450,7 @@ static inline uint16_t subw(z80* const z, uint16_t a, uint16_t b, bool cy) {
 
   uint16_t result = (msb << 8) | lsb;
   z->zf = result == 0;
-  z->mem_ptr = a + 1;
+  MEMPTR(z->mem_ptr = a + 1);
   return result;
 }
 
@@ -336,8 +522,8 @@ static inline void land(z80* const z, uint8_t val) {
   z->pf = parity(result);
   z->nf = 0;
   z->cf = 0;
-  z->xf = GET_BIT(3, result);
-  z->yf = GET_BIT(5, result);
+  XY(z->xf = GET_BIT(3, result));
+  XY(z->yf = GET_BIT(5, result));
   z->a = result;
 }
 
@@ -351,8 +537,8 @@ static inline void lxor(z80* const z, const uint8_t val) {
   z->pf = parity(result);
   z->nf = 0;
   z->cf = 0;
-  z->xf = GET_BIT(3, result);
-  z->yf = GET_BIT(5, result);
+  XY(z->xf = GET_BIT(3, result));
+  XY(z->yf = GET_BIT(5, result));
   z->a = result;
 }
 
@@ -366,8 +552,8 @@ static inline void lor(z80* const z, const uint8_t val) {
   z->pf = parity(result);
   z->nf = 0;
   z->cf = 0;
-  z->xf = GET_BIT(3, result);
-  z->yf = GET_BIT(5, result);
+  XY(z->xf = GET_BIT(3, result));
+  XY(z->yf = GET_BIT(5, result));
   z->a = result;
 }
 
@@ -378,8 +564,8 @@ static inline void cp(z80* const z, const uint8_t val) {
   // the only difference between cp and sub is that
   // the xf/yf are taken from the value to be substracted,
   // not the result
-  z->yf = GET_BIT(5, val);
-  z->xf = GET_BIT(3, val);
+  XY(z->yf = GET_BIT(5, val));
+  XY(z->xf = GET_BIT(3, val));
 }
 
 // 0xCB opcodes
@@ -393,8 +579,8 @@ static inline uint8_t cb_rlc(z80* const z, uint8_t val) {
   z->nf = 0;
   z->hf = 0;
   z->cf = old;
-  z->xf = GET_BIT(3, val);
-  z->yf = GET_BIT(5, val);
+  XY(z->xf = GET_BIT(3, val));
+  XY(z->yf = GET_BIT(5, val));
   return val;
 }
 
@@ -408,8 +594,8 @@ static inline uint8_t cb_rrc(z80* const z, uint8_t val) {
   z->hf = 0;
   z->cf = old;
   z->pf = parity(val);
-  z->xf = GET_BIT(3, val);
-  z->yf = GET_BIT(5, val);
+  XY(z->xf = GET_BIT(3, val));
+  XY(z->yf = GET_BIT(5, val));
   return val;
 }
 
@@ -423,8 +609,8 @@ static inline uint8_t cb_rl(z80* const z, uint8_t val) {
   z->nf = 0;
   z->hf = 0;
   z->pf = parity(val);
-  z->xf = GET_BIT(3, val);
-  z->yf = GET_BIT(5, val);
+  XY(z->xf = GET_BIT(3, val));
+  XY(z->yf = GET_BIT(5, val));
   return val;
 }
 
@@ -438,8 +624,8 @@ static inline uint8_t cb_rr(z80* const z, uint8_t val) {
   z->nf = 0;
   z->hf = 0;
   z->pf = parity(val);
-  z->xf = GET_BIT(3, val);
-  z->yf = GET_BIT(5, val);
+  XY(z->xf = GET_BIT(3, val));
+  XY(z->yf = GET_BIT(5, val));
   return val;
 }
 
@@ -452,8 +638,8 @@ static inline uint8_t cb_sla(z80* const z, uint8_t val) {
   z->nf = 0;
   z->hf = 0;
   z->pf = parity(val);
-  z->xf = GET_BIT(3, val);
-  z->yf = GET_BIT(5, val);
+  XY(z->xf = GET_BIT(3, val));
+  XY(z->yf = GET_BIT(5, val));
   return val;
 }
 
@@ -467,8 +653,8 @@ static inline uint8_t cb_sll(z80* const z, uint8_t val) {
   z->nf = 0;
   z->hf = 0;
   z->pf = parity(val);
-  z->xf = GET_BIT(3, val);
-  z->yf = GET_BIT(5, val);
+  XY(z->xf = GET_BIT(3, val));
+  XY(z->yf = GET_BIT(5, val));
   return val;
 }
 
@@ -481,8 +667,8 @@ static inline uint8_t cb_sra(z80* const z, uint8_t val) {
   z->nf = 0;
   z->hf = 0;
   z->pf = parity(val);
-  z->xf = GET_BIT(3, val);
-  z->yf = GET_BIT(5, val);
+  XY(z->xf = GET_BIT(3, val));
+  XY(z->yf = GET_BIT(5, val));
   return val;
 }
 
@@ -495,8 +681,8 @@ static inline uint8_t cb_srl(z80* const z, uint8_t val) {
   z->nf = 0;
   z->hf = 0;
   z->pf = parity(val);
-  z->xf = GET_BIT(3, val);
-  z->yf = GET_BIT(5, val);
+  XY(z->xf = GET_BIT(3, val));
+  XY(z->yf = GET_BIT(5, val));
   return val;
 }
 
@@ -505,9 +691,9 @@ static inline uint8_t cb_bit(z80* const z, uint8_t val, uint8_t n) {
   const uint8_t result = val & (1 << n);
   z->sf = result >> 7;
   z->zf = result == 0;
-  z->yf = GET_BIT(5, val);
+  XY(z->yf = GET_BIT(5, val));
   z->hf = 1;
-  z->xf = GET_BIT(3, val);
+  XY(z->xf = GET_BIT(3, val));
   z->pf = z->zf;
   z->nf = 0;
   return result;
@@ -527,8 +713,8 @@ static inline void ldi(z80* const z) {
   // see https://wikiti.brandonw.net/index.php?title=Z80_Instruction_Set
   // for the calculation of xf/yf on LDI
   const uint8_t result = val + z->a;
-  z->xf = GET_BIT(3, result);
-  z->yf = GET_BIT(1, result);
+  XY(z->xf = GET_BIT(3, result));
+  XY(z->yf = GET_BIT(1, result));
 
   z->nf = 0;
   z->hf = 0;
@@ -547,22 +733,22 @@ static inline void cpi(z80* const z) {
   const uint8_t result = subb(z, z->a, rb(z, get_hl(z)), 0);
   set_hl(z, get_hl(z) + 1);
   set_bc(z, get_bc(z) - 1);
-  z->xf = GET_BIT(3, result - z->hf);
-  z->yf = GET_BIT(1, result - z->hf);
+  XY(z->xf = GET_BIT(3, result - z->hf));
+  XY(z->yf = GET_BIT(1, result - z->hf));
   z->pf = get_bc(z) != 0;
   z->cf = cf;
-  z->mem_ptr += 1;
+  MEMPTR(z->mem_ptr += 1);
 }
 
 static inline void cpd(z80* const z) {
   cpi(z);
   // same as cpi but HL is decremented instead of incremented
   set_hl(z, get_hl(z) - 2);
-  z->mem_ptr -= 2;
+  MEMPTR(z->mem_ptr -= 2);
 }
 
 static void in_r_c(z80* const z, uint8_t* r) {
-  *r = z->port_in(z, z->c);
+  *r = z->port_in(z, get_bc(z), z->cyc);
   z->zf = *r == 0;
   z->sf = *r >> 7;
   z->pf = parity(*r);
@@ -571,34 +757,36 @@ static void in_r_c(z80* const z, uint8_t* r) {
 }
 
 static void ini(z80* const z) {
-  uint8_t val = z->port_in(z, z->c);
+  uint8_t val = z->port_in(z, get_bc(z), z->cyc);
   wb(z, get_hl(z), val);
   set_hl(z, get_hl(z) + 1);
   z->b -= 1;
   z->zf = z->b == 0;
   z->nf = 1;
-  z->mem_ptr = get_bc(z) + 1;
+  MEMPTR(z->mem_ptr = get_bc(z) + 1);
 }
 
 static void ind(z80* const z) {
   ini(z);
   set_hl(z, get_hl(z) - 2);
-  z->mem_ptr = get_bc(z) - 2;
+  MEMPTR(z->mem_ptr = get_bc(z) - 2);
 }
 
 static void outi(z80* const z) {
-  z->port_out(z, z->c, rb(z, get_hl(z)));
-  set_hl(z, get_hl(z) + 1);
+  // b is decremented before the output: the port sees the new value
+  uint8_t val = rb(z, get_hl(z));
   z->b -= 1;
+  z->port_out(z, get_bc(z), val, z->cyc);
+  set_hl(z, get_hl(z) + 1);
   z->zf = z->b == 0;
   z->nf = 1;
-  z->mem_ptr = get_bc(z) + 1;
+  MEMPTR(z->mem_ptr = get_bc(z) + 1);
 }
 
 static void outd(z80* const z) {
   outi(z);
   set_hl(z, get_hl(z) - 2);
-  z->mem_ptr = get_bc(z) - 2;
+  MEMPTR(z->mem_ptr = get_bc(z) - 2);
 }
 
 static void daa(z80* const z) {
@@ -633,14 +821,14 @@ static void daa(z80* const z) {
   z->sf = z->a >> 7;
   z->zf = z->a == 0;
   z->pf = parity(z->a);
-  z->xf = GET_BIT(3, z->a);
-  z->yf = GET_BIT(5, z->a);
+  XY(z->xf = GET_BIT(3, z->a));
+  XY(z->yf = GET_BIT(5, z->a));
 }
 
 static inline uint16_t displace(
     z80* const z, uint16_t base_addr, int8_t displacement) {
   const uint16_t addr = base_addr + displacement;
-  z->mem_ptr = addr;
+  MEMPTR(z->mem_ptr = addr);
   return addr;
 }
 
@@ -700,6 +888,7 @@ static inline void process_interrupts(z80* const z) {
 }
 
 // MARK: interface
+#if Z80_SHARED
 // initialises a z80 struct. Note that read_byte, write_byte, port_in, port_out
 // and userdata must be manually set by the user afterwards.
 void z80_init(z80* const z) {
@@ -715,7 +904,7 @@ void z80_init(z80* const z) {
   z->sp = 0xFFFF;
   z->ix = 0;
   z->iy = 0;
-  z->mem_ptr = 0;
+  MEMPTR(z->mem_ptr = 0);
 
   // af and sp are set to 0xFFFF after reset,
   // and the other values are undefined (z80-documented)
@@ -756,20 +945,56 @@ void z80_init(z80* const z) {
   z->int_pending = 0;
   z->nmi_pending = 0;
   z->int_data = 0;
+
+  z->blocks = NULL;
+  z->icache = NULL;
+  z->core = &z80_core_exact;
+
+  z->profile = NULL;
+  z->prof_table = 0;
+  z->prof_op = 0;
 }
 
+#endif // Z80_SHARED
+
 // executes the next instruction in memory + handles interrupts
-void z80_step(z80* const z) {
+static void step(z80* const z) {
+#ifdef Z80_PROFILE
+  const unsigned long cyc0 = z->cyc;
+  const uint64_t t0 = z->profile ? prof_ticks() : 0;
+#endif
+
+#ifdef Z80_PROFILE
+  z80_icache* const ic = z->profile ? NULL : z->icache; // count every opcode
+#else
+  z80_icache* const ic = z->icache;
+#endif
+
   if (z->halted) {
     exec_opcode(z, 0x00);
+    PROF_OP(Z80_PROF_BASE, 0x76); // time spent halted shows up as halt
+  } else if (ic) {
+    const z80_uop* u = &ic->ops[z->pc];
+    if (!u->fn) {
+      u = icache_fill(z, ic, z->pc);
+    }
+    z->pc += u->len; // branches set it again
+    u->fn(z, u);
+    ic->stats.runs += 1;
   } else {
     const uint8_t opcode = nextb(z);
     exec_opcode(z, opcode);
   }
 
+#ifdef Z80_PROFILE
+  if (z->profile) {
+    prof_record(z, cyc0, t0);
+  }
+#endif
   process_interrupts(z);
 }
 
+#if Z80_SHARED
 // outputs to stdout a debug trace of the emulator
 void z80_debug_output(z80* const z) {
   printf("PC: %04X, AF: %04X, BC: %04X, DE: %04X, HL: %04X, SP: %04X, "
@@ -781,6 +1006,87 @@ void z80_debug_output(z80* const z) {
       rb(z, z->pc + 2), rb(z, z->pc + 3), z->cyc);
 }
 
+// flags register as a byte (for save states, debuggers and test harnesses)
+uint8_t z80_get_f(z80* const z) {
+  return get_f(z);
+}
+
+void z80_set_f(z80* const z, uint8_t val) {
+  set_f(z, val);
+}
+
+#ifdef Z80_PROFILE
+void z80_profile_reset(z80_profile* const p) {
+  memset(p, 0, sizeof(*p));
+  p->tick_start = prof_ticks();
+  p->wall_start = prof_wall();
+}
+
+// prints per-table totals, then the "top" opcodes by t-states
+void z80_profile_dump(const z80_profile* const p, FILE* f, int top) {
+  static const char* const names[Z80_PROF_TABLES] = {
+      "base", "CB", "ED", "DD/FD", "DDCB/FDCB"};
+  static const char* const prefixes[Z80_PROF_TABLES] = {
+      "", "CB ", "ED ", "DD ", "DDCB "};
+
+  const double ns_per_tick = (prof_wall() - p->wall_start) * 1e9 /
+                             (double) (prof_ticks() - p->tick_start);
+  uint64_t all_cyc = 0;
+  for (int t = 0; t < Z80_PROF_TABLES; t++) {
+    for (int op = 0; op < 256; op++) {
+      all_cyc += p->cycles[t][op];
+    }
+  }
+  if (all_cyc == 0) {
+    fprintf(f, "profile: no instructions executed\n");
+    return;
+  }
+
+  fprintf(f, "%-10s %14s %16s %7s %12s %9s\n", "table", "count", "t-states",
+      "%", "host ms", "ns/instr");
+  for (int t = 0; t < Z80_PROF_TABLES; t++) {
+    uint64_t n = 0, c = 0;
+    for (int op = 0; op < 256; op++) {
+      n += p->count[t][op];
+      c += p->cycles[t][op];
+    }
+    const double ns = p->ticks[t] * ns_per_tick;
+    fprintf(f, "%-10s %14llu %16llu %6.2f%% %12.1f %9.2f\n", names[t],
+        (unsigned long long) n, (unsigned long long) c, 100.0 * c / all_cyc,
+        ns * 1e-6, n ? ns / n : 0.0);
+  }
+
+  // selection of the top entries by t-states (small n, no sort needed)
+  static bool shown[Z80_PROF_TABLES][256];
+  memset(shown, 0, sizeof(shown));
+  fprintf(f, "\n%-10s %14s %16s %7s %9s\n", "opcode", "count", "t-states", "%",
+      "t/instr");
+  for (int i = 0; i < top; i++) {
+    int bt = -1, bo = 0;
+    for (int t = 0; t < Z80_PROF_TABLES; t++) {
+      for (int op = 0; op < 256; op++) {
+        if (!shown[t][op] && p->count[t][op] &&
+            (bt < 0 || p->cycles[t][op] > p->cycles[bt][bo])) {
+          bt = t;
+          bo = op;
+        }
+      }
+    }
+    if (bt < 0) {
+      break;
+    }
+    shown[bt][bo] = true;
+    char name[16];
+    snprintf(name, sizeof(name), "%s%02X", prefixes[bt], bo);
+    fprintf(f, "%-10s %14llu %16llu %6.2f%% %9.2f\n", name,
+        (unsigned long long) p->count[bt][bo],
+        (unsigned long long) p->cycles[bt][bo],
+        100.0 * p->cycles[bt][bo] / all_cyc,
+        (double) p->cycles[bt][bo] / p->count[bt][bo]);
+  }
+}
+#endif
+
 // function to call when an NMI is to be serviced
 void z80_gen_nmi(z80* const z) {
   z->nmi_pending = 1;
@@ -791,10 +1097,775 @@ void z80_gen_int(z80* const z, uint8_t data) {
   z->int_pending = 1;
   z->int_data = data;
 }
+#endif // Z80_SHARED
+
+// MARK: block tier
+#define UOP(name) static void name(z80* const z, const z80_uop* const u)
+#define REG(off) (((uint8_t*) z)[off])
+#define PAIR(hi, lo) ((uint16_t) (REG(hi) << 8 | REG(lo)))
+#define NEXT_PC ((uint16_t) (u->pc + u->len))
+
+// register offsets by their 3-bit code in the opcode (6 is "(hl)")
+static const uint8_t reg_offset[8] = {offsetof(z80, b), offsetof(z80, c),
+    offsetof(z80, d), offsetof(z80, e), offsetof(z80, h), offsetof(z80, l), 0,
+    offsetof(z80, a)};
+
+// every handler starts the way exec_opcode does
+static inline void uop_begin(z80* const z, const z80_uop* const u) {
+  z->cyc += u->cyc;
+  inc_r(z);
+}
+
+// anything without a handler of its own: the interpreter, from memory
+UOP(uop_interp) {
+  z->pc = u->pc;
+  exec_opcode(z, nextb(z));
+}
+
+// prefixed instructions: the table handler is called straight away, with
+// pc past the bytes the interpreter would have fetched to get there
+UOP(uop_cb) {
+  uop_begin(z, u);
+  z->pc = u->pc + 2;
+  exec_opcode_cb(z, u->r2);
+}
+
+UOP(uop_ed) {
+  uop_begin(z, u);
+  z->pc = u->pc + 2;
+  exec_opcode_ed(z, u->r2);
+}
+
+UOP(uop_ddfd) {
+  uop_begin(z, u);
+  z->pc = u->pc + 2;
+  exec_opcode_ddfd(z, u->r2, u->r1 ? &z->iy : &z->ix);
+}
+
+// ddcb/fdcb: the displacement comes before the opcode (u->nn, u->r2)
+UOP(uop_ddcb) {
+  uop_begin(z, u);
+  z->cyc += z80_cyc_ddfd[0xCB];
+  inc_r(z);
+  z->pc = u->pc + 4;
+  const uint16_t iz = u->r1 ? z->iy : z->ix;
+  exec_opcode_dcb(z, u->r2, displace(z, iz, (int8_t) u->nn));
+}
+
+UOP(uop_nop) {
+  uop_begin(z, u);
+}
+
+UOP(uop_ld_r_r) {
+  uop_begin(z, u);
+  REG(u->r1) = REG(u->r2);
+}
+
+UOP(uop_ld_r_n) {
+  uop_begin(z, u);
+  REG(u->r1) = u->r2;
+}
+
+UOP(uop_ld_r_hl) {
+  uop_begin(z, u);
+  REG(u->r1) = rb(z, get_hl(z));
+}
+
+UOP(uop_ld_hl_r) {
+  uop_begin(z, u);
+  wb(z, get_hl(z), REG(u->r2));
+}
+
+UOP(uop_ld_hl_n) {
+  uop_begin(z, u);
+  wb(z, get_hl(z), u->r2);
+}
+
+UOP(uop_inc_r) {
+  uop_begin(z, u);
+  REG(u->r1) = inc(z, REG(u->r1));
+}
+
+UOP(uop_dec_r) {
+  uop_begin(z, u);
+  REG(u->r1) = dec(z, REG(u->r1));
+}
+
+// alu a,r / a,n / a,(hl)
+#define ALU_UOPS(name, op) \
+  UOP(uop_##name##_r) { \
+    uop_begin(z, u); \
+    op(REG(u->r2)); \
+  } \
+  UOP(uop_##name##_n) { \
+    uop_begin(z, u); \
+    op(u->r2); \
+  } \
+  UOP(uop_##name##_hl) { \
+    uop_begin(z, u); \
+    op(rb(z, get_hl(z))); \
+  }
+
+#define ALU_ADD(v) z->a = addb(z, z->a, v, 0)
+#define ALU_ADC(v) z->a = addb(z, z->a, v, z->cf)
+#define ALU_SUB(v) z->a = subb(z, z->a, v, 0)
+#define ALU_SBC(v) z->a = subb(z, z->a, v, z->cf)
+#define ALU_AND(v) land(z, v)
+#define ALU_XOR(v) lxor(z, v)
+#define ALU_OR(v) lor(z, v)
+#define ALU_CP(v) cp(z, v)
+
+ALU_UOPS(add, ALU_ADD)
+ALU_UOPS(adc, ALU_ADC)
+ALU_UOPS(sub, ALU_SUB)
+ALU_UOPS(sbc, ALU_SBC)
+ALU_UOPS(and, ALU_AND)
+ALU_UOPS(xor, ALU_XOR)
+ALU_UOPS(or, ALU_OR)
+ALU_UOPS(cp, ALU_CP)
+
+// by bits 3-5 of the opcode
+static const z80_uop_fn uop_alu_r[8] = {uop_add_r, uop_adc_r, uop_sub_r,
+    uop_sbc_r, uop_and_r, uop_xor_r, uop_or_r, uop_cp_r};
+static const z80_uop_fn uop_alu_n[8] = {uop_add_n, uop_adc_n, uop_sub_n,
+    uop_sbc_n, uop_and_n, uop_xor_n, uop_or_n, uop_cp_n};
+static const z80_uop_fn uop_alu_hl[8] = {uop_add_hl, uop_adc_hl, uop_sub_hl,
+    uop_sbc_hl, uop_and_hl, uop_xor_hl, uop_or_hl, uop_cp_hl};
+
+// 16-bit: r1/r2 are the high/low registers of bc, de or hl
+UOP(uop_ld_rr_nn) {
+  uop_begin(z, u);
+  REG(u->r1) = u->nn >> 8;
+  REG(u->r2) = u->nn & 0xFF;
+}
+
+UOP(uop_ld_sp_nn) {
+  uop_begin(z, u);
+  z->sp = u->nn;
+}
+
+UOP(uop_inc_rr) {
+  uop_begin(z, u);
+  const uint16_t val = PAIR(u->r1, u->r2) + 1;
+  REG(u->r1) = val >> 8;
+  REG(u->r2) = val & 0xFF;
+}
+
+UOP(uop_dec_rr) {
+  uop_begin(z, u);
+  const uint16_t val = PAIR(u->r1, u->r2) - 1;
+  REG(u->r1) = val >> 8;
+  REG(u->r2) = val & 0xFF;
+}
+
+UOP(uop_inc_sp) {
+  uop_begin(z, u);
+  z->sp = z->sp + 1;
+}
+
+UOP(uop_dec_sp) {
+  uop_begin(z, u);
+  z->sp = z->sp - 1;
+}
+
+UOP(uop_push_rr) {
+  uop_begin(z, u);
+  pushw(z, PAIR(u->r1, u->r2));
+}
+
+UOP(uop_push_af) {
+  uop_begin(z, u);
+  pushw(z, (z->a << 8) | get_f(z));
+}
+
+UOP(uop_pop_rr) {
+  uop_begin(z, u);
+  const uint16_t val = popw(z);
+  REG(u->r1) = val >> 8;
+  REG(u->r2) = val & 0xFF;
+}
+
+UOP(uop_pop_af) {
+  uop_begin(z, u);
+  const uint16_t val = popw(z);
+  z->a = val >> 8;
+  set_f(z, val & 0xFF);
+}
+
+UOP(uop_ld_a_rr) {
+  uop_begin(z, u);
+  const uint16_t addr = PAIR(u->r1, u->r2);
+  z->a = rb(z, addr);
+  MEMPTR(z->mem_ptr = addr + 1);
+}
+
+UOP(uop_ld_rr_a) {
+  uop_begin(z, u);
+  const uint16_t addr = PAIR(u->r1, u->r2);
+  wb(z, addr, z->a);
+  MEMPTR(z->mem_ptr = (z->a << 8) | ((addr + 1) & 0xFF));
+}
+
+UOP(uop_ld_a_mem) {
+  uop_begin(z, u);
+  z->a = rb(z, u->nn);
+  MEMPTR(z->mem_ptr = u->nn + 1);
+}
+
+UOP(uop_ld_mem_a) {
+  uop_begin(z, u);
+  wb(z, u->nn, z->a);
+  MEMPTR(z->mem_ptr = (z->a << 8) | ((u->nn + 1) & 0xFF));
+}
+
+UOP(uop_ld_hl_mem) {
+  uop_begin(z, u);
+  set_hl(z, rw(z, u->nn));
+  MEMPTR(z->mem_ptr = u->nn + 1);
+}
+
+UOP(uop_ld_mem_hl) {
+  uop_begin(z, u);
+  ww(z, u->nn, get_hl(z));
+  MEMPTR(z->mem_ptr = u->nn + 1);
+}
+
+UOP(uop_ex_de_hl) {
+  uop_begin(z, u);
+  const uint16_t de = get_de(z);
+  set_de(z, get_hl(z));
+  set_hl(z, de);
+}
+
+// branches end their block and always set pc; nn is the target
+UOP(uop_jp) {
+  uop_begin(z, u);
+  jump(z, u->nn);
+}
+
+UOP(uop_jr) {
+  uop_begin(z, u);
+  z->pc = u->nn;
+}
+
+UOP(uop_djnz) {
+  uop_begin(z, u);
+  z->pc = NEXT_PC;
+  if (--z->b != 0) {
+    jump(z, u->nn);
+    z->cyc += 5;
+  }
+}
+
+UOP(uop_call) {
+  uop_begin(z, u);
+  z->pc = NEXT_PC;
+  call(z, u->nn);
+}
+
+UOP(uop_ret) {
+  uop_begin(z, u);
+  ret(z);
+}
+
+#define COND_UOPS(cc, test) \
+  UOP(uop_jp_##cc) { \
+    uop_begin(z, u); \
+    z->pc = NEXT_PC; \
+    if (test) { \
+      jump(z, u->nn); \
+    } \
+    MEMPTR(z->mem_ptr = u->nn); \
+  } \
+  UOP(uop_call_##cc) { \
+    uop_begin(z, u); \
+    z->pc = NEXT_PC; \
+    if (test) { \
+      call(z, u->nn); \
+      z->cyc += 7; \
+    } \
+    MEMPTR(z->mem_ptr = u->nn); \
+  } \
+  UOP(uop_ret_##cc) { \
+    uop_begin(z, u); \
+    z->pc = NEXT_PC; \
+    if (test) { \
+      ret(z); \
+      z->cyc += 6; \
+    } \
+  }
+
+#define JR_UOP(cc, test) \
+  UOP(uop_jr_##cc) { \
+    uop_begin(z, u); \
+    z->pc = NEXT_PC; \
+    if (test) { \
+      jump(z, u->nn); \
+      z->cyc += 5; \
+    } \
+  }
+
+COND_UOPS(nz, z->zf == 0)
+COND_UOPS(z, z->zf == 1)
+COND_UOPS(nc, z->cf == 0)
+COND_UOPS(c, z->cf == 1)
+COND_UOPS(po, z->pf == 0)
+COND_UOPS(pe, z->pf == 1)
+COND_UOPS(p, z->sf == 0)
+COND_UOPS(m, z->sf == 1)
+JR_UOP(nz, z->zf == 0)
+JR_UOP(z, z->zf == 1)
+JR_UOP(nc, z->cf == 0)
+JR_UOP(c, z->cf == 1)
+
+// by the condition code in bits 3-5 of the opcode
+static const z80_uop_fn uop_jp_cc[8] = {uop_jp_nz, uop_jp_z, uop_jp_nc,
+    uop_jp_c, uop_jp_po, uop_jp_pe, uop_jp_p, uop_jp_m};
+static const z80_uop_fn uop_call_cc[8] = {uop_call_nz, uop_call_z,
+    uop_call_nc, uop_call_c, uop_call_po, uop_call_pe, uop_call_p, uop_call_m};
+static const z80_uop_fn uop_ret_cc[8] = {uop_ret_nz, uop_ret_z, uop_ret_nc,
+    uop_ret_c, uop_ret_po, uop_ret_pe, uop_ret_p, uop_ret_m};
+static const z80_uop_fn uop_jr_cc[4] = {uop_jr_nz, uop_jr_z, uop_jr_nc,
+    uop_jr_c};
+
+#undef UOP
+#undef REG
+#undef PAIR
+#undef NEXT_PC
+
+// length of a non-prefixed instruction
+static int base_len(uint8_t op) {
+  switch (op) {
+  case 0x01: case 0x11: case 0x21: case 0x31: // ld rr,**
+  case 0x22: case 0x2A: case 0x32: case 0x3A: // ld (**),hl/a and back
+  case 0xC3: case 0xCD: return 3;
+  case 0x10: case 0x18: case 0x20: case 0x28: case 0x30: case 0x38: // jr
+  case 0xD3: case 0xDB: case 0xCB: return 2;
+  }
+  if ((op & 0xC7) == 0xC2 || (op & 0xC7) == 0xC4) {
+    return 3; // jp cc / call cc
+  }
+  if ((op & 0xC7) == 0x06 || (op & 0xC7) == 0xC6) {
+    return 2; // ld r,* / alu *
+  }
+  return 1;
+}
+
+// non-prefixed instructions that end a block: branches, halt and ei
+static bool base_ends(uint8_t op) {
+  switch (op) {
+  case 0x10: case 0x18: case 0x20: case 0x28: case 0x30: case 0x38:
+  case 0x76: case 0xC3: case 0xC9: case 0xCD: case 0xE9: case 0xFB:
+    return true;
+  }
+  // ret cc, jp cc, call cc, rst
+  return (op & 0xC7) == 0xC0 || (op & 0xC7) == 0xC2 ||
+         (op & 0xC7) == 0xC4 || (op & 0xC7) == 0xC7;
+}
+
+// picks the handler of a non-prefixed instruction (c = its bytes). u->nn
+// already holds the word after the opcode.
+static void specialise(z80_uop* const u, const uint8_t* const c) {
+  const uint8_t op = c[0];
+  const int y = (op >> 3) & 7, p = (op >> 4) & 3;
+  const uint8_t hi = reg_offset[2 * p], lo = reg_offset[2 * p + 1];
+
+  if ((op & 0xE7) == 0x20 || op == 0x10 || op == 0x18) { // jr, djnz
+    u->nn = u->pc + 2 + (int8_t) c[1];
+  }
+  if (op >= 0x40 && op < 0x80 && op != 0x76) { // ld r,r
+    u->fn = (op & 7) == 6 ? uop_ld_r_hl : y == 6 ? uop_ld_hl_r : uop_ld_r_r;
+    u->r1 = reg_offset[y];
+    u->r2 = reg_offset[op & 7];
+  } else if (op >= 0x80 && op < 0xC0) { // alu a,r
+    u->fn = (op & 7) == 6 ? uop_alu_hl[y] : uop_alu_r[y];
+    u->r2 = reg_offset[op & 7];
+  } else if ((op & 0xC7) == 0xC6) { // alu a,*
+    u->fn = uop_alu_n[y];
+    u->r2 = c[1];
+  } else if ((op & 0xC7) == 0x06) { // ld r,*
+    u->fn = y == 6 ? uop_ld_hl_n : uop_ld_r_n;
+    u->r1 = reg_offset[y];
+    u->r2 = c[1];
+  } else if ((op & 0xC7) == 0x04 || (op & 0xC7) == 0x05) { // inc/dec r
+    if (y != 6) {
+      u->fn = (op & 1) ? uop_dec_r : uop_inc_r;
+      u->r1 = reg_offset[y];
+    }
+  } else if ((op & 0xC7) == 0xC2) {
+    u->fn = uop_jp_cc[y];
+  } else if ((op & 0xC7) == 0xC4) {
+    u->fn = uop_call_cc[y];
+  } else if ((op & 0xC7) == 0xC0) {
+    u->fn = uop_ret_cc[y];
+  } else if ((op & 0xC7) == 0xC7) { // rst
+    u->fn = uop_call;
+    u->nn = op & 0x38;
+  } else if ((op & 0xE7) == 0x20) {
+    u->fn = uop_jr_cc[y & 3];
+  } else {
+    // 16-bit operations name their register pair in bits 4-5
+    u->r1 = hi;
+    u->r2 = lo;
+    switch (op) {
+    case 0x01: case 0x11: case 0x21: u->fn = uop_ld_rr_nn; break;
+    case 0x03: case 0x13: case 0x23: u->fn = uop_inc_rr; break;
+    case 0x0B: case 0x1B: case 0x2B: u->fn = uop_dec_rr; break;
+    case 0xC5: case 0xD5: case 0xE5: u->fn = uop_push_rr; break;
+    case 0xC1: case 0xD1: case 0xE1: u->fn = uop_pop_rr; break;
+    case 0x0A: case 0x1A: u->fn = uop_ld_a_rr; break;
+    case 0x02: case 0x12: u->fn = uop_ld_rr_a; break;
+    case 0x31: u->fn = uop_ld_sp_nn; break;
+    case 0x33: u->fn = uop_inc_sp; break;
+    case 0x3B: u->fn = uop_dec_sp; break;
+    case 0xF5: u->fn = uop_push_af; break;
+    case 0xF1: u->fn = uop_pop_af; break;
+    case 0x00: u->fn = uop_nop; break;
+    case 0x3A: u->fn = uop_ld_a_mem; break;
+    case 0x32: u->fn = uop_ld_mem_a; break;
+    case 0x2A: u->fn = uop_ld_hl_mem; break;
+    case 0x22: u->fn = uop_ld_mem_hl; break;
+    case 0xEB: u->fn = uop_ex_de_hl; break;
+    case 0xC3: u->fn = uop_jp; break;
+    case 0xCD: u->fn = uop_call; break;
+    case 0xC9: u->fn = uop_ret; break;
+    case 0x18: u->fn = uop_jr; break;
+    case 0x10: u->fn = uop_djnz; break;
+    }
+  }
+}
+
+// decodes the instruction at "pc" into "u" and returns its length, or 0 if
+// it can't be part of a block (prefix chains, which the interpreter runs as
+// one instruction of any length). sets "ends" if it must end its block and
+// "max_cyc" to the most t-states it can take.
+static int decode(z80* const z, uint16_t pc, z80_uop* const u,
+    bool* const ends, int* const max_cyc) {
+  uint8_t c[4];
+  for (int i = 0; i < 4; i++) {
+    c[i] = rb(z, pc + i);
+  }
+  u->fn = uop_interp;
+  u->pc = pc;
+  u->nn = c[1] | c[2] << 8;
+  u->r1 = 0;
+  u->r2 = 0;
+  u->cyc = z80_cyc_00[c[0]];
+
+  int len;
+  switch (c[0]) {
+  case 0xCB:
+    len = 2;
+    *ends = false;
+    *max_cyc = 23;
+    u->fn = uop_cb;
+    u->r2 = c[1];
+    break;
+  case 0xED:
+    len = (c[1] & 0xC7) == 0x43 ? 4 : 2; // ld (**),rr / ld rr,(**)
+    // retn/reti, and the repeating block instructions
+    *ends = (c[1] & 0xC7) == 0x45 || (c[1] & 0xF4) == 0xB0;
+    *max_cyc = z80_cyc_ed[c[1]] + 5;
+    u->fn = uop_ed;
+    u->r2 = c[1];
+    break;
+  case 0xDD:
+  case 0xFD:
+    if (c[1] == 0xDD || c[1] == 0xFD || c[1] == 0xED) {
+      return 0;
+    }
+    u->r1 = c[0] == 0xFD;
+    if (c[1] == 0xCB) {
+      len = 4;
+      *ends = false;
+      *max_cyc = 32;
+      u->fn = uop_ddcb;
+      u->nn = c[2];
+      u->r2 = c[3];
+    } else {
+      u->fn = uop_ddfd;
+      u->r2 = c[1];
+      len = 1 + base_len(c[1]) + (z80_hl_operand[c[1]] == Z80_HL_MEM);
+      *ends = base_ends(c[1]);
+      *max_cyc = z80_cyc_ddfd[c[1]] + z80_cyc_00[c[1]] + 7;
+    }
+    break;
+  default:
+    len = base_len(c[0]);
+    *ends = base_ends(c[0]);
+    *max_cyc = u->cyc + 7;
+    specialise(u, c);
+    break;
+  }
+  u->len = len;
+  return len;
+}
+
+static const z80_block* translate(
+    z80* const z, z80_blocks* const bs, uint16_t pc) {
+  // a retired block is decoded again in place; new ones take a free slot
+  if (bs->index[pc] == 0 && bs->used == BLOCK_POOL) {
+    z80_blocks_flush(bs);
+  }
+  const int slot = bs->index[pc] ? bs->index[pc] - 1 : bs->used;
+  z80_block* const b = &bs->pool[slot];
+  unsigned addr = pc;
+  int n = 0, cyc = 0;
+  bool ends = false;
+  while (n < BLOCK_MAX_OPS && !ends) {
+    bool op_ends;
+    int op_cyc;
+    const int len = decode(z, addr, &b->ops[n], &op_ends, &op_cyc);
+    if (len == 0 || addr + len > 0x10000) {
+      break; // don't wrap around the address space either
+    }
+    ends = op_ends;
+    cyc += op_cyc;
+    addr += len;
+    n += 1;
+  }
+  if (n == 0) {
+    return NULL; // (a retired block left in its slot stays retired)
+  }
+
+  b->end = addr;
+  b->max_cyc = cyc;
+  b->nops = n;
+  b->branch = ends;
+  // a lone ed instruction ends its block: retn/reti, or a repeating one
+  b->fast = n > 1 || (b->ops[0].fn != uop_interp && b->ops[0].fn != uop_ed);
+  b->page[0] = pc >> 8;
+  b->page[1] = (addr - 1) >> 8; // at most 128 bytes: one page or two
+  for (int i = 0; i < 2; i++) {
+    b->gen[i] = bs->gen[b->page[i]];
+    bs->code[b->page[i]] = true;
+  }
+  if (slot == bs->used) {
+    bs->used += 1;
+  }
+  bs->index[pc] = slot + 1;
+  bs->stats.translated += 1;
+  return b;
+}
+
+static inline const z80_block* block_at(
+    z80* const z, z80_blocks* const bs, uint16_t pc) {
+  const uint16_t slot = bs->index[pc];
+  if (slot) {
+    const z80_block* const b = &bs->pool[slot - 1];
+    if (b->gen[0] == bs->gen[b->page[0]] && b->gen[1] == bs->gen[b->page[1]]) {
+      return b;
+    }
+  }
+  return translate(z, bs, pc);
+}
+
+// runs a block to its end, or up to a write to code (which may be its own)
+static void run_block(
+    z80* const z, z80_blocks* const bs, const z80_block* const b) {
+  const z80_uop* u = b->ops;
+  const z80_uop* const end = u + b->nops;
+  bs->stale = false;
+  for (;;) {
+    u->fn(z, u);
+    if (++u == end) {
+      if (!b->branch) {
+        z->pc = b->end;
+      }
+      break;
+    }
+    if (bs->stale) {
+      z->pc = u->pc;
+      break;
+    }
+  }
+  bs->stats.runs += 1;
+  bs->stats.insns += u - b->ops;
+  // only the last instruction can have made an interrupt acceptable (ei,
+  // reti/retn): on entry nothing was pending
+  process_interrupts(z);
+}
+
+// a block runs without checking for interrupts, so it is only entered
+// when z80_step would have none to process either
+static inline bool blocks_usable(const z80* const z) {
+#ifdef Z80_PROFILE
+  if (z->profile) {
+    return false; // profiling counts every opcode
+  }
+#endif
+  return !z->halted && z->iff_delay == 0 && !z->nmi_pending &&
+         !(z->int_pending && z->iff1);
+}
+
+static void run(z80* const z, unsigned long until) {
+  z80_blocks* const bs = z->blocks;
+  while ((long) (z->cyc - until) < 0) {
+    if (bs && blocks_usable(z)) {
+      // enter a block only if it ends before "until" even in the worst
+      // case: then z80_step would not have stopped anywhere inside it
+      const uint16_t pc = z->pc;
+      const z80_block* const b = block_at(z, bs, pc);
+      if (b && !b->fast) {
+        // a lone instruction without a handler: as well stepped. keep at
+        // it while it repeats in place (ldir and friends)
+        do {
+          step(z);
+          bs->stats.steps += 1;
+        } while (z->pc == pc && (long) (z->cyc - until) < 0);
+        continue;
+      }
+      if (b && (long) (z->cyc + b->max_cyc - until) <= 0) {
+        run_block(z, bs, b);
+        continue;
+      }
+    }
+    step(z);
+    if (bs) {
+      bs->stats.steps += 1;
+    }
+  }
+}
+
+// MARK: entry points
+// z80_step and z80_run go through the variant the cpu was set to
+const z80_core Z80_CORE_NAME = {step, run};
+
+#if Z80_SHARED
+static const z80_core* const cores[Z80_CORE_VARIANTS] = {
+  [Z80_CORE_EXACT] = &z80_core_exact,
+  [Z80_CORE_FAST] = &z80_core_fast,
+};
+
+void z80_step(z80* const z) {
+  z->core->step(z);
+}
+
+void z80_run(z80* const z, unsigned long until) {
+  z->core->run(z, until);
+}
+
+void z80_set_core(z80* const z, z80_core_variant v) {
+  z->core = cores[v];
+  // cached micro-ops belong to the variant that decoded them
+  z80_blocks_flush(z->blocks);
+  z80_icache_flush(z->icache);
+}
+
+z80_blocks* z80_blocks_new(void) {
+  return calloc(1, sizeof(z80_blocks));
+}
+
+void z80_blocks_free(z80_blocks* const bs) {
+  free(bs);
+}
+
+void z80_blocks_flush(z80_blocks* const bs) {
+  if (!bs) {
+    return;
+  }
+  memset(bs->index, 0, sizeof(bs->index));
+  memset(bs->code, 0, sizeof(bs->code));
+  bs->used = 0;
+  bs->stats.flushes += 1;
+}
+
+void z80_blocks_forget(z80_blocks* const bs, uint16_t start, uint32_t len) {
+  if (!bs) {
+    return;
+  }
+  const uint32_t end = start + len < 0x10000 ? start + len : 0x10000;
+  for (uint32_t page = start >> 8; page << 8 < end; page++) {
+    if (bs->code[page]) {
+      bs->code[page] = false;
+      bs->gen[page] += 1;
+      bs->stale = true; // may be the running block's (a switch from within)
+      bs->stats.invalidated += 1;
+    }
+  }
+}
+
+const z80_block_stats* z80_blocks_stats(const z80_blocks* const bs) {
+  return &bs->stats;
+}
+#endif // Z80_SHARED
+
+static const z80_uop* icache_fill(
+    z80* const z, z80_icache* const ic, uint16_t pc) {
+  z80_uop* const u = &ic->ops[pc];
+  bool ends;
+  int max_cyc;
+  const int len = decode(z, pc, u, &ends, &max_cyc);
+  if (len == 0) {
+    // a prefix chain: interpreted from memory each time, so nothing in
+    // the entry can go stale
+    u->fn = uop_interp;
+    u->len = 0;
+  } else {
+    const uint8_t first = pc >> 8, last = (uint16_t) (pc + len - 1) >> 8;
+    ic->code[first] |= !ic->rom[first];
+    ic->code[last] |= !ic->rom[last];
+    ic->filled[first] = ic->filled[last] = true;
+  }
+  ic->stats.decoded += 1;
+  return u;
+}
+
+#if Z80_SHARED
+z80_icache* z80_icache_new(void) {
+  return calloc(1, sizeof(z80_icache));
+}
+
+void z80_icache_free(z80_icache* const ic) {
+  free(ic);
+}
+
+void z80_icache_flush(z80_icache* const ic) {
+  if (!ic) {
+    return;
+  }
+  for (int i = 0; i < 65536; i++) {
+    ic->ops[i].fn = NULL;
+  }
+  memset(ic->code, 0, sizeof(ic->code));
+  memset(ic->filled, 0, sizeof(ic->filled));
+  ic->stats.flushes += 1;
+}
+
+void z80_icache_forget(z80_icache* const ic, uint16_t start, uint32_t len) {
+  if (!ic) {
+    return;
+  }
+  const uint32_t end = start + len < 0x10000 ? start + len : 0x10000;
+  for (uint32_t page = start >> 8; page << 8 < end; page++) {
+    if (ic->filled[page]) {
+      // an instruction ending on this page may start on the one before
+      for (int a = (int) (page << 8) - 3; a < (int) (page + 1) << 8; a++) {
+        ic->ops[(uint16_t) a].fn = NULL;
+      }
+      ic->filled[page] = false;
+      ic->code[page] = false;
+    }
+  }
+}
+
+void z80_icache_set_rom(z80_icache* const ic, uint16_t start, uint32_t len) {
+  const uint32_t end = start + len < 0x10000 ? start + len : 0x10000;
+  for (uint32_t page = start >> 8; page << 8 < end; page++) {
+    ic->rom[page] = true;
+    ic->code[page] = false;
+  }
+}
+
+const z80_decode_stats* z80_icache_stats(const z80_icache* const ic) {
+  return &ic->stats;
+}
+#endif // Z80_SHARED
 
 // executes a non-prefixed opcode
 void exec_opcode(z80* const z, uint8_t opcode) {
-  z->cyc += cyc_00[opcode];
+  PROF_OP(Z80_PROF_BASE, opcode);
+  z->cyc += z80_cyc_00[opcode];
   inc_r(z);
 
   switch (opcode) {
@@ -881,32 +1952,32 @@ void exec_opcode(z80* const z, uint8_t opcode) {
 
   case 0x0A:
     z->a = rb(z, get_bc(z));
-    z->mem_ptr = get_bc(z) + 1;
+    MEMPTR(z->mem_ptr = get_bc(z) + 1);
     break; // ld a,(bc)
   case 0x1A:
     z->a = rb(z, get_de(z));
-    z->mem_ptr = get_de(z) + 1;
+    MEMPTR(z->mem_ptr = get_de(z) + 1);
     break; // ld a,(de)
   case 0x3A: {
     const uint16_t addr = nextw(z);
     z->a = rb(z, addr);
-    z->mem_ptr = addr + 1;
+    MEMPTR(z->mem_ptr = addr + 1);
   } break; // ld a,(**)
 
   case 0x02:
     wb(z, get_bc(z), z->a);
-    z->mem_ptr = (z->a << 8) | ((get_bc(z) + 1) & 0xFF);
+    MEMPTR(z->mem_ptr = (z->a << 8) | ((get_bc(z) + 1) & 0xFF));
     break; // ld (bc),a
 
   case 0x12:
     wb(z, get_de(z), z->a);
-    z->mem_ptr = (z->a << 8) | ((get_de(z) + 1) & 0xFF);
+    MEMPTR(z->mem_ptr = (z->a << 8) | ((get_de(z) + 1) & 0xFF));
     break; // ld (de),a
 
   case 0x32: {
     const uint16_t addr = nextw(z);
     wb(z, addr, z->a);
-    z->mem_ptr = (z->a << 8) | ((addr + 1) & 0xFF);
+    MEMPTR(z->mem_ptr = (z->a << 8) | ((addr + 1) & 0xFF));
   } break; // ld (**),a
 
   case 0x01: set_bc(z, nextw(z)); break; // ld bc,**
@@ -917,13 +1988,13 @@ void exec_opcode(z80* const z, uint8_t opcode) {
   case 0x2A: {
     const uint16_t addr = nextw(z);
     set_hl(z, rw(z, addr));
-    z->mem_ptr = addr + 1;
+    MEMPTR(z->mem_ptr = addr + 1);
   } break; // ld hl,(**)
 
   case 0x22: {
     const uint16_t addr = nextw(z);
     ww(z, addr, get_hl(z));
-    z->mem_ptr = addr + 1;
+    MEMPTR(z->mem_ptr = addr + 1);
   } break; // ld (**),hl
 
   case 0xF9: z->sp = get_hl(z); break; // ld sp,hl
@@ -938,7 +2009,7 @@ void exec_opcode(z80* const z, uint8_t opcode) {
     const uint16_t val = rw(z, z->sp);
     ww(z, z->sp, get_hl(z));
     set_hl(z, val);
-    z->mem_ptr = val;
+    MEMPTR(z->mem_ptr = val);
   } break; // ex (sp),hl
 
   case 0x87: z->a = addb(z, z->a, z->a, 0); break; // add a,a
@@ -1034,24 +2105,24 @@ void exec_opcode(z80* const z, uint8_t opcode) {
     z->a = ~z->a;
     z->nf = 1;
     z->hf = 1;
-    z->xf = GET_BIT(3, z->a);
-    z->yf = GET_BIT(5, z->a);
+    XY(z->xf = GET_BIT(3, z->a));
+    XY(z->yf = GET_BIT(5, z->a));
     break; // cpl
 
   case 0x37:
     z->cf = 1;
     z->nf = 0;
     z->hf = 0;
-    z->xf = GET_BIT(3, z->a);
-    z->yf = GET_BIT(5, z->a);
+    XY(z->xf = GET_BIT(3, z->a));
+    XY(z->yf = GET_BIT(5, z->a));
     break; // scf
 
   case 0x3F:
     z->hf = z->cf;
     z->cf = !z->cf;
     z->nf = 0;
-    z->xf = GET_BIT(3, z->a);
-    z->yf = GET_BIT(5, z->a);
+    XY(z->xf = GET_BIT(3, z->a));
+    XY(z->yf = GET_BIT(5, z->a));
     break; // ccf
 
   case 0x07: {
@@ -1059,8 +2130,8 @@ void exec_opcode(z80* const z, uint8_t opcode) {
     z->a = (z->a << 1) | z->cf;
     z->nf = 0;
     z->hf = 0;
-    z->xf = GET_BIT(3, z->a);
-    z->yf = GET_BIT(5, z->a);
+    XY(z->xf = GET_BIT(3, z->a));
+    XY(z->yf = GET_BIT(5, z->a));
   } break; // rlca (rotate left)
 
   case 0x0F: {
@@ -1068,8 +2139,8 @@ void exec_opcode(z80* const z, uint8_t opcode) {
     z->a = (z->a >> 1) | (z->cf << 7);
     z->nf = 0;
     z->hf = 0;
-    z->xf = GET_BIT(3, z->a);
-    z->yf = GET_BIT(5, z->a);
+    XY(z->xf = GET_BIT(3, z->a));
+    XY(z->yf = GET_BIT(5, z->a));
   } break; // rrca (rotate right)
 
   case 0x17: {
@@ -1078,8 +2149,8 @@ void exec_opcode(z80* const z, uint8_t opcode) {
     z->a = (z->a << 1) | cy;
     z->nf = 0;
     z->hf = 0;
-    z->xf = GET_BIT(3, z->a);
-    z->yf = GET_BIT(5, z->a);
+    XY(z->xf = GET_BIT(3, z->a));
+    XY(z->yf = GET_BIT(5, z->a));
   } break; // rla
 
   case 0x1F: {
@@ -1088,8 +2159,8 @@ void exec_opcode(z80* const z, uint8_t opcode) {
     z->a = (z->a >> 1) | (cy << 7);
     z->nf = 0;
     z->hf = 0;
-    z->xf = GET_BIT(3, z->a);
-    z->yf = GET_BIT(5, z->a);
+    XY(z->xf = GET_BIT(3, z->a));
+    XY(z->yf = GET_BIT(5, z->a));
   } break; // rra
 
   case 0xA7: land(z, z->a); break; // and a
@@ -1197,14 +2268,14 @@ void exec_opcode(z80* const z, uint8_t opcode) {
   case 0xDB: {
     const uint8_t port = nextb(z);
     const uint8_t a = z->a;
-    z->a = z->port_in(z, port);
-    z->mem_ptr = (a << 8) | (z->a + 1);
+    z->a = z->port_in(z, (a << 8) | port, z->cyc);
+    MEMPTR(z->mem_ptr = (a << 8) | (z->a + 1));
   } break; // in a,(n)
 
   case 0xD3: {
     const uint8_t port = nextb(z);
-    z->port_out(z, port, z->a);
-    z->mem_ptr = (port + 1) | (z->a << 8);
+    z->port_out(z, (z->a << 8) | port, z->a, z->cyc);
+    MEMPTR(z->mem_ptr = (port + 1) | (z->a << 8));
   } break; // out (n), a
 
   case 0x08: {
@@ -1246,7 +2317,8 @@ void exec_opcode(z80* const z, uint8_t opcode) {
 
 // executes a DD/FD opcode (IZ = IX or IY)
 void exec_opcode_ddfd(z80* const z, uint8_t opcode, uint16_t* const iz) {
-  z->cyc += cyc_ddfd[opcode];
+  PROF_OP(Z80_PROF_DDFD, opcode);
+  z->cyc += z80_cyc_ddfd[opcode];
   inc_r(z);
 
 #define IZD displace(z, *iz, nextb(z))
@@ -1374,7 +2446,7 @@ void exec_opcode_ddfd(z80* const z, uint8_t opcode, uint16_t* const iz) {
     const uint16_t val = rw(z, z->sp);
     ww(z, z->sp, *iz);
     *iz = val;
-    z->mem_ptr = val;
+    MEMPTR(z->mem_ptr = val);
   } break; // ex (sp),iz
 
   case 0xCB: {
@@ -1398,6 +2470,7 @@ void exec_opcode_ddfd(z80* const z, uint8_t opcode, uint16_t* const iz) {
 
 // executes a CB opcode
 void exec_opcode_cb(z80* const z, uint8_t opcode) {
+  PROF_OP(Z80_PROF_CB, opcode);
   z->cyc += 8;
   inc_r(z);
 
@@ -1440,8 +2513,8 @@ void exec_opcode_cb(z80* const z, uint8_t opcode) {
 
     // in bit (hl), x/y flags are handled differently:
     if (z_ == 6) {
-      z->yf = GET_BIT(5, z->mem_ptr >> 8);
-      z->xf = GET_BIT(3, z->mem_ptr >> 8);
+      XY(z->yf = GET_BIT(5, z->mem_ptr >> 8));
+      XY(z->xf = GET_BIT(3, z->mem_ptr >> 8));
       z->cyc += 4;
     }
   } break;
@@ -1460,6 +2533,7 @@ void exec_opcode_cb(z80* const z, uint8_t opcode) {
 
 // executes a displaced CB opcode (DDCB or FDCB)
 void exec_opcode_dcb(z80* const z, uint8_t opcode, uint16_t addr) {
+  PROF_OP(Z80_PROF_DDCB, opcode);
   uint8_t val = rb(z, addr);
   uint8_t result = 0;
 
@@ -1484,8 +2558,8 @@ void exec_opcode_dcb(z80* const z, uint8_t opcode, uint16_t addr) {
   } break;
   case 1: {
     result = cb_bit(z, val, y_);
-    z->yf = GET_BIT(5, addr >> 8);
-    z->xf = GET_BIT(3, addr >> 8);
+    XY(z->yf = GET_BIT(5, addr >> 8));
+    XY(z->xf = GET_BIT(3, addr >> 8));
   } break; // bit y,(iz+d)
   case 2: result = val & ~(1 << y_); break; // res y, (iz+d)
   case 3: result = val | (1 << y_); break; // set y, (iz+d)
@@ -1520,7 +2594,8 @@ void exec_opcode_dcb(z80* const z, uint8_t opcode, uint16_t addr) {
 
 // executes a ED opcode
 void exec_opcode_ed(z80* const z, uint8_t opcode) {
-  z->cyc += cyc_ed[opcode];
+  PROF_OP(Z80_PROF_ED, opcode);
+  z->cyc += z80_cyc_ed[opcode];
   inc_r(z);
   switch (opcode) {
   case 0x47: z->i = z->a; break; // ld i,a
@@ -1563,7 +2638,7 @@ void exec_opcode_ed(z80* const z, uint8_t opcode) {
     if (get_bc(z) != 0) {
       z->pc -= 2;
       z->cyc += 5;
-      z->mem_ptr = z->pc + 1;
+      MEMPTR(z->mem_ptr = z->pc + 1);
     }
   } break; // ldir
 
@@ -1574,7 +2649,7 @@ void exec_opcode_ed(z80* const z, uint8_t opcode) {
     if (get_bc(z) != 0) {
       z->pc -= 2;
       z->cyc += 5;
-      z->mem_ptr = z->pc + 1;
+      MEMPTR(z->mem_ptr = z->pc + 1);
     }
   } break; // lddr
 
@@ -1585,9 +2660,9 @@ void exec_opcode_ed(z80* const z, uint8_t opcode) {
     if (get_bc(z) != 0 && !z->zf) {
       z->pc -= 2;
       z->cyc += 5;
-      z->mem_ptr = z->pc + 1;
+      MEMPTR(z->mem_ptr = z->pc + 1);
     } else {
-      z->mem_ptr += 1;
+      MEMPTR(z->mem_ptr += 1);
     }
   } break; // cpir
   case 0xB9: {
@@ -1596,7 +2671,7 @@ void exec_opcode_ed(z80* const z, uint8_t opcode) {
       z->pc -= 2;
       z->cyc += 5;
     } else {
-      z->mem_ptr += 1;
+      MEMPTR(z->mem_ptr += 1);
     }
   } break; // cpdr
 
@@ -1612,7 +2687,7 @@ void exec_opcode_ed(z80* const z, uint8_t opcode) {
   } break; // in (c)
   case 0x78:
     in_r_c(z, &z->a);
-    z->mem_ptr = get_bc(z) + 1;
+    MEMPTR(z->mem_ptr = get_bc(z) + 1);
     break; // in a, (c)
 
   case 0xA2: ini(z); break; // ini
@@ -1632,16 +2707,16 @@ void exec_opcode_ed(z80* const z, uint8_t opcode) {
     }
     break; // indr
 
-  case 0x41: z->port_out(z, z->c, z->b); break; // out (c), b
-  case 0x49: z->port_out(z, z->c, z->c); break; // out (c), c
-  case 0x51: z->port_out(z, z->c, z->d); break; // out (c), d
-  case 0x59: z->port_out(z, z->c, z->e); break; // out (c), e
-  case 0x61: z->port_out(z, z->c, z->h); break; // out (c), h
-  case 0x69: z->port_out(z, z->c, z->l); break; // out (c), l
-  case 0x71: z->port_out(z, z->c, 0); break; // out (c), 0
+  case 0x41: z->port_out(z, get_bc(z), z->b, z->cyc); break; // out (c), b
+  case 0x49: z->port_out(z, get_bc(z), z->c, z->cyc); break; // out (c), c
+  case 0x51: z->port_out(z, get_bc(z), z->d, z->cyc); break; // out (c), d
+  case 0x59: z->port_out(z, get_bc(z), z->e, z->cyc); break; // out (c), e
+  case 0x61: z->port_out(z, get_bc(z), z->h, z->cyc); break; // out (c), h
+  case 0x69: z->port_out(z, get_bc(z), z->l, z->cyc); break; // out (c), l
+  case 0x71: z->port_out(z, get_bc(z), 0, z->cyc); break; // out (c), 0
   case 0x79:
-    z->port_out(z, z->c, z->a);
-    z->mem_ptr = get_bc(z) + 1;
+    z->port_out(z, get_bc(z), z->a, z->cyc);
+    MEMPTR(z->mem_ptr = get_bc(z) + 1);
     break; // out (c), a
 
   case 0xA3: outi(z); break; // outi
@@ -1673,49 +2748,49 @@ void exec_opcode_ed(z80* const z, uint8_t opcode) {
   case 0x43: {
     const uint16_t addr = nextw(z);
     ww(z, addr, get_bc(z));
-    z->mem_ptr = addr + 1;
+    MEMPTR(z->mem_ptr = addr + 1);
   } break; // ld (**), bc
 
   case 0x53: {
     const uint16_t addr = nextw(z);
     ww(z, addr, get_de(z));
-    z->mem_ptr = addr + 1;
+    MEMPTR(z->mem_ptr = addr + 1);
   } break; // ld (**), de
 
   case 0x63: {
     const uint16_t addr = nextw(z);
     ww(z, addr, get_hl(z));
-    z->mem_ptr = addr + 1;
+    MEMPTR(z->mem_ptr = addr + 1);
   } break; // ld (**), hl
 
   case 0x73: {
     const uint16_t addr = nextw(z);
     ww(z, addr, z->sp);
-    z->mem_ptr = addr + 1;
+    MEMPTR(z->mem_ptr = addr + 1);
   } break; // ld (**),sp
 
   case 0x4B: {
     const uint16_t addr = nextw(z);
     set_bc(z, rw(z, addr));
-    z->mem_ptr = addr + 1;
+    MEMPTR(z->mem_ptr = addr + 1);
   } break; // ld bc, (**)
 
   case 0x5B: {
     const uint16_t addr = nextw(z);
     set_de(z, rw(z, addr));
-    z->mem_ptr = addr + 1;
+    MEMPTR(z->mem_ptr = addr + 1);
   } break; // ld de, (**)
 
   case 0x6B: {
     const uint16_t addr = nextw(z);
     set_hl(z, rw(z, addr));
-    z->mem_ptr = addr + 1;
+    MEMPTR(z->mem_ptr = addr + 1);
   } break; // ld hl, (**)
 
   case 0x7B: {
     const uint16_t addr = nextw(z);
     z->sp = rw(z, addr);
-    z->mem_ptr = addr + 1;
+    MEMPTR(z->mem_ptr = addr + 1);
   } break; // ld sp,(**)
 
   case 0x44:
@@ -1742,12 +2817,12 @@ void exec_opcode_ed(z80* const z, uint8_t opcode) {
 
     z->nf = 0;
     z->hf = 0;
-    z->xf = GET_BIT(3, z->a);
-    z->yf = GET_BIT(5, z->a);
+    XY(z->xf = GET_BIT(3, z->a));
+    XY(z->yf = GET_BIT(5, z->a));
     z->zf = z->a == 0;
     z->sf = z->a >> 7;
     z->pf = parity(z->a);
-    z->mem_ptr = get_hl(z) + 1;
+    MEMPTR(z->mem_ptr = get_hl(z) + 1);
   } break; // rrd
 
   case 0x6F: {
@@ -1758,12 +2833,12 @@ void exec_opcode_ed(z80* const z, uint8_t opcode) {
 
     z->nf = 0;
     z->hf = 0;
-    z->xf = GET_BIT(3, z->a);
-    z->yf = GET_BIT(5, z->a);
+    XY(z->xf = GET_BIT(3, z->a));
+    XY(z->yf = GET_BIT(5, z->a));
     z->zf = z->a == 0;
     z->sf = z->a >> 7;
     z->pf = parity(z->a);
-    z->mem_ptr = get_hl(z) + 1;
+    MEMPTR(z->mem_ptr = get_hl(z) + 1);
   } break; // rld
 
   default: fprintf(stderr, "unknown ED opcode: %02X\n", opcode); break;
@@ -5,12 +5,43 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+// opcode profiler (build with -DZ80_PROFILE; compiled out otherwise).
+// counts executions and t-states per opcode of each table, and host time
+// per table (rdtsc on x86). attach with z80.profile = &p. the struct z80
+// fields are there in every build, so code built with and without the
+// flag agrees on its layout; only the profiler itself is compiled out.
+typedef struct z80_profile z80_profile;
+
+#ifdef Z80_PROFILE
+enum {
+  Z80_PROF_BASE, Z80_PROF_CB, Z80_PROF_ED, Z80_PROF_DDFD, Z80_PROF_DDCB,
+  Z80_PROF_TABLES
+};
+
+struct z80_profile {
+  uint64_t count[Z80_PROF_TABLES][256];
+  uint64_t cycles[Z80_PROF_TABLES][256];
+  uint64_t ticks[Z80_PROF_TABLES]; // host ticks spent per table
+  uint64_t tick_start; // for converting ticks to nanoseconds
+  double wall_start;
+};
+#endif
+
+// translation cache (block tier), see z80_run. opaque, lives in z80.c.
+typedef struct z80_blocks z80_blocks;
+// decoded instruction per address (interpreter), see z80_icache_new.
+typedef struct z80_icache z80_icache;
+// compiled variant of the interpreter, see z80_set_core.
+typedef struct z80_core z80_core;
+
 typedef struct z80 z80;
 struct z80 {
   uint8_t (*read_byte)(void*, uint16_t);
   void (*write_byte)(void*, uint16_t, uint8_t);
-  uint8_t (*port_in)(z80*, uint8_t);
-  void (*port_out)(z80*, uint8_t, uint8_t);
+  // port: the full address bus (a or b in the high byte, as the instruction
+  // sets it). cyc: z->cyc at the access, the instruction's t-states included
+  uint8_t (*port_in)(z80*, uint16_t port, unsigned long cyc);
+  void (*port_out)(z80*, uint16_t port, uint8_t val, unsigned long cyc);
   void* userdata;
 
   unsigned long cyc; // cycle count (t-states)
@@ -30,12 +61,114 @@ struct z80 {
   bool iff1 : 1, iff2 : 1;
   bool halted : 1;
   bool int_pending : 1, nmi_pending : 1;
+
+  z80_blocks* blocks; // NULL = z80_run interprets every instruction
+  z80_icache* icache; // NULL = z80_step decodes from memory every time
+  const z80_core* core; // what z80_step and z80_run run (z80_set_core)
+
+  z80_profile* profile; // NULL = not profiling (always without Z80_PROFILE)
+  uint8_t prof_table, prof_op; // last opcode decoded
 };
 
+// base t-states per opcode (conditional/repeat extras are added at run time).
+// shared with the disassembler (z80dis.h).
+extern const uint8_t z80_cyc_00[256];
+extern const uint8_t z80_cyc_ed[256];
+extern const uint8_t z80_cyc_ddfd[256];
+
+// what a dd/fd prefix does to each base opcode. the block decoder sizes
+// (iz+d) instructions with it, the disassembler names the operands.
+enum {
+  Z80_HL_NONE, // hl not involved: the prefix is ignored
+  Z80_HL_PAIR, // hl -> iz
+  Z80_HL_MEM, // (hl) -> (iz+d), one more byte; h and l stay
+  Z80_HL_BYTE, // h, l -> izh, izl
+};
+extern const uint8_t z80_hl_operand[256];
+
 void z80_init(z80* const z);
 void z80_step(z80* const z);
 void z80_debug_output(z80* const z);
+uint8_t z80_get_f(z80* const z);
+void z80_set_f(z80* const z, uint8_t val);
 void z80_gen_nmi(z80* const z);
 void z80_gen_int(z80* const z, uint8_t data);
 
+// MARK: core variants
+// the interpreter is compiled once per variant, each without the features
+// it leaves out, so they cost no run-time tests:
+//   Z80_CORE_EXACT  memptr (the hidden wz register), the undocumented xf/yf
+//                   flags and r register updates. the default after
+//                   z80_init; what the conformance tests check.
+//   Z80_CORE_FAST   architectural behaviour only: mem_ptr, xf/yf and r keep
+//                   whatever they were last set to (by z80_init, pop af,
+//                   ld r,a...).
+// t-states are exact in both. other mixes are one file away: see
+// z80_fast.c. switching flushes the block and decode caches.
+typedef enum z80_core_variant {
+  Z80_CORE_EXACT,
+  Z80_CORE_FAST,
+  Z80_CORE_VARIANTS
+} z80_core_variant;
+
+void z80_set_core(z80* const z, z80_core_variant v);
+
+// MARK: block tier
+// z80_run can replay straight-line code from a cache of pre-decoded blocks
+// (attach one with z.blocks = z80_blocks_new()). the interpreter stays the
+// reference: blocks only run where their result is identical, and stop at
+// the same instruction boundary z80_step would.
+typedef struct z80_block_stats {
+  uint64_t runs; // blocks executed
+  uint64_t insns; // instructions executed inside blocks
+  uint64_t steps; // instructions z80_run left to the interpreter
+  uint64_t translated; // blocks decoded
+  uint64_t invalidated; // code pages retired by writes
+  uint64_t flushes; // whole cache dropped (full, or z80_blocks_flush)
+} z80_block_stats;
+
+// steps until cyc reaches "until" (compared by signed difference, so cyc may
+// wrap), stopping at the first instruction boundary at or past it.
+void z80_run(z80* const z, unsigned long until);
+
+z80_blocks* z80_blocks_new(void);
+void z80_blocks_free(z80_blocks* const bs);
+// forgets every block. call after writing memory without going through the
+// core (loading a snapshot, a debugger poke...). NULL is ignored.
+void z80_blocks_flush(z80_blocks* const bs);
+// forgets the blocks decoded from the pages of [start, start + len), e.g.
+// after other memory was mapped there (bank switching). NULL is ignored.
+void z80_blocks_forget(z80_blocks* const bs, uint16_t start, uint32_t len);
+const z80_block_stats* z80_blocks_stats(const z80_blocks* const bs);
+
+// MARK: decode cache
+// z80_step can keep the decoded form of the instruction at each address
+// (attach one with z.icache = z80_icache_new()), so running it again skips
+// the opcode fetches, the cycle table lookups and the prefix dispatch.
+// writes through the core retire the entries they overlap. opcode fetches
+// no longer reach read_byte for cached instructions.
+typedef struct z80_decode_stats {
+  uint64_t runs; // instructions run from the cache
+  uint64_t decoded; // entries filled
+  uint64_t retired; // writes that retired entries
+  uint64_t flushes;
+} z80_decode_stats;
+
+z80_icache* z80_icache_new(void);
+void z80_icache_free(z80_icache* const ic);
+// forgets every entry (same rule as z80_blocks_flush). NULL is ignored.
+void z80_icache_flush(z80_icache* const ic);
+// same for the pages of [start, start + len) (z80_blocks_forget). costs
+// nothing for pages nothing was decoded from since.
+void z80_icache_forget(z80_icache* const ic, uint16_t start, uint32_t len);
+// the pages of [start, start + len) never change (rom: the machine drops
+// writes there), so their entries are never retired.
+void z80_icache_set_rom(z80_icache* const ic, uint16_t start, uint32_t len);
+const z80_decode_stats* z80_icache_stats(const z80_icache* const ic);
+
+#ifdef Z80_PROFILE
+void z80_profile_reset(z80_profile* const p);
+void z80_profile_dump(const z80_profile* const p, FILE* f, int top);
+#endif
+
 #endif // Z80_Z80_H_
@@ -0,0 +1,10 @@
+// the fast core variant (z80_set_core): z80.c again, without memptr,
+// undocumented flags and r register updates. a variant with another mix
+// copies this file with its own Z80_CORE_NAME, and gets an entry in
+// z80_core_variant and in the cores table of z80.c.
+#define Z80_CORE_NAME z80_core_fast
+#define Z80_MEMPTR 0
+#define Z80_UNDOC_FLAGS 0
+#define Z80_R_REGISTER 0
+
+#include "z80.c"
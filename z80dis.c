@@ -0,0 +1,288 @@
+#include "z80dis.h"
+#include "z80.h"
+
+// MARK: tables
+// operand markers (upper case, mnemonics are lower case):
+//   N  byte          W  word          R  relative jump target
+// a dd/fd prefix rewrites hl, (hl) or h/l as the core's z80_hl_operand
+// says (z80.h). NULL marks the cb, dd, ed and fd prefixes.
+static const char* const dis_00[256] = {
+  /* 00 */ "nop", "ld bc,W", "ld (bc),a", "inc bc",
+  /* 04 */ "inc b", "dec b", "ld b,N", "rlca",
+  /* 08 */ "ex af,af'", "add hl,bc", "ld a,(bc)", "dec bc",
+  /* 0C */ "inc c", "dec c", "ld c,N", "rrca",
+  /* 10 */ "djnz R", "ld de,W", "ld (de),a", "inc de",
+  /* 14 */ "inc d", "dec d", "ld d,N", "rla",
+  /* 18 */ "jr R", "add hl,de", "ld a,(de)", "dec de",
+  /* 1C */ "inc e", "dec e", "ld e,N", "rra",
+  /* 20 */ "jr nz,R", "ld hl,W", "ld (W),hl", "inc hl",
+  /* 24 */ "inc h", "dec h", "ld h,N", "daa",
+  /* 28 */ "jr z,R", "add hl,hl", "ld hl,(W)", "dec hl",
+  /* 2C */ "inc l", "dec l", "ld l,N", "cpl",
+  /* 30 */ "jr nc,R", "ld sp,W", "ld (W),a", "inc sp",
+  /* 34 */ "inc (hl)", "dec (hl)", "ld (hl),N", "scf",
+  /* 38 */ "jr c,R", "add hl,sp", "ld a,(W)", "dec sp",
+  /* 3C */ "inc a", "dec a", "ld a,N", "ccf",
+  /* 40 */ "ld b,b", "ld b,c", "ld b,d", "ld b,e",
+  /* 44 */ "ld b,h", "ld b,l", "ld b,(hl)", "ld b,a",
+  /* 48 */ "ld c,b", "ld c,c", "ld c,d", "ld c,e",
+  /* 4C */ "ld c,h", "ld c,l", "ld c,(hl)", "ld c,a",
+  /* 50 */ "ld d,b", "ld d,c", "ld d,d", "ld d,e",
+  /* 54 */ "ld d,h", "ld d,l", "ld d,(hl)", "ld d,a",
+  /* 58 */ "ld e,b", "ld e,c", "ld e,d", "ld e,e",
+  /* 5C */ "ld e,h", "ld e,l", "ld e,(hl)", "ld e,a",
+  /* 60 */ "ld h,b", "ld h,c", "ld h,d", "ld h,e",
+  /* 64 */ "ld h,h", "ld h,l", "ld h,(hl)", "ld h,a",
+  /* 68 */ "ld l,b", "ld l,c", "ld l,d", "ld l,e",
+  /* 6C */ "ld l,h", "ld l,l", "ld l,(hl)", "ld l,a",
+  /* 70 */ "ld (hl),b", "ld (hl),c", "ld (hl),d", "ld (hl),e",
+  /* 74 */ "ld (hl),h", "ld (hl),l", "halt", "ld (hl),a",
+  /* 78 */ "ld a,b", "ld a,c", "ld a,d", "ld a,e",
+  /* 7C */ "ld a,h", "ld a,l", "ld a,(hl)", "ld a,a",
+  /* 80 */ "add a,b", "add a,c", "add a,d", "add a,e",
+  /* 84 */ "add a,h", "add a,l", "add a,(hl)", "add a,a",
+  /* 88 */ "adc a,b", "adc a,c", "adc a,d", "adc a,e",
+  /* 8C */ "adc a,h", "adc a,l", "adc a,(hl)", "adc a,a",
+  /* 90 */ "sub b", "sub c", "sub d", "sub e",
+  /* 94 */ "sub h", "sub l", "sub (hl)", "sub a",
+  /* 98 */ "sbc a,b", "sbc a,c", "sbc a,d", "sbc a,e",
+  /* 9C */ "sbc a,h", "sbc a,l", "sbc a,(hl)", "sbc a,a",
+  /* A0 */ "and b", "and c", "and d", "and e",
+  /* A4 */ "and h", "and l", "and (hl)", "and a",
+  /* A8 */ "xor b", "xor c", "xor d", "xor e",
+  /* AC */ "xor h", "xor l", "xor (hl)", "xor a",
+  /* B0 */ "or b", "or c", "or d", "or e",
+  /* B4 */ "or h", "or l", "or (hl)", "or a",
+  /* B8 */ "cp b", "cp c", "cp d", "cp e",
+  /* BC */ "cp h", "cp l", "cp (hl)", "cp a",
+  /* C0 */ "ret nz", "pop bc", "jp nz,W", "jp W",
+  /* C4 */ "call nz,W", "push bc", "add a,N", "rst $00",
+  /* C8 */ "ret z", "ret", "jp z,W", NULL,
+  /* CC */ "call z,W", "call W", "adc a,N", "rst $08",
+  /* D0 */ "ret nc", "pop de", "jp nc,W", "out (N),a",
+  /* D4 */ "call nc,W", "push de", "sub N", "rst $10",
+  /* D8 */ "ret c", "exx", "jp c,W", "in a,(N)",
+  /* DC */ "call c,W", NULL, "sbc a,N", "rst $18",
+  /* E0 */ "ret po", "pop hl", "jp po,W", "ex (sp),hl",
+  /* E4 */ "call po,W", "push hl", "and N", "rst $20",
+  /* E8 */ "ret pe", "jp (hl)", "jp pe,W", "ex de,hl",
+  /* EC */ "call pe,W", NULL, "xor N", "rst $28",
+  /* F0 */ "ret p", "pop af", "jp p,W", "di",
+  /* F4 */ "call p,W", "push af", "or N", "rst $30",
+  /* F8 */ "ret m", "ld sp,hl", "jp m,W", "ei",
+  /* FC */ "call m,W", NULL, "cp N", "rst $38",
+};
+
+// NULL = no instruction: executes as a 2-byte nop
+static const char* const dis_ed[256] = {
+  [0x40] = "in b,(c)", "out (c),b", "sbc hl,bc", "ld (W),bc", "neg", "retn",
+  "im 0", "ld i,a", "in c,(c)", "out (c),c", "adc hl,bc", "ld bc,(W)", "neg",
+  "reti", "im 0", "ld r,a", "in d,(c)", "out (c),d", "sbc hl,de", "ld (W),de",
+  "neg", "retn", "im 1", "ld a,i", "in e,(c)", "out (c),e", "adc hl,de",
+  "ld de,(W)", "neg", "retn", "im 2", "ld a,r", "in h,(c)", "out (c),h",
+  "sbc hl,hl", "ld (W),hl", "neg", "retn", "im 0", "rrd", "in l,(c)",
+  "out (c),l", "adc hl,hl", "ld hl,(W)", "neg", "retn", "im 0", "rld",
+  "in (c)", "out (c),0", "sbc hl,sp", "ld (W),sp", "neg", "retn", "im 1",
+  NULL, "in a,(c)", "out (c),a", "adc hl,sp", "ld sp,(W)", "neg", "retn",
+  "im 2", NULL,
+  [0xA0] = "ldi", "cpi", "ini", "outi",
+  [0xA8] = "ldd", "cpd", "ind", "outd",
+  [0xB0] = "ldir", "cpir", "inir", "otir",
+  [0xB8] = "lddr", "cpdr", "indr", "otdr",
+};
+
+static const char* const dis_rot[8] = {
+    "rlc ", "rrc ", "rl ", "rr ", "sla ", "sra ", "sll ", "srl "};
+static const char* const dis_bit[4] = {NULL, "bit ", "res ", "set "};
+static const char* const dis_reg[8] = {"b", "c", "d", "e", "h", "l", "(hl)", "a"};
+
+static const char hex_digits[] = "0123456789ABCDEF";
+
+// MARK: output
+static inline char* put_str(char* o, const char* s) {
+  while (*s) {
+    *o++ = *s++;
+  }
+  return o;
+}
+
+static inline char* put_hex8(char* o, uint8_t v) {
+  *o++ = '$';
+  *o++ = hex_digits[v >> 4];
+  *o++ = hex_digits[v & 15];
+  return o;
+}
+
+static inline char* put_hex16(char* o, uint16_t v) {
+  *o++ = '$';
+  *o++ = hex_digits[v >> 12];
+  *o++ = hex_digits[(v >> 8) & 15];
+  *o++ = hex_digits[(v >> 4) & 15];
+  *o++ = hex_digits[v & 15];
+  return o;
+}
+
+// "(ix+$05)", "(iy-$80)"
+static char* put_indexed(char* o, const char* iz, uint8_t d) {
+  *o++ = '(';
+  o = put_str(o, iz);
+  *o++ = d & 0x80 ? '-' : '+';
+  o = put_hex8(o, d & 0x80 ? (uint8_t)-d : d);
+  *o++ = ')';
+  return o;
+}
+
+// true if s[0..n) is a whole word of the mnemonic starting at "start"
+static inline bool is_word(const char* s, const char* start, int n) {
+  const bool before = s > start && s[-1] >= 'a' && s[-1] <= 'z';
+  const bool after = s[n] >= 'a' && s[n] <= 'z';
+  return !before && !after;
+}
+
+static int too_short(z80_dis* d) {
+  d->text[0] = d->text[1] = '?';
+  d->text[2] = 0;
+  d->len = 0;
+  d->cyc = 0;
+  return 0;
+}
+
+// MARK: decoding
+// cb xx, or dd/fd cb d xx when "iz" is set
+static int dis_cb(z80_dis* d, const uint8_t* code, int i, int avail,
+    const char* iz, int prefixes) {
+  uint8_t disp = 0;
+  if (iz) {
+    if (i + 2 > avail) {
+      return too_short(d);
+    }
+    disp = code[i++];
+  } else if (i + 1 > avail) {
+    return too_short(d);
+  }
+  const uint8_t op = code[i++];
+  const uint8_t x_ = op >> 6, y_ = (op >> 3) & 7, z_ = op & 7;
+
+  char* o = d->text;
+  if (x_ == 0) {
+    o = put_str(o, dis_rot[y_]);
+  } else {
+    o = put_str(o, dis_bit[x_]);
+    *o++ = '0' + y_;
+    *o++ = ',';
+  }
+  if (iz) {
+    o = put_indexed(o, iz, disp);
+    if (x_ != 1 && z_ != 6) { // undocumented: result also goes to r[z]
+      *o++ = ',';
+      o = put_str(o, dis_reg[z_]);
+    }
+    d->cyc = 4 * (prefixes - 1) + z80_cyc_ddfd[0xCB] + (x_ == 1 ? 20 : 23);
+  } else {
+    o = put_str(o, dis_reg[z_]);
+    d->cyc = 8 + (z_ == 6 ? (x_ == 1 ? 4 : 7) : 0);
+  }
+  *o = 0;
+  d->len = i;
+  return i;
+}
+
+int z80_disasm(z80_dis* d, const uint8_t* code, int avail, uint16_t pc) {
+  // dd/fd: only the last prefix of a run counts
+  int i = 0;
+  uint8_t prefix = 0;
+  while (i < avail && (code[i] == 0xDD || code[i] == 0xFD)) {
+    prefix = code[i++];
+  }
+  if (i >= avail) {
+    return too_short(d);
+  }
+  const int prefixes = i;
+  const uint8_t op = code[i++];
+  const char* iz = prefix == 0xDD ? "ix" : "iy";
+
+  if (op == 0xCB) {
+    return dis_cb(d, code, i, avail, prefix ? iz : NULL, prefixes);
+  }
+
+  const char* t;
+  int hl = Z80_HL_NONE; // what the prefix does (z80_hl_operand)
+  if (op == 0xED) { // the core runs ed opcodes unchanged after dd/fd
+    if (i >= avail) {
+      return too_short(d);
+    }
+    const uint8_t op2 = code[i++];
+    t = dis_ed[op2] ? dis_ed[op2] : "nop";
+    d->cyc = 4 * prefixes + z80_cyc_ed[op2];
+    prefix = 0;
+  } else {
+    t = dis_00[op];
+    d->cyc = z80_cyc_00[op];
+    hl = prefix ? z80_hl_operand[op] : Z80_HL_NONE;
+  }
+
+  const bool indexed = hl != Z80_HL_NONE;
+  const char* const start = t;
+  char* o = d->text;
+  for (; *t; t++) {
+    if (hl == Z80_HL_MEM && t[0] == '(' && t[1] == 'h' && t[2] == 'l' &&
+        t[3] == ')') {
+      if (i >= avail) {
+        return too_short(d);
+      }
+      o = put_indexed(o, iz, code[i++]);
+      t += 3;
+      continue;
+    }
+    if (hl == Z80_HL_PAIR && t[0] == 'h' && t[1] == 'l' && is_word(t, start, 2)) {
+      o = put_str(o, iz);
+      t++;
+      continue;
+    }
+    if (hl == Z80_HL_BYTE && (*t == 'h' || *t == 'l') && is_word(t, start, 1)) {
+      o = put_str(o, iz);
+      *o++ = *t;
+      continue;
+    }
+    switch (*t) {
+    case 'N':
+      if (i >= avail) {
+        return too_short(d);
+      }
+      o = put_hex8(o, code[i++]);
+      break;
+    case 'W':
+      if (i + 2 > avail) {
+        return too_short(d);
+      }
+      o = put_hex16(o, code[i] | code[i + 1] << 8);
+      i += 2;
+      break;
+    case 'R': // always the last operand: i is the full length here
+      if (i >= avail) {
+        return too_short(d);
+      }
+      i++;
+      o = put_hex16(o, pc + i + (int8_t)code[i - 1]);
+      break;
+    default: *o++ = *t; break;
+    }
+  }
+  *o = 0;
+
+  if (indexed) {
+    d->cyc = 4 * (prefixes - 1) + z80_cyc_ddfd[op];
+  } else if (op != 0xED) {
+    d->cyc += 4 * prefixes; // prefix ignored, but still fetched
+  }
+  d->len = i;
+  return i;
+}
+
+int z80_disasm_mem(z80_dis* d, const uint8_t* mem, uint16_t pc) {
+  uint8_t code[8];
+  for (int k = 0; k < 8; k++) {
+    code[k] = mem[(uint16_t)(pc + k)];
+  }
+  return z80_disasm(d, code, 8, pc);
+}
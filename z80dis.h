@@ -0,0 +1,32 @@
+#ifndef Z80_Z80DIS_H_
+#define Z80_Z80DIS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// table-driven disassembler for the z80 core: every prefix (cb, ed, dd/fd,
+// ddcb/fdcb) and the undocumented opcodes (sll, ixh/ixl, "ld r,rlc (ix+d)",
+// "in (c)", "out (c),0", ed mirrors). decoding follows the core exactly:
+// a dd/fd prefix in front of an opcode that does not use hl is part of the
+// same instruction, and only the last of several prefixes counts.
+//
+// output is lowercase with $-prefixed hex, e.g. "ld a,(ix+$05)", "jr nz,$0F3A".
+// no printf and no allocation: a few million instructions per second.
+
+#define Z80_DIS_TEXT 32
+
+typedef struct z80_dis {
+  char text[Z80_DIS_TEXT];
+  uint8_t len; // bytes, prefixes included
+  uint8_t cyc; // t-states (branch not taken, no repeat), from the core tables
+} z80_dis;
+
+// disassembles the instruction in code[0..avail), which sits at address
+// "pc" (used for relative jump targets). returns its length, or 0 if it
+// does not fit in "avail" bytes ("??" in d->text).
+int z80_disasm(z80_dis* d, const uint8_t* code, int avail, uint16_t pc);
+
+// same, reading the instruction at "pc" from a 64 kb address space
+int z80_disasm_mem(z80_dis* d, const uint8_t* mem, uint16_t pc);
+
+#endif // Z80_Z80DIS_H_
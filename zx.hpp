@@ -0,0 +1,370 @@
+#ifndef ZX_ZX_HPP_
+#define ZX_ZX_HPP_
+
+// --- [ C++ API ] ---
+// Header-only C++20 wrapper over the C core, for harnesses written in C++.
+// Nothing here is compiled into the library: link libzxcore.a as usual.
+//
+//   zx::Machine  one Spectrum (spectrum.h), owned: created from a ROM,
+//                freed with its caches, movable but not copyable
+//   zx::Cpu<Bus> a bare Z80 (z80.h) on a bus of your own
+//
+// Memory is handed out as std::span views into the machine itself, so bulk
+// reads and writes copy nothing. Callbacks are template parameters: the C
+// core still calls one function pointer per access, but it lands in a
+// trampoline made for that exact type, where your code is inlined (no
+// std::function, no virtual call). The C API stays as it is; raw() gives
+// the C structs to anything not wrapped here.
+//
+// Point the compiler here with -iquote, not -I: the core has a sched.h,
+// which -I would put in front of the system one <pthread.h> includes.
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+extern "C" {
+#include "spectrum.h"
+#include "screenhash.h"
+}
+
+namespace zx {
+
+// A machine or CPU could not be created (unusable ROM, out of memory)
+class Error : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+enum class Model { Spectrum48K = ZX_MODEL_48K, Spectrum128K = ZX_MODEL_128K };
+
+// Core variant (z80_set_core): Exact by default, Fast without MEMPTR, XF/YF
+// and R register updates
+enum class Core { Exact = Z80_CORE_EXACT, Fast = Z80_CORE_FAST };
+
+// --- [ Code Caches ] ---
+// Blocks and the decode cache, owned by whoever attached them
+struct CacheDeleter {
+    void operator()(z80_blocks* b) const { z80_blocks_free(b); }
+    void operator()(z80_icache* c) const { z80_icache_free(c); }
+};
+
+namespace detail {
+
+inline void attach_caches(z80& cpu, bool blocks, bool icache,
+                          std::unique_ptr<z80_blocks, CacheDeleter>& owned_blocks,
+                          std::unique_ptr<z80_icache, CacheDeleter>& owned_icache) {
+    if (blocks && !owned_blocks) {
+        owned_blocks.reset(z80_blocks_new());
+        if (!owned_blocks)
+            throw Error("out of memory for the block cache");
+    }
+    if (icache && !owned_icache) {
+        owned_icache.reset(z80_icache_new());
+        if (!owned_icache)
+            throw Error("out of memory for the decode cache");
+    }
+    if (!blocks)
+        owned_blocks.reset();
+    if (!icache)
+        owned_icache.reset();
+    cpu.blocks = owned_blocks.get();
+    cpu.icache = owned_icache.get();
+    z80_blocks_flush(cpu.blocks);      // Empty, whatever ran before
+    z80_icache_flush(cpu.icache);
+}
+
+}  // namespace detail
+
+// --- [ Machine ] ---
+class Machine {
+public:
+    // Loads the ROM and resets the machine (zx_init_model). Throws Error.
+    explicit Machine(const std::string& rom_path, Model model = Model::Spectrum48K)
+        : box_(std::make_unique<Box>()) {
+        if (!zx_init_model(&box().zx, static_cast<zx_model>(model), rom_path.c_str()))
+            throw Error("cannot load ROM " + rom_path);
+    }
+
+    // The machine lives on the heap (the CPU's userdata points into it), so
+    // a move only hands the pointer over. A moved-from machine is empty:
+    // anything but assigning to it or destroying it asserts.
+    Machine(Machine&&) noexcept = default;
+    Machine& operator=(Machine&&) noexcept = default;
+    Machine(const Machine&) = delete;
+    Machine& operator=(const Machine&) = delete;
+
+    // The C machine, for everything not wrapped here
+    zx_spectrum& raw() { return box().zx; }
+    const zx_spectrum& raw() const { return box().zx; }
+    z80& cpu() { return box().zx.cpu; }
+    const z80& cpu() const { return box().zx.cpu; }
+
+    // --- Running ---
+    // False if the debugger (raw().debug) stopped the machine first
+    bool run_frame() { return zx_run_frame(&box().zx); }
+    bool run_until(unsigned long tstate) { return zx_run_until(&box().zx, tstate); }
+    bool run_frames(uint32_t n) {
+        for (uint32_t i = 0; i < n; i++)
+            if (!run_frame())
+                return false;
+        return true;
+    }
+
+    uint32_t frame() const { return box().zx.frame; }
+    unsigned long frame_tstate() const { return zx_frame_tstate(&box().zx); }
+
+    // Picks the core variant; caches are emptied (z80_set_core)
+    void set_core(Core core) { z80_set_core(&box().zx.cpu, static_cast<z80_core_variant>(core)); }
+
+    // Block cache (z80_run) and decode cache (z80_step), owned by the machine
+    void use_caches(bool blocks, bool icache) {
+        detail::attach_caches(box().zx.cpu, blocks, icache, box().blocks, box().icache);
+        if (box().icache)              // ROM is never written by the CPU
+            z80_icache_set_rom(box().icache.get(), 0, ZX_ROM_SIZE);
+    }
+
+    // --- Input ---
+    void key(int row, int bit, bool pressed) { zx_set_key(&box().zx, row, bit, pressed); }
+    void kempston(uint8_t bits) {          // ZX_KEMPSTON_* bits, 1 = pressed
+        box().zx.kempston_attached = true;
+        box().zx.kempston = bits;
+    }
+
+    // --- Memory Views ---
+    // Zero-copy spans into the machine. Code caches do not see writes made
+    // through them: call code_changed() for the addresses afterwards.
+
+    // All of the model's RAM, banks in storage order (see spectrum.h)
+    std::span<uint8_t> ram() { return {zx_ram(&box().zx), zx_ram_size(&box().zx)}; }
+    std::span<const uint8_t> ram() const {
+        return {box().zx.memory + ZX_RAM_OFFSET, zx_ram_size(&box().zx)};
+    }
+
+    // RAM bank 0-7 (a 48K has banks 5, 2 and 0 at 0x4000, 0x8000, 0xC000)
+    std::span<uint8_t, ZX_BANK_SIZE> bank(int n) {
+        return std::span<uint8_t, ZX_BANK_SIZE>(box().zx.memory + zx_bank_offset(n), ZX_BANK_SIZE);
+    }
+
+    // The 16 KB the CPU sees at slot * 0x4000 (slot 0-3), ROM included
+    std::span<uint8_t, ZX_BANK_SIZE> page(int slot) {
+        return std::span<uint8_t, ZX_BANK_SIZE>(box().zx.memory + box().zx.page[slot], ZX_BANK_SIZE);
+    }
+
+    // The screen being displayed, laid out like video memory
+    std::span<const uint8_t, ZX_SCREEN_BYTES> screen() const {
+        return std::span<const uint8_t, ZX_SCREEN_BYTES>(zx_screen(&box().zx), ZX_SCREEN_BYTES);
+    }
+
+    uint8_t peek(uint16_t addr) const { return zx_peek(&box().zx, addr); }
+    void poke(uint16_t addr, uint8_t val) {
+        zx_poke(&box().zx, addr, val);
+        code_changed(addr, 1);
+    }
+
+    // Copies out what the CPU sees from "addr" on (wrapping at 0xFFFF)
+    void read(uint16_t addr, std::span<uint8_t> out) const {
+        for_pages(addr, out.size(), [&](uint32_t offset, size_t done, size_t n) {
+            std::memcpy(out.data() + done, box().zx.memory + offset, n);
+        });
+    }
+
+    // Writes where the CPU would see it (ROM included, as zx_poke), and
+    // retires the cached code there
+    void write(uint16_t addr, std::span<const uint8_t> in) {
+        for_pages(addr, in.size(), [&](uint32_t offset, size_t done, size_t n) {
+            std::memcpy(box().zx.memory + offset, in.data() + done, n);
+        });
+        code_changed(addr, in.size());
+    }
+
+    // Memory at [addr, addr + len) was changed behind the core's back
+    void code_changed(uint16_t addr, size_t len) {
+        for (size_t done = 0; done < len; ) {
+            uint32_t n = static_cast<uint32_t>(std::min<size_t>(len - done, 0x10000u - addr));
+            zx_code_changed(&box().zx, addr, n);
+            done += n;
+            addr = static_cast<uint16_t>(addr + n);
+        }
+    }
+
+    // --- Checks ---
+    uint32_t checksum() const { return zx_state_checksum(&box().zx); }
+    uint64_t screen_hash() const { return zx_screen_hash(&box().zx, nullptr); }
+    uint64_t screen_hash(const zx_hash_mask& mask) const { return zx_screen_hash(&box().zx, &mask); }
+
+    // --- Peripherals ---
+    // Puts "device" in front of the machine's own ports. Device has
+    //   bool in(uint16_t port, unsigned long cyc, uint8_t& val);
+    //   bool out(uint16_t port, uint8_t val, unsigned long cyc);
+    // returning false for ports it does not answer (the Spectrum's own
+    // devices get those). It must outlive the machine or be detached.
+    template <class Device>
+    void attach(Device& device) {
+        detach();
+        box().device = &device;
+        box().next_in = box().zx.cpu.port_in;
+        box().next_out = box().zx.cpu.port_out;
+        box().zx.cpu.port_in = &device_in<Device>;
+        box().zx.cpu.port_out = &device_out<Device>;
+    }
+
+    void detach() {
+        if (!box().device)
+            return;
+        box().zx.cpu.port_in = box().next_in;
+        box().zx.cpu.port_out = box().next_out;
+        box().device = nullptr;
+    }
+
+private:
+    using port_in_fn = uint8_t (*)(z80*, uint16_t, unsigned long);
+    using port_out_fn = void (*)(z80*, uint16_t, uint8_t, unsigned long);
+
+    // The CPU's userdata points at "zx". Being the first member of a
+    // standard-layout struct, it shares that struct's address, so the port
+    // trampolines find the device from it.
+    struct Wired {
+        zx_spectrum zx;
+        void* device;
+        port_in_fn next_in;
+        port_out_fn next_out;
+    };
+    static_assert(std::is_standard_layout_v<Wired>);
+
+    struct Box : Wired {
+        Box() : Wired{} {}
+        std::unique_ptr<z80_blocks, CacheDeleter> blocks;
+        std::unique_ptr<z80_icache, CacheDeleter> icache;
+    };
+
+    static Wired* wired_of(z80* cpu) { return reinterpret_cast<Wired*>(cpu->userdata); }
+
+    Box& box() const {
+        assert(box_ && "zx::Machine used after being moved from");
+        return *box_;
+    }
+
+    template <class Device>
+    static uint8_t device_in(z80* cpu, uint16_t port, unsigned long cyc) {
+        Wired* box = wired_of(cpu);
+        uint8_t val;
+        if (static_cast<Device*>(box->device)->in(port, cyc, val))
+            return val;
+        return box->next_in(cpu, port, cyc);
+    }
+
+    template <class Device>
+    static void device_out(z80* cpu, uint16_t port, uint8_t val, unsigned long cyc) {
+        Wired* box = wired_of(cpu);
+        if (!static_cast<Device*>(box->device)->out(port, val, cyc))
+            box->next_out(cpu, port, val, cyc);
+    }
+
+    // Calls f(offset in memory, bytes done, bytes in this page) per page
+    template <class F>
+    void for_pages(uint16_t addr, size_t len, F&& f) const {
+        for (size_t done = 0; done < len; ) {
+            size_t in_page = ZX_BANK_SIZE - (addr & (ZX_BANK_SIZE - 1));
+            size_t n = std::min(len - done, in_page);
+            f(box().zx.page[addr >> 14] + (addr & (ZX_BANK_SIZE - 1)), done, n);
+            done += n;
+            addr = static_cast<uint16_t>(addr + n);
+        }
+    }
+
+    std::unique_ptr<Box> box_;
+};
+
+// --- [ Bare CPU ] ---
+// A Z80 with no Spectrum around it: Bus supplies memory and ports,
+//   uint8_t read(uint16_t addr);
+//   void write(uint16_t addr, uint8_t val);
+//   uint8_t in(uint16_t port, unsigned long cyc);
+//   void out(uint16_t port, uint8_t val, unsigned long cyc);
+// The CPU owns its bus (move one in, or use a pointer-like wrapper).
+template <class Bus>
+class Cpu {
+public:
+    explicit Cpu(Bus bus = Bus(), Core core = Core::Exact)
+        : state_(std::make_unique<State>(std::move(bus))) {
+        z80& z = state().cpu;
+        z80_init(&z);
+        z.read_byte = &read_byte;
+        z.write_byte = &write_byte;
+        z.port_in = &port_in;
+        z.port_out = &port_out;
+        z.userdata = state_.get();
+        set_core(core);
+    }
+
+    // A moved-from CPU is empty, as a moved-from Machine
+    Cpu(Cpu&&) noexcept = default;
+    Cpu& operator=(Cpu&&) noexcept = default;
+    Cpu(const Cpu&) = delete;
+    Cpu& operator=(const Cpu&) = delete;
+
+    // Registers and the rest of the C state
+    z80& raw() { return state().cpu; }
+    const z80& raw() const { return state().cpu; }
+    Bus& bus() { return state().bus; }
+    const Bus& bus() const { return state().bus; }
+
+    void step() { z80_step(&state().cpu); }
+    void run(unsigned long until) { z80_run(&state().cpu, until); }
+    unsigned long cycles() const { return state().cpu.cyc; }
+
+    uint8_t f() const { return z80_get_f(const_cast<z80*>(&state().cpu)); }
+    void set_f(uint8_t val) { z80_set_f(&state().cpu, val); }
+    void interrupt(uint8_t data) { z80_gen_int(&state().cpu, data); }
+    void nmi() { z80_gen_nmi(&state().cpu); }
+
+    void set_core(Core core) { z80_set_core(&state().cpu, static_cast<z80_core_variant>(core)); }
+
+    // Caches, owned by the CPU. Code written by anything but the CPU must
+    // be reported with z80_blocks_forget / z80_icache_forget.
+    void use_caches(bool blocks, bool icache) {
+        detail::attach_caches(state().cpu, blocks, icache, state().blocks, state().icache);
+    }
+
+private:
+    struct State {
+        explicit State(Bus&& b) : bus(std::move(b)) {}
+        z80 cpu{};
+        Bus bus;
+        std::unique_ptr<z80_blocks, CacheDeleter> blocks;
+        std::unique_ptr<z80_icache, CacheDeleter> icache;
+    };
+
+    State& state() const {
+        assert(state_ && "zx::Cpu used after being moved from");
+        return *state_;
+    }
+
+    static uint8_t read_byte(void* userdata, uint16_t addr) {
+        return static_cast<State*>(userdata)->bus.read(addr);
+    }
+    static void write_byte(void* userdata, uint16_t addr, uint8_t val) {
+        static_cast<State*>(userdata)->bus.write(addr, val);
+    }
+    static uint8_t port_in(z80* cpu, uint16_t port, unsigned long cyc) {
+        return static_cast<State*>(cpu->userdata)->bus.in(port, cyc);
+    }
+    static void port_out(z80* cpu, uint16_t port, uint8_t val, unsigned long cyc) {
+        static_cast<State*>(cpu->userdata)->bus.out(port, val, cyc);
+    }
+
+    std::unique_ptr<State> state_;
+};
+
+}  // namespace zx
+
+#endif // ZX_ZX_HPP_
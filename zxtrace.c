@@ -0,0 +1,230 @@
+// --- [ Trace Decoder ] ---
+// Offline companion of trace.h: turns binary execution traces into text and
+// finds the first instruction where two traces part ways.
+//
+//   zxtrace dump FILE [--from N] [--count N]
+//   zxtrace diff A B [--context N]
+//
+// Records are numbered from the start of the run, so a trace written by the
+// flight recorder (--trace-last) lines up with a full one.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+#include "z80dis.h"
+
+#define BLOCK_RECORDS 65536   // Records read per fread
+
+typedef struct trace_file {
+    FILE*     f;
+    uint64_t  first;          // Index of the first record in the file
+    uint64_t  count;
+    trace_rec* buf;
+    uint64_t  buf_start;      // Index of buf[0]
+    uint32_t  buf_len;
+} trace_file;
+
+static bool trace_file_open(trace_file* tf, const char* path) {
+    memset(tf, 0, sizeof(*tf));
+    tf->f = fopen(path, "rb");
+    if (!tf->f) {
+        perror(path);
+        return false;
+    }
+    uint8_t h[16];
+    if (fread(h, 1, sizeof(h), tf->f) != sizeof(h) || memcmp(h, "ZXTR", 4) != 0 ||
+        h[4] != TRACE_VERSION || h[5] != sizeof(trace_rec)) {
+        fprintf(stderr, "%s: not a version %d trace\n", path, TRACE_VERSION);
+        fclose(tf->f);
+        return false;
+    }
+    memcpy(&tf->first, h + 8, 8);
+
+    fseek(tf->f, 0, SEEK_END);
+    tf->count = (uint64_t)(ftell(tf->f) - (long)sizeof(h)) / sizeof(trace_rec);
+    tf->buf = malloc(BLOCK_RECORDS * sizeof(trace_rec));
+    tf->buf_start = tf->first;
+    return tf->buf != NULL;
+}
+
+static void trace_file_close(trace_file* tf) {
+    fclose(tf->f);
+    free(tf->buf);
+}
+
+// Record number "index" (absolute), or NULL if it is not in the file
+static const trace_rec* trace_file_get(trace_file* tf, uint64_t index) {
+    if (index < tf->first || index >= tf->first + tf->count)
+        return NULL;
+    if (index < tf->buf_start || index >= tf->buf_start + tf->buf_len) {
+        tf->buf_start = index;
+        fseek(tf->f, 16 + (long)((index - tf->first) * sizeof(trace_rec)), SEEK_SET);
+        tf->buf_len = (uint32_t)fread(tf->buf, sizeof(trace_rec), BLOCK_RECORDS, tf->f);
+        if (index >= tf->buf_start + tf->buf_len)
+            return NULL;
+    }
+    return &tf->buf[index - tf->buf_start];
+}
+
+// --- [ Text Rendering ] ---
+static void format_rec(char* out, size_t size, uint64_t index, const trace_rec* t) {
+    z80_dis d;
+    z80_disasm(&d, t->op, 4, t->pc);   // "??" for the rare longer prefix chains
+    snprintf(out, size,
+             "%10llu %12llu  %04X  %02X %02X %02X %02X  %-18s "
+             "AF=%04X BC=%04X DE=%04X HL=%04X SP=%04X IX=%04X IY=%04X "
+             "I=%02X R=%02X IM%d%s%s%s",
+             (unsigned long long)index, (unsigned long long)t->cyc, t->pc,
+             t->op[0], t->op[1], t->op[2], t->op[3], d.text,
+             t->af, t->bc, t->de, t->hl, t->sp, t->ix, t->iy, t->i, t->r,
+             TRACE_IM(t->flags), t->flags & TRACE_IFF1 ? " EI" : " DI",
+             t->flags & TRACE_IFF2 ? "" : " !IFF2", t->flags & TRACE_HALT ? " HALT" : "");
+}
+
+static int cmd_dump(const char* path, uint64_t from, uint64_t count) {
+    trace_file tf;
+    if (!trace_file_open(&tf, path))
+        return 1;
+    if (from < tf.first)
+        from = tf.first;
+
+    char line[224];
+    for (uint64_t i = from; i - from < count; i++) {
+        const trace_rec* t = trace_file_get(&tf, i);
+        if (!t)
+            break;
+        format_rec(line, sizeof(line), i, t);
+        puts(line);
+    }
+    trace_file_close(&tf);
+    return 0;
+}
+
+// --- [ Diff ] ---
+// Names the fields that differ between two records
+static void describe_diff(const trace_rec* a, const trace_rec* b) {
+    printf("differs in:");
+    if (a->cyc != b->cyc) printf(" cyc");
+    if (a->pc != b->pc) printf(" PC");
+    if (a->sp != b->sp) printf(" SP");
+    if (a->af != b->af) printf(" AF");
+    if (a->bc != b->bc) printf(" BC");
+    if (a->de != b->de) printf(" DE");
+    if (a->hl != b->hl) printf(" HL");
+    if (a->ix != b->ix) printf(" IX");
+    if (a->iy != b->iy) printf(" IY");
+    if (memcmp(a->op, b->op, 4) != 0)
+        printf(" opcode-bytes");
+    if (a->i != b->i) printf(" I");
+    if (a->r != b->r) printf(" R");
+    if (a->flags != b->flags) printf(" IFF/IM/HALT");
+    printf("\n");
+}
+
+static int cmd_diff(const char* pa, const char* pb, int context) {
+    trace_file a, b;
+    if (!trace_file_open(&a, pa))
+        return 2;
+    if (!trace_file_open(&b, pb)) {
+        trace_file_close(&a);
+        return 2;
+    }
+
+    uint64_t start = a.first > b.first ? a.first : b.first;
+    uint64_t end_a = a.first + a.count, end_b = b.first + b.count;
+    uint64_t end = end_a < end_b ? end_a : end_b;
+    int status = 0;
+    char line[224];
+
+    if (start >= end) {
+        fprintf(stderr, "no common range: %s covers instructions [%llu, %llu), %s [%llu, %llu)\n",
+                pa, (unsigned long long)a.first, (unsigned long long)end_a,
+                pb, (unsigned long long)b.first, (unsigned long long)end_b);
+        status = 2;
+    }
+
+    for (uint64_t i = start; !status && i < end; i++) {
+        const trace_rec* ta = trace_file_get(&a, i);
+        const trace_rec* tb = trace_file_get(&b, i);
+        if (!ta || !tb) {
+            // The size promised more records than could be read
+            fprintf(stderr, "%s: truncated at instruction %llu\n", ta ? pb : pa,
+                    (unsigned long long)i);
+            status = 2;
+            break;
+        }
+        if (memcmp(ta, tb, sizeof(trace_rec)) == 0)
+            continue;
+
+        // Copies: reading the context may refill the buffers they point into
+        trace_rec ra = *ta, rb = *tb;
+        printf("first difference at instruction %llu\n\n", (unsigned long long)i);
+        uint64_t from = i - start > (uint64_t)context ? i - context : start;
+        for (uint64_t k = from; k < i; k++) {
+            const trace_rec* t = trace_file_get(&a, k);
+            if (!t)
+                break;
+            format_rec(line, sizeof(line), k, t);
+            printf("  %s\n", line);
+        }
+        format_rec(line, sizeof(line), i, &ra);
+        printf("A %s\n", line);
+        format_rec(line, sizeof(line), i, &rb);
+        printf("B %s\n\n", line);
+        describe_diff(&ra, &rb);
+        status = 1;
+    }
+    if (!status) {
+        printf("identical over instructions %llu-%llu\n", (unsigned long long)start,
+               (unsigned long long)(end ? end - 1 : 0));
+        if (end_a != end_b)
+            printf("%s ends first, at instruction %llu\n", end_a < end_b ? pa : pb,
+                   (unsigned long long)end);
+    }
+    trace_file_close(&a);
+    trace_file_close(&b);
+    return status;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "usage: %s dump FILE [--from N] [--count N]\n"
+            "       %s diff A B [--context N]\n"
+            "  dump  print the records as text\n"
+            "  diff  show the first instruction where A and B differ (exit status 1;\n"
+            "        2 if they share no instructions or one cannot be read)\n",
+            prog, prog);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc >= 3 && strcmp(argv[1], "dump") == 0) {
+        uint64_t from = 0, count = UINT64_MAX;
+        for (int i = 3; i < argc; i++) {
+            if (strcmp(argv[i], "--from") == 0 && i + 1 < argc)
+                from = strtoull(argv[++i], NULL, 10);
+            else if (strcmp(argv[i], "--count") == 0 && i + 1 < argc)
+                count = strtoull(argv[++i], NULL, 10);
+            else {
+                usage(argv[0]);
+                return 2;
+            }
+        }
+        return cmd_dump(argv[2], from, count);
+    }
+    if (argc >= 4 && strcmp(argv[1], "diff") == 0) {
+        int context = 5;
+        for (int i = 4; i < argc; i++) {
+            if (strcmp(argv[i], "--context") == 0 && i + 1 < argc)
+                context = atoi(argv[++i]);
+            else {
+                usage(argv[0]);
+                return 2;
+            }
+        }
+        return cmd_diff(argv[2], argv[3], context);
+    }
+    usage(argv[0]);
+    return 2;
+}